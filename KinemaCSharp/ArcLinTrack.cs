@@ -39,6 +39,11 @@ namespace KinemaLibCs
       ArcLinTrackSetCoTrack(track, coTrack.track, reverseDir, maxSDiff);
     }
 
+    public void SetCoTrackParallel(ref readonly ArcLinTrack coTrack, bool reverseDir, double maxSDiff, int threadCnt = 0)
+    {
+      ArcLinTrackSetCoTrackParallel(track, coTrack.track, reverseDir, maxSDiff, threadCnt);
+    }
+
     public int Size
     {
       get { return ArcLinTrackGetSize(track); }
@@ -166,6 +171,9 @@ namespace KinemaLibCs
     [DllImport("KinemaLib.dll")]
     extern private static IntPtr ArcLinTrackSetCoTrack(IntPtr track, IntPtr coTrack, bool trkClosed = false, double trackPipeDiameter = 0.0);
 
+    [DllImport("KinemaLib.dll")]
+    extern private static void ArcLinTrackSetCoTrackParallel(IntPtr track, IntPtr coTrack, bool reverseDir, double maxSDiff, int threadCnt);
+
     [DllImport("KinemaLib.dll")]
     extern private static int ArcLinTrackGetSize(IntPtr track);
 
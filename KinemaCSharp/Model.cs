@@ -94,6 +94,14 @@ namespace KinemaLibCs
       return true;
     }
 
+    // Solves all topologies concurrently, derivOrder 0: Positions only,
+    // 1: Speeds, 2: Accels, 3: Jerks. threadCnt 0: One thread per core
+
+    public bool SolveAll(int maxIter, double rotTol, double posTol, int derivOrder, int threadCnt)
+    {
+      return SolveAllTopologiesModel(cppModel, maxIter, rotTol, posTol, derivOrder, threadCnt);
+    }
+
     public void Clear()
     {
       BodyMap.Clear();
@@ -305,6 +313,10 @@ namespace KinemaLibCs
     [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
     extern private static IntPtr GetTopologyModel(IntPtr cppModel, int index);
 
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern private static bool SolveAllTopologiesModel(IntPtr cppModel, int maxIter, double rotTol, double posTol,
+                                                       int derivOrder, int threadCnt);
+
     // Interface section
 
     [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
@@ -44,6 +44,138 @@ namespace KinemaLibCs
       return SolvePosTopology(cppTopology, maxIter, rotTol, posTol, varPosVec, ref iter);
     }
 
+    // Must have called SolvePos first:
+
+    public bool SolveSpeed(double[] varSpeedVec)
+    {
+      return SolveSpeedTopology(cppTopology, varSpeedVec);
+    }
+
+    // Must have called SolvePos and SolveSpeed first:
+
+    public bool SolveAccel(double[] varAccelVec)
+    {
+      return SolveAccelTopology(cppTopology, varAccelVec);
+    }
+
+    // mode 0: Full Newton, 1: Chord Newton (refactor if the residual
+    // shrinks by less than maxContraction per iteration)
+
+    public void SetNewtonMode(int mode, double maxContraction)
+    {
+      SetNewtonModeTopology(cppTopology, mode, maxContraction);
+    }
+
+    // order 0: No predictor, 1: Extrapolate with speeds,
+    // 2: Extrapolate with speeds and accels (call SolveSpeed/SolveAccel
+    // after each SolvePos)
+
+    public void SetPredictorOrder(int order)
+    {
+      SetPredictorOrderTopology(cppTopology, order);
+    }
+
+    // control 0: Clamp the step to 10 degrees rotation,
+    // 1: Levenberg-Marquardt trust region (default)
+
+    public void SetStepControl(int control, double initDamping)
+    {
+      SetStepControlTopology(cppTopology, control, initDamping);
+    }
+
+    // mode 0: Band or sparse matrix, whichever has the least fill,
+    // 1: Band matrix, 2: Supernodal sparse matrix
+
+    public void SetMatrixMode(int mode)
+    {
+      SetMatrixModeTopology(cppTopology, mode);
+    }
+
+    // Threads composing the loops, 0: All cores, 1: Serial (default)
+    public void SetThreadCnt(int threadCnt)
+    {
+      SetThreadCntTopology(cppTopology, threadCnt);
+    }
+
+    public bool IsSparse()
+    {
+      return IsSparseTopology(cppTopology);
+    }
+
+    public void GetSolverStats(out int solveCnt, out int iterCnt,
+                               out int predictCnt, out double itersSaved)
+    {
+      GetSolverStatsTopology(cppTopology, out solveCnt, out iterCnt,
+                                          out predictCnt, out itersSaved);
+    }
+
+    // Structure of the position matrix in use (see IsSparse()),
+    // ordering 0: Loop order, 1: Reverse Cuthill-McKee, 2: Minimum degree
+    public void GetMatrixStats(out int rowSz, out int colSz, out int varSz,
+                               out int ordering, out double nonZeros,
+                               out double fill, out double flops)
+    {
+      GetMatrixStatsTopology(cppTopology, out rowSz, out colSz, out varSz,
+                             out ordering, out nonZeros, out fill, out flops);
+    }
+
+    // Drives var locIdx (must be fixed) of driveJoint from "from" to "to"
+    // and adds a state to seq at each step. Coupled fixed vars advance
+    // by cplRatio times the drive advance.
+    // derivOrder 0: Positions only, 1: Speeds, 2: Accels, 3: Jerks
+    // A step that does not converge is retried with half the step,
+    // at most maxHalvings times in a row.
+    // adaptive: Vary the step up to maxStepFactor times step, shrink it
+    // if more than targetIter iterations are needed or the free vars
+    // deviate more than maxDeviation from the secant prediction
+
+    public bool Sweep(AbstractJoint driveJoint, int locIdx,
+                      double from, double to, double step,
+                      int maxIter, double rotTol, double posTol,
+                      int derivOrder, double driveSpeed,
+                      bool adaptive, double maxStepFactor, int targetIter,
+                      double maxDeviation, int maxHalvings,
+                      AbstractJoint[] cplJoints, int[] cplLocIdx, double[] cplRatio,
+                      Sequence seq, out int stepCnt)
+    {
+      IntPtr[] cppCplJoints = new IntPtr[cplJoints.Length];
+
+      for (int i = 0; i < cplJoints.Length; ++i) cppCplJoints[i] = cplJoints[i].cppJoint;
+
+      return SweepTopology(cppTopology, driveJoint.cppJoint, locIdx, from, to, step,
+                           maxIter, rotTol, posTol, derivOrder, driveSpeed,
+                           adaptive, maxStepFactor, targetIter, maxDeviation, maxHalvings,
+                           cppCplJoints.Length, cppCplJoints, cplLocIdx, cplRatio,
+                           seq.cppSequence, out stepCnt);
+    }
+
+    // As Sweep, the range is split in segCnt segments that are swept
+    // in parallel on clones of the model, on threadCnt threads
+    // (0: All cores, 1: Serial). parSegCnt: the nr of segments actually
+    // used, 1 if it fell back to Sweep (a model with functions)
+
+    public bool SweepParallel(AbstractJoint driveJoint, int locIdx,
+                              double from, double to, double step,
+                              int maxIter, double rotTol, double posTol,
+                              int derivOrder, double driveSpeed,
+                              bool adaptive, double maxStepFactor, int targetIter,
+                              double maxDeviation, int maxHalvings,
+                              AbstractJoint[] cplJoints, int[] cplLocIdx, double[] cplRatio,
+                              int segCnt, int threadCnt, Sequence seq,
+                              out int stepCnt, out int parSegCnt)
+    {
+      IntPtr[] cppCplJoints = new IntPtr[cplJoints.Length];
+
+      for (int i = 0; i < cplJoints.Length; ++i) cppCplJoints[i] = cplJoints[i].cppJoint;
+
+      return SweepParallelTopology(cppTopology, driveJoint.cppJoint, locIdx, from, to, step,
+                                   maxIter, rotTol, posTol, derivOrder, driveSpeed,
+                                   adaptive, maxStepFactor, targetIter, maxDeviation, maxHalvings,
+                                   cppCplJoints.Length, cppCplJoints, cplLocIdx, cplRatio,
+                                   segCnt, threadCnt, seq.cppSequence,
+                                   out stepCnt, out parSegCnt);
+    }
+
     // Interface Section
 
     [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
@@ -52,5 +184,59 @@ namespace KinemaLibCs
     [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
     extern static private bool SolvePosTopology(IntPtr cppTopology, int maxIter, double rotTol, double posTol,
                                                 double[] varPosVec, ref int iter);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private bool SolveSpeedTopology(IntPtr cppTopology, double[] varSpeedVec);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private bool SolveAccelTopology(IntPtr cppTopology, double[] varAccelVec);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private void SetNewtonModeTopology(IntPtr cppTopology, int mode, double maxContraction);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private void SetPredictorOrderTopology(IntPtr cppTopology, int order);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private void SetStepControlTopology(IntPtr cppTopology, int control, double initDamping);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private void SetMatrixModeTopology(IntPtr cppTopology, int mode);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private void SetThreadCntTopology(IntPtr cppTopology, int threadCnt);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private bool IsSparseTopology(IntPtr cppTopology);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private void GetSolverStatsTopology(IntPtr cppTopology, out int solveCnt, out int iterCnt,
+                                                      out int predictCnt, out double itersSaved);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private void GetMatrixStatsTopology(IntPtr cppTopology, out int rowSz, out int colSz,
+                                                      out int varSz, out int ordering,
+                                                      out double nonZeros, out double fill, out double flops);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private bool SweepTopology(IntPtr cppTopology, IntPtr cppDriveJoint, int locIdx,
+                                             double from, double to, double step,
+                                             int maxIter, double rotTol, double posTol,
+                                             int derivOrder, double driveSpeed,
+                                             bool adaptive, double maxStepFactor, int targetIter,
+                                             double maxDeviation, int maxHalvings,
+                                             int couplingCnt, IntPtr[] cppCplJoints, int[] cplLocIdx, double[] cplRatio,
+                                             IntPtr cppSequence, out int stepCnt);
+
+    [DllImport("KinemaLib.dll", CharSet = CharSet.Unicode)]
+    extern static private bool SweepParallelTopology(IntPtr cppTopology, IntPtr cppDriveJoint, int locIdx,
+                                                     double from, double to, double step,
+                                                     int maxIter, double rotTol, double posTol,
+                                                     int derivOrder, double driveSpeed,
+                                                     bool adaptive, double maxStepFactor, int targetIter,
+                                                     double maxDeviation, int maxHalvings,
+                                                     int couplingCnt, IntPtr[] cppCplJoints, int[] cplLocIdx, double[] cplRatio,
+                                                     int segCnt, int threadCnt, IntPtr cppSequence,
+                                                     out int stepCnt, out int parSegCnt);
   }
 }
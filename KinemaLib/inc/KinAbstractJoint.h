@@ -29,6 +29,11 @@ class Grip;
 
 class AbstractJoint : public Object
 {
+  // One allocation per element type, the arrays below point into these:
+  Ino::Trf3 *const trfStore; // derLst, invDerLst, varTrfCache
+  double *const dblStore;    // varTrfKey, own varPos .. varJerk
+  bool *const boolStore;     // fixedPos, invDerLstValid, isAngular
+
   Ino::Trf3 pos, invPos;
   Ino::Trf3 der1,invDer1;
   Ino::Trf3 der2,invDer2;
@@ -43,12 +48,21 @@ class AbstractJoint : public Object
   Ino::Trf3 *const invDerLst;
   bool *const invDerLstValid;
 
-  void getPosRange(int lwbIdx, int upbIdx, Ino::Trf3& posTrf) const;
-  void getInvPosRange(int lwbIdx, int upbIdx, Ino::Trf3& posTrf) const;
-  void getInvOneDerRange(int lwbIdx, int upbIdx, Ino::Trf3& derTrf) const;
-  void getOneDerRange(int lwbIdx, int upbIdx, Ino::Trf3& derTrf) const;
-  void getTwoDerRange(int lwbIdx, int upbIdx, Ino::Trf3& derTrf) const;
-  void getInvTwoDerRange(int lwbIdx, int upbIdx, Ino::Trf3& derTrf) const;
+  // The getVar..Trf() results per var, valid for the varPos in varTrfKey
+  Ino::Trf3 *const varTrfCache;
+  double *const varTrfKey;
+
+  // Modification count of what the var trfs depend on besides the vars
+  // (a track), NULL: nothing. depKey: its value when the caches were filled
+  const unsigned *depModCnt;
+  mutable unsigned depKey;
+
+  void dependencyChanged() const;
+
+  const Ino::Trf3& varTrf(int idx, int kind) const;
+
+  void getMixed(bool inverse, bool jerk,
+                Ino::Trf3& accMix, Ino::Trf3& jerkMix) const;
 
   void getSpeedTrf(int idx, Ino::Trf3& spTrf) const;
   void getAccelTrf(int idx, Ino::Trf3& accTrf) const;
@@ -61,14 +75,21 @@ class AbstractJoint : public Object
   void setAccel();
   void setJerk();
 
+  double *ownVars() const { return dblStore + varCnt*VarTrfKinds; }
+
+  // Vars stored by the Topology, see Topology::attachJointVars():
+  void attachVars(double *posLst, double *speedLst,
+                  double *accelLst, double *jerkLst);
+  void detachVars();
+
   AbstractJoint(const AbstractJoint& cp) = delete;             // No copying
   AbstractJoint& operator=(const AbstractJoint& src) = delete; // No assignment
 
 protected:
-  double *const varPos;
-  double *const varSpeed;
-  double *const varAccel;
-  double *const varJerk;
+  double *varPos;   // Own or Topology storage
+  double *varSpeed;
+  double *varAccel;
+  double *varJerk;
   bool   *const isAngular;
 
   virtual AbstractJoint *clone(Grip& newGrip) const = 0;
@@ -77,12 +98,30 @@ protected:
   virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const = 0;
   virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const = 0;
   virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const = 0;
+  virtual void getVarInvTrf(int idx, Ino::Trf3& trf) const;
+
+  void clearVarTrfCache(); // If the joint parameters change
+
+  void setDependency(const unsigned *modCnt); // See depModCnt
+
+  void checkDependency() const {
+    if (depModCnt && *depModCnt != depKey) dependencyChanged();
+  }
 
   void calcPosFromNeighbours();
 
   void copyStateFrom(const AbstractJoint *jnt);
 
 public:
+  enum VarTrfKind {
+    PosTrf = 0, DerTrf = 1, Der2Trf = 2, Der3Trf = 3, InvPosTrf = 4,
+    VarTrfKinds = 5
+  };
+
+  // Updates the trf caches of a list of joints of one type:
+  typedef void (*VarTrfUpdater)(AbstractJoint *const *jntLst, int cnt,
+                                                         int derivOrder);
+
   const int varCnt;
   Grip& grip;
 
@@ -138,6 +177,13 @@ public:
                  const Ino::Vector& fixedSpeedVec);
 
   void clearTrfCaches();
+  // Before concurrent use of the getters below, derivOrder <= 3,
+  // 0: the position trfs only:
+  void updateTrfCaches(int derivOrder=1) const;
+
+  static void updateTrfCachesAll(AbstractJoint *const *jntLst, int cnt,
+                                                         int derivOrder);
+  virtual VarTrfUpdater getVarTrfUpdater() const;
 
   const Ino::Trf3& getDerivative(int locIdx) const;
   const Ino::Trf3& getInvDerivative(int locIdx) const;
@@ -156,8 +202,8 @@ public:
   void getAccMixed(Ino::Trf3& mixTrf) const;
   void getInvAccMixed(Ino::Trf3& invMixTrf) const;
 
-  void getJerkMixed(Ino::Trf3& mixTrf);
-  void getInvJerkMixed(Ino::Trf3& invMixTrf);
+  void getJerkMixed(Ino::Trf3& mixTrf) const;
+  void getInvJerkMixed(Ino::Trf3& invMixTrf) const;
 
   double getJerk(int locIdx) const;
   void   setJerk(int locIdx, double newJerk);
@@ -170,6 +216,8 @@ public:
   void getThirdDerivative(int locIdx, Ino::Trf3& jerkTrf) const;
   void getInvThirdDerivative(int locIdx, Ino::Trf3& jerkTrf) const;
 
+  template <class Jnt> friend class JntKernel;
+
   friend class Grip;
   friend class GripList;
   friend class Topology;
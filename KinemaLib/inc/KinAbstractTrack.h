@@ -13,20 +13,42 @@
 #ifndef INOKIN_ABSTRACTTRACK_INC
 #define INOKIN_ABSTRACTTRACK_INC
 
+#include "Vec.h"
+
 //---------------------------------------------------------------------------
 
 namespace Ino
 {
-  class Vec3;
   class Trf3;
 }
 
 namespace InoKin {
 
+//---------------------------------------------------------------------------
+// Everything at one s, see AbstractTrack::evaluate()
+
+struct TrackSample
+{
+  double s;
+  int order;                 // Highest derivative present, 2 or 3
+
+  Ino::Vec3 pnt, dir, acc, jerk;
+  Ino::Vec3 xDir, xDer;      // As getXDir()
+
+  TrackSample() : s(0.0), order(-1) {}
+};
+
+//---------------------------------------------------------------------------
+
 class AbstractTrack
 {
+  unsigned modCnt;
+
   AbstractTrack& operator=(const AbstractTrack& src) = delete; // No assignment
 
+protected:
+  void setModified() { ++modCnt; } // By every change of the geometry
+
 public: 
   explicit AbstractTrack();
   explicit AbstractTrack(const AbstractTrack& cp);
@@ -34,6 +56,10 @@ public:
 
   virtual void clear() = 0;
 
+  // Changes with every modification, results derived from
+  // the track stay valid as long as it is the same:
+  const unsigned& getModCount() const { return modCnt; }
+
   // virtual void reverse() = 0;
 
   virtual bool isClosed() const = 0;
@@ -58,6 +84,33 @@ public:
 
   virtual void getXDir(double at_s, Ino::Vec3& x, Ino::Vec3& xDer) const = 0;
 
+  // As above, cursor: caller owned lookup hint (initially -1) that makes
+  // runs of nearby at_s cheap. The track itself is not modified.
+  // By default the cursor is ignored:
+
+  virtual void getPoint(double at_s, Ino::Vec3& p, int& cursor) const
+                                              { getPoint(at_s,p); }
+  virtual void getPointAndDir(double at_s, Ino::Vec3& pnt, Ino::Vec3& dir,
+                   int& cursor) const { getPointAndDir(at_s,pnt,dir); }
+  virtual void getDir(double at_s, Ino::Vec3& dir, int& cursor) const
+                                              { getDir(at_s,dir); }
+  virtual void getAcc(double at_s, Ino::Vec3& acc, int& cursor) const
+                                              { getAcc(at_s,acc); }
+  virtual void getJerk(double at_s, Ino::Vec3& jerk, int& cursor) const
+                                              { getJerk(at_s,jerk); }
+
+  virtual void getXDir(double at_s, Ino::Vec3& x, Ino::Vec3& xDer,
+                          int& cursor) const { getXDir(at_s,x,xDer); }
+
+  // Point, dir, acc and x-direction (and jerk if maxOrder > 2) at once.
+  // By default through the functions above:
+
+  virtual void evaluate(double at_s, int maxOrder, TrackSample& smp,
+                                                    int& cursor) const;
+
+  void evaluate(double at_s, int maxOrder, TrackSample& smp) const
+                   { int cursor = -1; evaluate(at_s,maxOrder,smp,cursor); }
+
   virtual double findPoint(const Ino::Vec3& p) const = 0;
 };
 
@@ -19,6 +19,8 @@
 #include "Trf.h"
 #include "Array.h"
 
+#include <vector>
+
 namespace InoKin {
 
 //---------------------------------------------------------------------------
@@ -75,10 +77,36 @@ class ArcLinTrack : public AbstractTrack
   double trackPipeRadius;
   double length;
 
-  void findPointPair(double at_s, int& lowidx,
-                              int& hghidx, double& relParm) const;
+  // Bounding boxes of the segments between the track points, a binary
+  // tree over consecutive segments, built by validate(). Node k has
+  // corners boxLst[2k] and boxLst[2k+1] and children 2k+1 and 2k+2:
+  std::vector<Ino::Vec3> boxLst;
+
+  void findPointPair(double at_s, int& lowidx, int& hghidx,
+                     double& relParm, int& cursor) const;
   int findUpper(double at_s) const;
 
+  int getSegCnt() const;
+  double getSegSpan(int seg) const;
+  void getSegPoint(int seg, double rel, Ino::Vec3& p,
+                                        Ino::Vec3& v, Ino::Vec3& a) const;
+  double nearestOnSeg(const Ino::Vec3& p, int seg, double lwb, double upb,
+                                      double& rel, Ino::Vec3& trkPt) const;
+
+  void buildBoxTree();
+  void buildBox(int node, int fst, int cnt);
+
+  void nearestOnSegs(const Ino::Vec3& p, int fst, int cnt, bool ranged,
+                     double minS, double maxS, int& bestSeg,
+                     double& minDist, double& bestS, Ino::Vec3& trkPt) const;
+  double nearestPoint(const Ino::Vec3& p, bool ranged, double minS,
+                      double maxS, int& seg, Ino::Vec3& trkPt) const;
+
+  void setCoTrackRange(const ArcLinTrack& coTrk, bool reverseDir,
+                       double maxSDiff, int fst, int cnt, double lastS);
+
+  enum { CoTrackChunk = 1024 }; // Points per chunk of setCoTrackParallel()
+
   ArcLinTrack& operator=(const ArcLinTrack& src) = delete; // No assignment
 
 public:
@@ -111,6 +139,10 @@ public:
 
   void setCoTrack(const ArcLinTrack& coTrk, bool reverseDir, double maxSDiff);
 
+  // As setCoTrack, in chunks on threadCnt threads (0: all cores):
+  void setCoTrackParallel(const ArcLinTrack& coTrk, bool reverseDir,
+                          double maxSDiff, int threadCnt = 0);
+
   double getLength() const { return length; }
 
   double getMaxS() const;
@@ -118,8 +150,8 @@ public:
   double getPipeRadius() const { return trackPipeRadius; }   // Track pipe radius
   double getPipeDiameter() const { return trackPipeRadius * 2.0; }
 
-  void setPipeRadius(double radius) { trackPipeRadius = radius; }
-  void setPipeDiameter(double diameter) { trackPipeRadius = diameter/2.0; }
+  void setPipeRadius(double radius) { trackPipeRadius = radius; setModified(); }
+  void setPipeDiameter(double diameter) { setPipeRadius(diameter/2.0); }
 
   virtual void getPoint(double at_s, Ino::Vec3& p) const;
   virtual void getPointAndDir(double at_s, Ino::Vec3& pnt, Ino::Vec3& dir) const;
@@ -129,6 +161,21 @@ public:
 
   virtual void getXDir(double at_s, Ino::Vec3& x, Ino::Vec3& xDer) const;
 
+  virtual void getPoint(double at_s, Ino::Vec3& p, int& cursor) const;
+  virtual void getPointAndDir(double at_s, Ino::Vec3& pnt, Ino::Vec3& dir,
+                                                      int& cursor) const;
+  virtual void getDir(double at_s, Ino::Vec3& v, int& cursor) const;
+  virtual void getAcc(double at_s, Ino::Vec3& acc, int& cursor) const;
+  virtual void getJerk(double at_s, Ino::Vec3& jerk, int& cursor) const;
+
+  virtual void getXDir(double at_s, Ino::Vec3& x, Ino::Vec3& xDer,
+                                               int& cursor) const;
+
+  using AbstractTrack::evaluate;
+
+  virtual void evaluate(double at_s, int maxOrder, TrackSample& smp,
+                                                    int& cursor) const;
+
   double findPoint(const Ino::Vec3& p) const;
   double findPoint(const Ino::Vec3& p, Ino::Vec3& trkPt) const;
   double findPoint(const Ino::Vec3& p, double minS, double maxS,
@@ -148,6 +195,8 @@ extern "C" __declspec(dllexport) int ArcLinTrackAddTrackPoint(void *track, doubl
 
 extern "C" __declspec(dllexport) void ArcLinTrackSetCoTrack(void *track, void *coTrack, bool reverseDir, double maxSDiff);
 
+extern "C" __declspec(dllexport) void ArcLinTrackSetCoTrackParallel(void *track, void *coTrack, bool reverseDir, double maxSDiff, int threadCnt);
+
 extern "C" __declspec(dllexport) int ArcLinTrackGetSize(void *track);
 
 extern "C" __declspec(dllexport) double ArcLinTrackGetMaxS(void *track);
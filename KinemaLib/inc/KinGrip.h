@@ -33,7 +33,7 @@ class GripList;
 
 class Grip : public Object
 {
-  Ino::Trf3& pos1, &invPos1, &pos2, &invPos2;
+  Ino::Trf3 pos1, invPos1, pos2, invPos2;
   Body *body1, *body2;
   AbstractJoint *joint;
 
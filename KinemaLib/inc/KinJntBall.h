@@ -13,7 +13,7 @@
 #ifndef INOKIN_JNTBALL_INC
 #define INOKIN_JNTBALL_INC
 
-#include "KinAbstractJoint.h"
+#include "KinJntKernel.h"
 
 namespace InoKin {
 
@@ -25,7 +25,7 @@ namespace InoKin {
 
 class Grip;
 
-class JntBall : public AbstractJoint
+class JntBall : public JntKernel<JntBall>
 {
   JntBall(const JntBall& cp) = delete;            // No copying
   JntBall& operator=(const JntBall& cp) = delete; // No assignment
@@ -33,10 +33,9 @@ class JntBall : public AbstractJoint
 protected:
   virtual AbstractJoint *clone(Grip& newGrip) const;
 
-  virtual void getVarTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const;
+  void varTrfKernel(int idx, int kind, Ino::Trf3& trf) const;
+
+  friend class JntKernel<JntBall>;
 
 public:
   explicit JntBall(Grip& grp, const wchar_t *name);
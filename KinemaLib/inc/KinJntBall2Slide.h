@@ -13,7 +13,7 @@
 #ifndef INOKIN_JNTBALL2SLIDE_INC
 #define INOKIN_JNTBALL2SLIDE_INC
 
-#include "KinAbstractJoint.h"
+#include "KinJntKernel.h"
 
 namespace InoKin {
 
@@ -27,7 +27,7 @@ namespace InoKin {
 
 // ATTN: Joint is unstable if all rotations are near zero!
 
-class JntBall2Slide : public AbstractJoint
+class JntBall2Slide : public JntKernel<JntBall2Slide>
 {
   JntBall2Slide(const JntBall2Slide& cp) = delete;            // No copying
   JntBall2Slide& operator=(const JntBall2Slide& cp) = delete; // No assignment
@@ -35,10 +35,9 @@ class JntBall2Slide : public AbstractJoint
 protected:
   virtual AbstractJoint *clone(Grip& newGrip) const;
 
-  virtual void getVarTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const;
+  void varTrfKernel(int idx, int kind, Ino::Trf3& trf) const;
+
+  friend class JntKernel<JntBall2Slide>;
 
 public:
   explicit JntBall2Slide(Grip& grp, const wchar_t *name);
@@ -13,7 +13,7 @@
 #ifndef INOKIN_JNTBALLSLIDE_INC
 #define INOKIN_JNTBALLSLIDE_INC
 
-#include "KinAbstractJoint.h"
+#include "KinJntKernel.h"
 
 namespace InoKin {
 
@@ -24,7 +24,7 @@ namespace InoKin {
 // varPos[2] = rotation about x-axis
 // varPos[3] = slide along (transformed) z-axis
 
-class JntBallSlide : public AbstractJoint
+class JntBallSlide : public JntKernel<JntBallSlide>
 {
   JntBallSlide(const JntBallSlide& cp) = delete;            // No copying
   JntBallSlide& operator=(const JntBallSlide& cp) = delete; // No assignment
@@ -32,10 +32,9 @@ class JntBallSlide : public AbstractJoint
 protected:
   virtual AbstractJoint *clone(Grip& newGrip) const;
 
-  virtual void getVarTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const;
+  void varTrfKernel(int idx, int kind, Ino::Trf3& trf) const;
+
+  friend class JntKernel<JntBallSlide>;
 
 public:
   explicit JntBallSlide(Grip& grp, const wchar_t *name);
@@ -13,7 +13,7 @@
 #ifndef INOKIN_JNTCROSS_INC
 #define INOKIN_JNTCROSS_INC
 
-#include "KinAbstractJoint.h"
+#include "KinJntKernel.h"
 
 namespace InoKin {
 
@@ -22,7 +22,7 @@ namespace InoKin {
 // varPos[0] = rotation about z-axis
 // varPos[1] = rotation about y-axis
 
-class JntCross : public AbstractJoint
+class JntCross : public JntKernel<JntCross>
 {
   JntCross(const JntCross& cp) = delete;            // No copying
   JntCross& operator=(const JntCross& cp) = delete; // No assignment
@@ -30,10 +30,9 @@ class JntCross : public AbstractJoint
 protected:
   virtual AbstractJoint *clone(Grip& newGrip) const;
 
-  virtual void getVarTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const;
+  void varTrfKernel(int idx, int kind, Ino::Trf3& trf) const;
+
+  friend class JntKernel<JntCross>;
 
 public:
   explicit JntCross(Grip& grp, const wchar_t *name);
@@ -0,0 +1,157 @@
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Kinema: Kinematic Simulation Program ---------------------------
+//---------------------------------------------------------------------------
+//-------------------- Copyright Inofor Hoek Aut BV Dec 1999-2013 -----------
+//-------------------------------------------------- C.Wolters --------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Compile time specialised joint var transforms ------------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#ifndef INOKIN_JNTKERNEL_INC
+#define INOKIN_JNTKERNEL_INC
+
+#include "KinAbstractJoint.h"
+
+#include <cmath>
+
+namespace InoKin {
+
+//---------------------------------------------------------------------------
+// Rotation about axis (0 = x, 1 = y, 2 = z) and its derivatives, kind as
+// AbstractJoint::VarTrfKind. The n-th derivative is the rotation over
+// q + n*pi/2 without the unit axis element.
+
+template <int Axis> inline void rotVarTrf(double q, int kind, Ino::Trf3& trf)
+{
+  constexpr int i = Axis == 2 ? 0 : (Axis == 1 ? 2 : 1);
+  constexpr int j = Axis == 2 ? 1 : (Axis == 1 ? 0 : 2);
+
+  double c = cos(q);
+  double s = sin(q);
+
+  if (kind == AbstractJoint::PosTrf || kind == AbstractJoint::InvPosTrf) {
+    trf.init();
+    trf.isDerivative = false;
+
+    if (kind == AbstractJoint::InvPosTrf) s = -s;
+  }
+  else {
+    trf.zero();
+    trf.isDerivative = true;
+
+    for (int n=AbstractJoint::DerTrf; n<=kind; ++n) {
+      double t = c; c = -s; s = t;
+    }
+  }
+
+  trf(i,i) =  c; trf(i,j) = s;
+  trf(j,i) = -s; trf(j,j) = c;
+}
+
+//---------------------------------------------------------------------------
+// Translation dir * q along axis and its derivatives
+
+template <int Axis> inline void slideVarTrf(double q, double dir, int kind,
+                                                          Ino::Trf3& trf)
+{
+  if (kind == AbstractJoint::PosTrf || kind == AbstractJoint::InvPosTrf) {
+    trf.init();
+    trf.isDerivative = false;
+
+    trf(Axis,3) = kind == AbstractJoint::PosTrf ? dir*q : -dir*q;
+  }
+  else {
+    trf.zero();
+    trf.isDerivative = true;
+
+    if (kind == AbstractJoint::DerTrf) trf(Axis,3) = dir;
+  }
+}
+
+//---------------------------------------------------------------------------
+// Base of the concrete joints: Jnt provides
+//
+//   void varTrfKernel(int idx, int kind, Ino::Trf3& trf) const;
+//
+// The virtual getVar..Trf() of AbstractJoint are implemented with it,
+// updateAll() fills the var trf caches of a list of joints of type Jnt
+// without virtual calls. The Topology groups its joints by type for it.
+
+template <class Jnt> class JntKernel : public AbstractJoint
+{
+  const Jnt& jnt() const { return static_cast<const Jnt&>(*this); }
+
+  void updateKernel(int derivOrder) const
+  {
+    static const int kindLst[VarTrfKinds] = {
+      PosTrf, InvPosTrf, DerTrf, Der2Trf, Der3Trf
+    };
+
+    checkDependency();
+
+    int kindCnt = derivOrder < 1 ? 2 : (derivOrder > 3 ? 5 : derivOrder+2);
+
+    for (int i=0; i<varCnt; ++i) {
+      for (int k=0; k<kindCnt; ++k) {
+        int c = i*VarTrfKinds + kindLst[k];
+        if (varTrfKey[c] == varPos[i]) continue;
+
+        jnt().varTrfKernel(i,kindLst[k],varTrfCache[c]);
+        varTrfKey[c] = varPos[i];
+      }
+
+      if (derivOrder > 0) getInvDerivative(i);
+    }
+  }
+
+protected:
+  virtual void getVarTrf(int idx, Ino::Trf3& trf) const final
+  {
+    jnt().varTrfKernel(idx,PosTrf,trf);
+  }
+
+  virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const final
+  {
+    jnt().varTrfKernel(idx,DerTrf,trf);
+  }
+
+  virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const final
+  {
+    jnt().varTrfKernel(idx,Der2Trf,trf);
+  }
+
+  virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const final
+  {
+    jnt().varTrfKernel(idx,Der3Trf,trf);
+  }
+
+  virtual void getVarInvTrf(int idx, Ino::Trf3& trf) const final
+  {
+    jnt().varTrfKernel(idx,InvPosTrf,trf);
+  }
+
+public:
+  explicit JntKernel(Grip& grp, const wchar_t *name, int nrVars)
+  : AbstractJoint(grp,name,nrVars) {}
+
+  explicit JntKernel(Grip& newGrp, const AbstractJoint& cp)
+  : AbstractJoint(newGrp,cp) {}
+
+  // All joints in jntLst are of type Jnt:
+  static void updateAll(AbstractJoint *const *jntLst, int cnt, int derivOrder)
+  {
+    for (int i=0; i<cnt; ++i) {
+      static_cast<const JntKernel&>(*jntLst[i]).updateKernel(derivOrder);
+    }
+  }
+
+  virtual VarTrfUpdater getVarTrfUpdater() const final { return &updateAll; }
+};
+
+} // namespace
+
+//---------------------------------------------------------------------------
+#endif
@@ -13,7 +13,7 @@
 #ifndef INOKIN_JNTREV_INC
 #define INOKIN_JNTREV_INC
 
-#include "KinAbstractJoint.h"
+#include "KinJntKernel.h"
 
 namespace InoKin {
 
@@ -21,7 +21,7 @@ namespace InoKin {
 
 // varPos[0] = rotation about z-axis
 
-class JntRev : public AbstractJoint
+class JntRev : public JntKernel<JntRev>
 {
   JntRev(const JntRev& cp) = delete;            // No copying
   JntRev& operator=(const JntRev& cp) = delete; // No assignment
@@ -29,10 +29,9 @@ class JntRev : public AbstractJoint
 protected:
   virtual AbstractJoint *clone(Grip& newGrip) const;
 
-  virtual void getVarTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const;
+  void varTrfKernel(int idx, int kind, Ino::Trf3& trf) const;
+
+  friend class JntKernel<JntRev>;
 
 public:
   explicit JntRev(Grip& grp, const wchar_t *name);
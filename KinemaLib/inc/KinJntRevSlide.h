@@ -13,7 +13,7 @@
 #ifndef INOKIN_JNTREVSLIDE_INC
 #define INOKIN_JNTREVSLIDE_INC
 
-#include "KinAbstractJoint.h"
+#include "KinJntKernel.h"
 
 namespace InoKin {
 
@@ -22,7 +22,7 @@ namespace InoKin {
 // varPos[0] = rotation about z-axis
 // varPos[1] = slide along z-axis
 
-class JntRevSlide : public AbstractJoint
+class JntRevSlide : public JntKernel<JntRevSlide>
 {
   JntRevSlide(const JntRevSlide& cp) = delete;            // No copying
   JntRevSlide& operator=(const JntRevSlide& cp) = delete; // No assignment
@@ -30,10 +30,9 @@ class JntRevSlide : public AbstractJoint
 protected:
   virtual AbstractJoint *clone(Grip& newGrip) const;
 
-  virtual void getVarTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const;
+  void varTrfKernel(int idx, int kind, Ino::Trf3& trf) const;
+
+  friend class JntKernel<JntRevSlide>;
 
 public:
   explicit JntRevSlide(Grip& grp, const wchar_t *name);
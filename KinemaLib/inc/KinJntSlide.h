@@ -12,13 +12,13 @@
 #ifndef INOKIN_JNTSLIDE_INC
 #define INOKIN_JNTSLIDE_INC
 
-#include "KinAbstractJoint.h"
+#include "KinJntKernel.h"
 
 namespace InoKin {
 
 //-------------------------------------------------------------------------------
 
-class JntSlide : public AbstractJoint
+class JntSlide : public JntKernel<JntSlide>
 {
   JntSlide(const JntSlide& cp) = delete;            // No copying
   JntSlide& operator=(const JntSlide& cp) = delete; // No assignment
@@ -26,10 +26,9 @@ class JntSlide : public AbstractJoint
 protected:
   virtual AbstractJoint *clone(Grip& newGrip) const;
 
-  virtual void getVarTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const;
-  virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const;
+  void varTrfKernel(int idx, int kind, Ino::Trf3& trf) const;
+
+  friend class JntKernel<JntSlide>;
 
 public:
   explicit JntSlide(Grip& grp, const wchar_t *name);
@@ -14,7 +14,7 @@
 #ifndef INOKIN_JNTTRACK_INC
 #define INOKIN_JNTTRACK_INC
 
-#include "KinAbstractJoint.h"
+#include "KinJntKernel.h"
 #include "KinAbstractTrack.h"
 
 namespace InoKin {
@@ -29,22 +29,48 @@ namespace InoKin {
 // Z-Axis = wheel rotation axis
 // Y-Axis = travel direction
 
-  class JntTrack : public AbstractJoint
+  class JntTrack : public JntKernel<JntTrack>
   {
     double rad;
 
     const AbstractTrack* trk;
 
+    // The members below are written by const lookups. Concurrent use is
+    // safe only after a single threaded warm-up has filled the caches for
+    // the current varPos: Topology::updateJointTrfCaches() before the
+    // loops run in parallel (see forEachLoop()), or updateTrfCaches().
+    // Without it the threads would race on trkCursor and the cache.
+
+    mutable int trkCursor; // Track segment of the last lookup
+
     JntTrack(const JntTrack& cp) = delete;           // No copying
     JntTrack& operator=(const JntTrack& src) = delete; // No assignment
 
+    // The track at varPos[0] == trkKey, for track modification count
+    // trkModKey. Shared by all var trf kinds of varPos[0]. The var 0
+    // position trf is the inverse of the track frame (PosTrf: trkInvFrame,
+    // InvPosTrf: trkFrame):
+    mutable TrackSample trkSmp;
+    mutable Ino::Trf3 trkInvFrame, trkFrame, trkDerTrf;
+    mutable double trkKey;
+    mutable unsigned trkModKey;
+    mutable bool trkDerValid;
+
+    void updateTrack(int maxOrder) const;
+    void clearTrackCache();
+
+    // varPos[0] only, after updateTrack()
+    const Ino::Trf3& getTrackDerTrf() const;
+    void getTrackDerTrf(Ino::Trf3& trf) const;
+    void getTrackDer2Trf(Ino::Trf3& trf) const;
+    void getTrackDer3Trf(Ino::Trf3& trf) const;
+
   protected:
     virtual AbstractJoint* clone(Grip& newGrip) const;
 
-    virtual void getVarTrf(int idx, Ino::Trf3& trf) const;
-    virtual void getVarDerTrf(int idx, Ino::Trf3& trf) const;
-    virtual void getVarDer2Trf(int idx, Ino::Trf3& trf) const;
-    virtual void getVarDer3Trf(int idx, Ino::Trf3& trf) const;
+    void varTrfKernel(int idx, int kind, Ino::Trf3& trf) const;
+
+    friend class JntKernel<JntTrack>;
 
   public:
 
@@ -55,7 +81,7 @@ namespace InoKin {
     virtual void initVarsFromPos(bool fixedAlso);
 
     double getWheelRad() const { return rad; }
-    void setWheelRad(double newRad) { rad = newRad; }
+    void setWheelRad(double newRad) { rad = newRad; clearVarTrfCache(); }
 
     const AbstractTrack& getTrack() const { return *trk; }
 
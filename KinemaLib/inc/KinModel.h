@@ -12,6 +12,8 @@
 
 #include "Vec.h"
 
+#include <atomic>
+
 namespace Ino {
   class Trf3;
 }
@@ -31,7 +33,8 @@ class TopologyList;
 class Model
 {
   wchar_t *mdlName;
-  bool modified;
+  std::atomic<bool> modified; // Set by topologies solved concurrently
+  std::atomic<unsigned> posVersion; // Bumped by setPosModified()
 
   Ino::Vec3 offset;
 
@@ -75,6 +78,10 @@ public:
 
   bool isModified() const { return modified; }
 
+  // Var positions set outside of a Topology solve, see AbstractJoint::setVal
+  void setPosModified() { modified = true; ++posVersion; }
+  unsigned getPosVersion() const { return posVersion; }
+
   const BodyList& getBodyList() const { return bodyLst; }
   const GripList& getGripList() const { return gripLst; }
   const FunctionList& getFunctionList() const { return funcLst; }
@@ -121,6 +128,8 @@ extern "C" __declspec(dllexport) void TransformModel(void* cppModel, const Ino::
 extern "C" __declspec(dllexport) bool BuildTopologyModel(void* cppModel);
 extern "C" __declspec(dllexport) int  GetTopologySizeModel(void* cppModel);
 extern "C" __declspec(dllexport) void *GetTopologyModel(void* cppModel, int index);
+extern "C" __declspec(dllexport) bool SolveAllTopologiesModel(void* cppModel, int maxIter, double rotTol, double posTol,
+                                                             int derivOrder, int threadCnt);
 
 // End Interface Section
 
@@ -14,6 +14,8 @@
 
 #include "Array.h"
 
+#include <unordered_map>
+
 namespace InoKin {
 
 //---------------------------------------------------------------------------
@@ -40,6 +42,9 @@ public:
   void setIds() const;
 
   T *byId(int id) const;
+
+  // The index of each object, without setting the ids:
+  void getIndexMap(std::unordered_map<const T *, int>& idxMap) const;
 };
 
 //-------------------------------------------------------------------------------
@@ -163,6 +168,19 @@ template <class T> T *ObjList<T>::byId(int id) const
   return NULL;
 }
 
+//---------------------------------------------------------------------------
+
+template <class T>
+void ObjList<T>::getIndexMap(std::unordered_map<const T *, int>& idxMap) const
+{
+  idxMap.clear();
+
+  int sz = size();
+  idxMap.reserve(sz);
+
+  for (int i=0; i<sz; ++i) idxMap[get(i)] = i;
+}
+
 } // namespace
 
 //-------------------------------------------------------------------------------
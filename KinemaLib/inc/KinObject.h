@@ -15,6 +15,8 @@
 
 #include "Array.h"
 
+#include <memory>
+
 namespace InoKin {
 
 //---------------------------------------------------------------------------
@@ -23,7 +25,7 @@ class Model;
 
 class Object : public Ino::ArrayElem
 {
-  wchar_t *nam;
+  std::shared_ptr<const wchar_t[]> nam; // Shared with the clones
   mutable int id;
 
   Object(const Object& cp) = delete;             // No copying
@@ -36,7 +38,7 @@ public:
   explicit Object(Model& kmodel, const Object& cp);
   virtual ~Object();
 
-  const wchar_t *getName() const { return nam; }
+  const wchar_t *getName() const { return nam.get(); }
   void setName(const wchar_t *newName);
 
   int getId() const { return id; }
@@ -44,6 +46,7 @@ public:
 
   void setModelTopoModified() const;
   void setModelModified() const;
+  void setModelPosModified() const;
 };
 
 } // namespace
@@ -27,7 +27,7 @@ class Body;
 
 class Probe : public Object
 {
-  Ino::Trf3& pos;
+  Ino::Trf3 pos;
 
   Probe(const Probe& cp) = delete;             // No copying
   Probe& operator=(const Probe& src) = delete; // No Assignment
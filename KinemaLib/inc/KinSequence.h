@@ -47,6 +47,10 @@ public:
 
   void addCurrentTopoState();
 
+  // Appends copies of the states of src from fstIdx on,
+  // src must be of a topology with the same vars (e.g. a clone):
+  void appendStates(const Sequence& src, int fstIdx=0);
+
   void writeSequence();
 
   friend class Topology;
@@ -0,0 +1,51 @@
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Kinema: Kinematic Simulation Program ---------------------------
+//---------------------------------------------------------------------------
+//-------------------- Copyright Inofor Hoek Aut BV Dec 1999-2013 -----------
+//-------------------------------------------------- C.Wolters --------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Vectorized kernels for the 6 x k loop Jacobians ----------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#ifndef INOKIN_SIMD_INC
+#define INOKIN_SIMD_INC
+
+namespace InoKin {
+
+//---------------------------------------------------------------------------
+// The matrix C is 6 x sz, stored as six rows of stride values each.
+// The instruction set is chosen at the first call, AVX-512 and AVX2
+// if the processor and the operating system support them.
+
+class Simd
+{
+public:
+  enum Level {
+    Scalar = 0,
+    Avx2   = 1, // AVX2 and FMA
+    Avx512 = 2  // AVX-512F
+  };
+
+  static Level getSupported();  // Of this processor
+  static Level getLevel();      // In use
+  static void setLevel(Level level); // At most getSupported()
+
+  // Lower triangle of CT-C, column by column: sz*(sz+1)/2 values:
+  static void gram6(const double *c, int stride, int sz, double *prod);
+
+  // out[i] = sum(k) C(k,fst+i) * v[k], i < cnt:
+  static void project6(const double *c, int stride, int fst, int cnt,
+                                           const double *v, double *out);
+
+  // v[k] += sum(i) C(k,fst+i) * x[i], i < cnt:
+  static void multAdd6(const double *c, int stride, int fst, int cnt,
+                                           const double *x, double *v);
+};
+
+} // namespace
+
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,80 @@
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Kinema: Kinematic Simulation Program ---------------------------
+//---------------------------------------------------------------------------
+//-------------------- Copyright Inofor Hoek Aut BV Dec 1999-2013 -----------
+//-------------------------------------------------- C.Wolters --------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Supernodal sparse LDLT factorization ---------------------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#ifndef INOKIN_SPARSELDLT_INC
+#define INOKIN_SPARSELDLT_INC
+
+#include <vector>
+
+namespace Ino {
+  class Vector;
+}
+
+namespace InoKin {
+
+//---------------------------------------------------------------------------
+// Symmetric matrix with the sparsity of AT-A, A having one group of
+// rows (a clique) per loop.
+// The structure of the factor L is determined once by analyze(),
+// the matrix is then composed with at() and factored in place.
+// Storage is per supernode (consecutive columns with the same structure
+// below the diagonal): a dense column major block of rows x columns.
+
+class SparseLDLT
+{
+  int sz;
+
+  std::vector<int> superLst;  // First column of each supernode, + sz
+  std::vector<int> colSuper;  // Supernode of each column
+  std::vector<int> rowStart;  // Start of the rows of each supernode
+  std::vector<int> rowLst;    // Row indices per supernode, ascending
+  std::vector<int> valStart;  // Start of the block of each supernode
+
+  std::vector<double> aVal;   // Composed matrix (lower part)
+  std::vector<double> lVal;   // Factor, D on the diagonal
+
+  double nonZeros, flops;
+
+  int superRows(int s) const { return rowStart[s+1] - rowStart[s]; }
+  int superCols(int s) const { return superLst[s+1] - superLst[s]; }
+
+public:
+  SparseLDLT();
+
+  void analyze(int size, const std::vector<std::vector<int> >& cliqueLst);
+
+  int size() const { return sz; }
+  int getSuperCnt() const { return (int)superLst.size() - 1; }
+
+  double getNonZeros() const { return nonZeros; } // Of L, diagonal included
+  double getFlops() const { return flops; }       // Per factorization
+
+  void clear(); // Clears the composed matrix
+
+  // Element (row,col) of the composed matrix, row >= col:
+  double& at(int row, int col) { return aVal[indexOf(row,col)]; }
+  double diag(int idx) const;
+
+  // Precomputed access to the composed matrix:
+  int indexOf(int row, int col) const;
+  void addAt(int index, double val) { aVal[index] += val; }
+
+  // Factors the composed matrix with damping * diag added to the diagonal:
+  bool factor(double damping=0.0);
+
+  void solve(Ino::Vector& sol) const;
+};
+
+} // namespace
+
+//---------------------------------------------------------------------------
+#endif
@@ -57,8 +57,8 @@ public:
   double getPipeRadius() const { return trackPipeRadius; }   // Track pipe radius
   double getPipeDiameter() const { return trackPipeRadius * 2.0; }
 
-  void setPipeRadius(double radius) { trackPipeRadius = radius; }
-  void setPipeDiameter(double diameter) { trackPipeRadius = diameter/2.0; }
+  void setPipeRadius(double radius) { trackPipeRadius = radius; setModified(); }
+  void setPipeDiameter(double diameter) { setPipeRadius(diameter/2.0); }
 
   virtual Ino::Vec3 calcCentroid() const;
   virtual void translate(const Ino::Vec3& offset);
@@ -45,6 +45,7 @@ class State : public Ino::ArrayElem
   State(const State& cp) = delete;             // No copying
 
   explicit State(Sequence& sequence, const State& cp);
+  explicit State(Sequence& sequence, int index, const State& cp);
 
 public:
   explicit State(Sequence& sequence, int index, __int64 mdlTm,
@@ -15,6 +15,9 @@
 
 #include "KinTableFunction.h"
 
+#include <atomic>
+#include <mutex>
+
 namespace InoKin {
 
 //---------------------------------------------------------------------------
@@ -23,9 +26,11 @@ class AbstractTrack;
 
 class TableArc : public TableFunction
 {
-  mutable AbstractTrack *trk;
+  mutable std::atomic<AbstractTrack *> trk;
+  mutable std::mutex trkMutex;
 
   void setupTrack() const;
+  const AbstractTrack& getTrack() const;
 
 public:
   explicit TableArc();
@@ -14,10 +14,15 @@
 #define INOKIN_TOPOLOGY_INC
 
 #include "KinGrip.h"
+#include "KinAbstractJoint.h"
 #include "KinSequence.h"
 
 #include "Array.h"
 
+#include <vector>
+#include <functional>
+#include <memory>
+
 namespace Ino {
   class Trf3;
   class Matrix;
@@ -27,19 +32,184 @@ namespace Ino {
 namespace InoKin {
 
 class Model;
+class SparseLDLT;
+class WorkerPool;
 class Body;
 class BodyList;
-class AbstractJoint;
 
 //---------------------------------------------------------------------------
+// The 6 x k Jacobian of one loop, k being the nr of free vars in the loop.
+// The structure is set up once by Topology::prepare(), the columns are
+// in ascending var order, so that the lower triangle of JT-J is the
+// lower triangle of the matrix.
+// Stored row by row for the kernels of KinSimd.h.
 
-class Topology : public LoopList // A List of Grip loops
+class LoopJacobian
 {
-  Model *model;
+public:
+  std::vector<int>    idxLst;  // Global var index of each column
+  std::vector<int>    slotLst; // Column of each free var in loop order
+  std::vector<double> rowLst;  // Six rows of stride values
+  int stride;
 
-  BodyList& topoBodyLst;
-  GripList& topoGripLst;
+  std::vector<double> prodLst; // Lower triangle of JT-J, column by column
+  std::vector<int>    posLst;  // Position of each in the sparse matrix
+
+  double res[6]; // Loop residual at the last composition
+
+  LoopJacobian() : stride(0) { for (int i=0; i<6; ++i) res[i] = 0.0; }
+
+  int size() const { return (int)idxLst.size(); }
+
+  void init(const std::vector<int>& varLst, const SparseLDLT& sparseMat);
+
+  // Column of the n-th free var in loop order:
+  void setColumn(int n, const Ino::Trf3& trf);
+
+  void composeProduct(); // Sets prodLst
+
+  // rhsVec -= transpose(J) * v, v has six elements:
+  void subtractProjection(const double *v, Ino::Vector& rhsVec) const;
+
+  // v += J * x, v has six elements:
+  void addProduct(const Ino::Vector& x, double *v) const;
+};
+
+//---------------------------------------------------------------------------
+// Options for Topology::solvePos()
+
+class SolverOptions
+{
+public:
+  enum NewtonMode {
+    FullNewton  = 0, // Compose and factor the matrix every iteration
+    ChordNewton = 1  // Keep the factored matrix, residual evaluation only
+  };
+
+  enum StepControl {
+    ClampStep   = 0, // Scale the step to at most 10 degrees rotation
+    TrustRegion = 1  // Levenberg-Marquardt damping, residual tested steps
+  };
+
+  enum MatrixMode {
+    AutoMatrix   = 0, // Band or sparse, whichever has the least fill
+    BandMatrix   = 1,
+    SparseMatrix = 2  // Supernodal sparse LDLT
+  };
+
+  NewtonMode newtonMode;
+  double maxContraction; // Refactor if the residual shrinks less than this
+
+  int predictorOrder; // 0: None, 1: Speed, 2: Speed and accel
+
+  StepControl stepControl;
+  double initDamping; // Initial Marquardt parameter (relative to diagonal)
+  int maxStepTries;   // Nr of damping increases before giving up
+
+  MatrixMode matrixMode;
+
+  int threadCnt; // Threads composing the loops, 0: All cores, 1: Serial
+
+  SolverOptions()
+  : newtonMode(FullNewton), maxContraction(0.5), predictorOrder(0),
+    stepControl(TrustRegion), initDamping(1.0e-3), maxStepTries(12),
+    matrixMode(AutoMatrix), threadCnt(1) {}
+};
+
+//---------------------------------------------------------------------------
+// Statistics of Topology::solvePos()
+
+class SolverStats
+{
+public:
+  int solveCnt;      // Nr of successful solves
+  int iterCnt;       // Total nr of iterations of these
+  int predictCnt;    // Nr of solves started from a predicted position
+  double itersSaved; // Estimated nr of iterations saved by the predictor
+
+  SolverStats() : solveCnt(0), iterCnt(0), predictCnt(0), itersSaved(0.0) {}
+};
+
+//---------------------------------------------------------------------------
+// Structure of the position matrix AT-A, see Topology::getMatrixStats()
+
+class MatrixStats
+{
+public:
+  enum VarOrdering {
+    LoopOrder     = 0, // Order of the loop scan
+    CuthillMcKee  = 1, // Reverse Cuthill-McKee, least bandwidth
+    MinimumDegree = 2  // Least fill of the sparse factor
+  };
+
+  int rowSz, colSz, varSz;
+  VarOrdering ordering;
+  bool sparse;     // Sparse or band storage in use
+
+  double nonZeros; // Of AT-A (lower half, diagonal included)
+  double fill;     // Nonzeros of the factor not in AT-A
+  double flops;    // Per factorization
+
+  MatrixStats()
+  : rowSz(0), colSz(0), varSz(0), ordering(LoopOrder), sparse(false),
+    nonZeros(0.0), fill(0.0), flops(0.0) {}
+};
+
+//---------------------------------------------------------------------------
+// A fixed var that follows the drive var of Topology::sweep()
+
+class SweepCoupling
+{
+public:
+  AbstractJoint *jnt;
+  int locIdx;
+  double ratio; // Advance of this var per unit advance of the drive var
+
+  SweepCoupling(AbstractJoint& joint, int idx, double rat)
+  : jnt(&joint), locIdx(idx), ratio(rat) {}
+};
+
+//---------------------------------------------------------------------------
+// Options for Topology::sweep()
+
+class SweepOptions
+{
+public:
+  int maxIter;
+  double rotTol, posTol;
+
+  int derivOrder;    // 0: Positions only, 1: Speeds, 2: Accels, 3: Jerks
+  double driveSpeed; // Speed of the drive var (accel and jerk are zero)
+
+  bool adaptive;        // Vary the step size
+  double maxStepFactor; // Max step is this times the given step
+  int targetIter;       // Shrink the step above, grow it at half this
+  double maxDeviation;  // Max free var deviation from the secant prediction
+  int maxHalvings;      // Step halvings on non-convergence before giving up
+
+  std::vector<SweepCoupling> couplingLst;
+
+  SweepOptions()
+  : maxIter(50), rotTol(1.0e-5), posTol(1.0e-5),
+    derivOrder(0), driveSpeed(1.0),
+    adaptive(false), maxStepFactor(8.0), targetIter(6),
+    maxDeviation(0.05), maxHalvings(8) {}
+
+  // Throws IllegalArgumentException if the var is not fixed:
+  void addCoupling(AbstractJoint& jnt, int locIdx, double ratio);
+};
 
+//---------------------------------------------------------------------------
+// What Topology::prepare() derives from the loops: the sizes, the var
+// ordering and its statistics. Not changed afterwards, a new one is made
+// by the next prepare(). Shared by the topologies of the model clones.
+
+class TopologyStructure
+{
+  TopologyStructure(const TopologyStructure& cp) = delete;             // No copying
+  TopologyStructure& operator=(const TopologyStructure& src) = delete; // No assignment
+
+public:
   int rowSz;
   int colSz;
   int varSz;
@@ -47,19 +217,118 @@ class Topology : public LoopList // A List of Grip loops
 
   bool *angularVar;
 
-  bool posValid, speedValid, accelValid, jerkValid;
+  bool sparseAdvised; // Less fill than the band matrix
 
-  SequenceList seqLst;
+  // Set by Topology::orderVars():
+  MatrixStats::VarOrdering varOrdering;
+  double posNonZeros, bandNonZeros, bandFlops;
+
+  TopologyStructure()
+  : rowSz(0), colSz(0), varSz(0), fixedSz(0), angularVar(NULL),
+    sparseAdvised(false), varOrdering(MatrixStats::LoopOrder),
+    posNonZeros(0.0), bandNonZeros(0.0), bandFlops(0.0) {}
 
-  Ino::Matrix& prepMat;
+  ~TopologyStructure() { delete[] angularVar; }
+};
+
+//---------------------------------------------------------------------------
+// The working storage of the solvers of a Topology.
+// A copy keeps the sparse analysis and the loop Jacobian layout,
+// the matrices, factors and predictor state start empty.
+// A first step only: the joint vars and trf caches and the body frames
+// still live in the model objects. Two solves can not share one model
+// yet, concurrent solves each need their own model clone (sweepParallel).
+
+class SolverContext
+{
+  SolverContext& operator=(const SolverContext& src) = delete; // No assignment
+
+public:
   Ino::Matrix& solMat;
   Ino::Vector& rhs;
 
   Ino::Matrix solMat2;
-  Ino::Matrix speedMat2;
   Ino::Vector solRhs2;
   Ino::Vector speedRhs2;
 
+  // Sparse alternative for solMat and posFactor,
+  // its structure is analyzed by Topology::prepare():
+  SparseLDLT& sparseMat;
+
+  // LDLT factor of the converged position matrix, shared by the
+  // speed, accel and jerk solvers:
+  Ino::Matrix posFactor;
+  double posFactorDamping; // Marquardt parameter added before factoring
+  bool posFactorValid;
+  bool chordFactorValid; // posFactor usable, possibly for other positions
+  unsigned posFactorVersion; // Model::getPosVersion() when factored
+
+  // Last converged state, base of the Taylor predictor:
+  Ino::Vector prdPos, prdFixedPos;
+  Ino::Vector prdSpeed, prdFixedSpeed;
+  Ino::Vector prdAccel;
+  bool prdPosValid, prdSpeedValid, prdAccelValid;
+
+  std::vector<LoopJacobian> loopJacLst;
+
+  SolverContext();
+  explicit SolverContext(const SolverContext& cp);
+  ~SolverContext();
+
+  void clear();
+};
+
+//---------------------------------------------------------------------------
+
+class Topology : public LoopList // A List of Grip loops
+{
+  Model *model;
+
+  BodyList& topoBodyLst;
+  GripList& topoGripLst;
+
+  std::shared_ptr<TopologyStructure> structure; // Shared with the clones
+
+  bool posValid, speedValid, accelValid, jerkValid;
+
+  SequenceList seqLst;
+
+  SolverContext& ctx;
+
+  SolverOptions solverOptions;
+  SolverStats solverStats;
+
+  // The joints of one type, see AbstractJoint::getVarTrfUpdater():
+  struct JointGroup {
+    AbstractJoint::VarTrfUpdater updater;
+    std::vector<AbstractJoint *> jntLst;
+  };
+
+  std::vector<JointGroup> jointGroupLst;
+
+  // The tree grips breadth first, down: from body1 to body2.
+  // Only this walk order (and the joint vars, see varStore) is compacted,
+  // the bodies, grips and joints stay where they were allocated: the C#
+  // wrappers and the lists of the model hold pointers to them.
+  struct TreeStep {
+    Grip *grip;
+    bool down;
+  };
+
+  std::vector<TreeStep> treeStepLst;
+
+  // The vars of the joints in blocks of pos, speed, accel and jerk, each
+  // joint by joint. Solver var i is at freeSlotLst[i] (fixedSlotLst[i]):
+  enum { StorePos = 0, StoreSpeed = 1, StoreAccel = 2, StoreJerk = 3 };
+
+  std::vector<double> varStore;
+  std::vector<int> freeSlotLst, fixedSlotLst;
+
+  std::vector<AbstractJoint *> varJntLst; // Attached to varStore
+  std::vector<char> varJntMask;           // 1: free vars, 2: fixed vars
+
+  WorkerPool *workerPool; // If solverOptions.threadCnt != 1
+
   void updateJointTransforms();
   void loopScan(LoopList& loopLst, int idx);
   void analyzeLoops();
@@ -67,21 +336,63 @@ class Topology : public LoopList // A List of Grip loops
   void buildLoop(Grip *grp);
   void assignVarIndices(LoopList& loopLst);
   void setLoopCounts();
+  void getVarCliques(std::vector<std::vector<int> >& cliqueLst) const;
+  void renumberVars(const std::vector<int>& perm);
+  void orderVars();
+  void buildLoopJacobians();
+  void buildTreeSteps();
+  void groupJoints();
+  void updateJointTrfCaches(int derivOrder);
+  void attachJointVars();
+  void detachJointVars();
+  void gatherVars(int qty, bool fixed, Ino::Vector& vec) const;
+  void scatterVars(int qty, bool fixed, const Ino::Vector& vec);
+  void scatterVars(int qty, const Ino::Vector& varVec,
+                            const Ino::Vector& fixedVec);
+  void updateJointVars(int qty, int mask);
   void sizeMats();
 
-  bool composePosMatrixRow(const GripList& grpLst,
+  // derivOrder: the joint trfs func reads, 0: positions only
+  void forEachLoop(const std::function<void(int)>& func, int derivOrder=1);
+
+  bool composePosMatrixRow(const GripList& grpLst, LoopJacobian& loopJac,
                            double& maxRot, double& maxDist);
-  bool composePosEq(double& maxRot, double& maxDist, int& maxIdx);
+  void addPosMatrixRow(const LoopJacobian& loopJac);
+  bool composePosEq(double& maxRot, double& maxDist, int& maxIdx,
+                                                       double& resNorm);
+  bool composePosRhs(double& maxRot, double& maxDist, int& maxIdx,
+                                                       double& resNorm);
   void limitSolution(Ino::Vector& sol);
 
-  bool composeSpeedMatrixRow(const GripList& grpLst);
-  bool composeSpeedEq();
+  double predictedResidual(const Ino::Vector& step) const;
+  bool dampedStep(bool refactor, double resNorm, double& damping,
+                  double& dampFac, Ino::Vector& varPosVec);
+
+  bool calcPosResidual(double& resNorm) const;
+  bool predictPos(double& startResNorm);
+  void updateSolverStats(int iter, bool predicted, double startResNorm,
+                         double prdResNorm, double endResNorm);
+
+  bool useSparse() const;
+
+  bool factorPosMatrix(double damping=0.0);
+  bool preparePosFactor();
+  void solvePosFactor(Ino::Vector& sol) const;
+
+  bool subtractLoopProjections(const std::vector<double>& diffLst,
+                               const std::vector<char>& okLst);
+
+  bool composeSpeedRhsRow(const GripList& grpLst, double *spDiff);
+  bool composeSpeedRhs();
+
+  bool composeAccelRhsRow(const GripList& grpLst, double *accDiff);
+  bool composeAccelRhs();
 
-  bool composeAccelMatrixRow(const GripList& grpLst);
-  bool composeAccelEq();
+  bool composeJerkRhsRow(const GripList& grpLst, double *jerkDiff);
+  bool composeJerkRhs();
 
-  bool composeJerkMatrixRow(const GripList& grpLst);
-  bool composeJerkEq();
+  void setSweepDerivatives(AbstractJoint& driveJnt, int locIdx,
+                           const SweepOptions& options);
 
   explicit Topology(Model& mdl, const Topology& cp, bool withSequences=false);
 
@@ -95,10 +406,12 @@ public:
   void clear();
   bool isEmpty() const { return size() < 1; }
 
-  int getVarSz() const   { return varSz; }
-  int getFixedSz() const { return fixedSz; }
-  int getRowSz() const   { return rowSz; }
-  int getColSz() const   { return colSz; }
+  int getVarSz() const   { return structure->varSz; }
+  int getFixedSz() const { return structure->fixedSz; }
+  int getRowSz() const   { return structure->rowSz; }
+  int getColSz() const   { return structure->colSz; }
+
+  const TopologyStructure& getStructure() const { return *structure; }
 
   Model *getModel() const { return model; }
   const BodyList& getBodyList() const { return topoBodyLst; }
@@ -109,13 +422,24 @@ public:
   const SequenceList& getSeqLst() const { return seqLst; }
   Sequence& newSequence(const wchar_t *name);
 
+  const SolverOptions& getSolverOptions() const { return solverOptions; }
+  void setSolverOptions(const SolverOptions& options);
+
+  const SolverStats& getSolverStats() const { return solverStats; }
+  void clearSolverStats() { solverStats = SolverStats(); }
+
   bool solvePos(int maxIter, double rotTol, double posTol,
                                             Ino::Vector& varPosVec, int& iter);
 
-  const Ino::Matrix& getPosMat() const { return solMat2; }
-  const Ino::Matrix& getSpeedMat() const { return speedMat2; }
-  const Ino::Vector& getSolRhs() const { return solRhs2; }
-  const Ino::Vector& getSpeedRhs() const { return speedRhs2; }
+  bool isSparse() const { return useSparse(); }
+  MatrixStats getMatrixStats() const;
+
+  // Band matrix only, empty if sparse. Also empty after a chord solvePos()
+  // that converged without composing, until the next solveSpeed() etc.:
+  const Ino::Matrix& getPosMat() const { return ctx.solMat2; }
+  const Ino::Matrix& getSpeedMat() const { return ctx.solMat2; } // Same matrix
+  const Ino::Vector& getSolRhs() const { return ctx.solRhs2; }
+  const Ino::Vector& getSpeedRhs() const { return ctx.speedRhs2; }
 
   bool getPosValid() const { return posValid; }
   bool getSpeedValid() const { return speedValid; }
@@ -161,6 +485,26 @@ public:
   // Must have called updatePositions,updateSpeeds and updateAccels first!
   bool updateJerks();
 
+  // Solves positions and, up to derivOrder, speeds, accels and jerks
+  // and writes the solution to the joints:
+  bool solve(int maxIter, double rotTol, double posTol, int derivOrder,
+                                                               int& iter);
+
+  // Drives fixed var locIdx of driveJnt from "from" to "to" and
+  // adds a State to seq at each step:
+  bool sweep(AbstractJoint& driveJnt, int locIdx,
+             double from, double to, double step,
+             const SweepOptions& options, Sequence& seq, int& stepCnt);
+
+  // As sweep, split in segCnt segments that are swept in parallel on
+  // threadCnt threads (0: All cores, 1: Serial). parSegCnt: the nr of
+  // segments actually used, 1 if it fell back to sweep(), as it does
+  // for a model with functions (these can not be cloned yet):
+  bool sweepParallel(AbstractJoint& driveJnt, int locIdx,
+                     double from, double to, double step,
+                     const SweepOptions& options, int segCnt, int threadCnt,
+                     Sequence& seq, int& stepCnt, int& parSegCnt);
+
   void transform(const Ino::Trf3& trf) const;
 
   friend class Model;
@@ -172,11 +516,14 @@ class TopologyList : public Ino::Array<Topology *>
 {
   Model *model;
 
+  mutable WorkerPool *workerPool; // Of solveAll(), kept between calls
+
   TopologyList(const TopologyList& cp);             // No copying
   TopologyList& operator=(const TopologyList& src); // No assignment
 
 public:
-  TopologyList() : Ino::Array<Topology *>(true), model(NULL) {}
+  TopologyList() : Ino::Array<Topology *>(true), model(NULL), workerPool(NULL) {}
+  ~TopologyList();
 
   Model *getModel() const { return model; }
   void setModel(Model& mdl) { model = &mdl; }
@@ -185,6 +532,12 @@ public:
 
   bool prepareAll();
 
+  // Solves all topologies on threadCnt threads (0: one per core),
+  // the result does not depend on the nr of threads.
+  // Rethrows the first exception thrown by a topology:
+  bool solveAll(int maxIter, double rotTol, double posTol,
+                int derivOrder, int threadCnt=0) const;
+
   void transform(const Ino::Trf3& trf) const;
 };
 
@@ -195,6 +548,36 @@ public:
 extern "C" __declspec(dllexport) int GetVarSzTopo(void* cppTopology);
 extern "C" __declspec(dllexport) bool SolvePosTopology(void *cppTopology, int maxIter, double rotTol, double posTol,
                                  double* varPosVec, int& iter);
+extern "C" __declspec(dllexport) bool SolveSpeedTopology(void *cppTopology, double* varSpeedVec);
+extern "C" __declspec(dllexport) bool SolveAccelTopology(void *cppTopology, double* varAccelVec);
+extern "C" __declspec(dllexport) void SetNewtonModeTopology(void *cppTopology, int mode, double maxContraction);
+extern "C" __declspec(dllexport) void SetPredictorOrderTopology(void *cppTopology, int order);
+extern "C" __declspec(dllexport) void SetStepControlTopology(void *cppTopology, int control, double initDamping);
+extern "C" __declspec(dllexport) void SetMatrixModeTopology(void *cppTopology, int mode);
+extern "C" __declspec(dllexport) bool IsSparseTopology(void *cppTopology);
+extern "C" __declspec(dllexport) void SetThreadCntTopology(void *cppTopology, int threadCnt);
+extern "C" __declspec(dllexport) void GetSolverStatsTopology(void *cppTopology, int& solveCnt, int& iterCnt,
+                                 int& predictCnt, double& itersSaved);
+extern "C" __declspec(dllexport) void GetMatrixStatsTopology(void *cppTopology, int& rowSz, int& colSz,
+                                 int& varSz, int& ordering,
+                                 double& nonZeros, double& fill, double& flops);
+extern "C" __declspec(dllexport) bool SweepTopology(void *cppTopology, void *cppDriveJoint, int locIdx,
+                                 double from, double to, double step,
+                                 int maxIter, double rotTol, double posTol,
+                                 int derivOrder, double driveSpeed,
+                                 bool adaptive, double maxStepFactor, int targetIter,
+                                 double maxDeviation, int maxHalvings,
+                                 int couplingCnt, void **cppCplJoints, int *cplLocIdx, double *cplRatio,
+                                 void *cppSequence, int& stepCnt);
+extern "C" __declspec(dllexport) bool SweepParallelTopology(void *cppTopology, void *cppDriveJoint, int locIdx,
+                                 double from, double to, double step,
+                                 int maxIter, double rotTol, double posTol,
+                                 int derivOrder, double driveSpeed,
+                                 bool adaptive, double maxStepFactor, int targetIter,
+                                 double maxDeviation, int maxHalvings,
+                                 int couplingCnt, void **cppCplJoints, int *cplLocIdx, double *cplRatio,
+                                 int segCnt, int threadCnt, void *cppSequence,
+                                 int& stepCnt, int& parSegCnt);
 
 //---------------------------------------------------------------------------
 #endif
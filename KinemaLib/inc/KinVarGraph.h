@@ -0,0 +1,53 @@
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Kinema: Kinematic Simulation Program ---------------------------
+//---------------------------------------------------------------------------
+//-------------------- Copyright Inofor Hoek Aut BV Dec 1999-2013 -----------
+//-------------------------------------------------- C.Wolters --------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Variable graph and fill reducing orderings ---------------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#ifndef INOKIN_VARGRAPH_INC
+#define INOKIN_VARGRAPH_INC
+
+#include <vector>
+
+namespace InoKin {
+
+//---------------------------------------------------------------------------
+// Two free vars are adjacent if they are in the same loop (clique),
+// i.e. if the element of AT-A they share is nonzero.
+// A permutation lists the old var index of each new index.
+
+class VarGraph
+{
+  std::vector<std::vector<int> > adjLst; // Sorted, without self
+
+  int minDegreeNode(const std::vector<char>& seen) const;
+  int lastLevelNode(int root, const std::vector<char>& seen,
+                                             int& levelCnt) const;
+
+public:
+  explicit VarGraph(int sz, const std::vector<std::vector<int> >& cliqueLst);
+
+  int size() const { return (int)adjLst.size(); }
+  int degree(int idx) const { return (int)adjLst[idx].size(); }
+
+  double getNonZeros() const; // Lower half of AT-A, diagonal included
+
+  // As Topology::colSz (0 if no two vars are adjacent):
+  int bandWidth(const std::vector<int>& perm) const;
+
+  void orderRCM(std::vector<int>& perm) const;       // Reverse Cuthill-McKee
+  void orderMinDegree(std::vector<int>& perm) const; // Minimum degree
+
+  static void invert(const std::vector<int>& perm, std::vector<int>& inv);
+};
+
+} // namespace
+
+//---------------------------------------------------------------------------
+#endif
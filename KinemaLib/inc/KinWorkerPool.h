@@ -0,0 +1,67 @@
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Kinema: Kinematic Simulation Program ---------------------------
+//---------------------------------------------------------------------------
+//-------------------- Copyright Inofor Hoek Aut BV Dec 1999-2013 -----------
+//-------------------------------------------------- C.Wolters --------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Persistent worker threads for short parallel loops -------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#ifndef INOKIN_WORKERPOOL_INC
+#define INOKIN_WORKERPOOL_INC
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+namespace InoKin {
+
+//---------------------------------------------------------------------------
+// The threads wait between runs, so a run costs a wakeup rather than
+// a thread start. Not reentrant: one run at a time.
+
+class WorkerPool
+{
+  std::vector<std::thread> threadLst;
+
+  std::mutex mutex;
+  std::condition_variable startCond, doneCond;
+
+  const std::function<void(int)> *task;
+  int taskCnt;
+  std::atomic<int> nextTask;
+
+  int busyCnt;
+  unsigned runNr;
+  bool stopping;
+
+  std::exception_ptr error;
+
+  void workerLoop();
+  void runTasks();
+
+  WorkerPool(const WorkerPool& cp) = delete;            // No copying
+  WorkerPool& operator=(const WorkerPool& src) = delete; // No assignment
+
+public:
+  explicit WorkerPool(int threadCnt); // Including the calling thread
+  ~WorkerPool();
+
+  int getThreadCnt() const { return (int)threadLst.size() + 1; }
+
+  // Calls func(0) .. func(cnt-1), the calling thread takes part.
+  // Rethrows the first exception thrown by func:
+  void run(int cnt, const std::function<void(int)>& func);
+};
+
+} // namespace
+
+//---------------------------------------------------------------------------
+#endif
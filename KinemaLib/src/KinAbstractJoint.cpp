@@ -17,6 +17,9 @@
 #include "KinModel.h"
 
 #include "Matrix.h"
+#include "Exceptions.h"
+
+#include <limits>
 
 //#include "stdio.h"
 
@@ -28,7 +31,7 @@ namespace InoKin {
 
 void AbstractJoint::getSpeedTrf(int idx, Trf3& spTrf) const
 {
-  getVarDerTrf(idx,spTrf);
+  spTrf = varTrf(idx,DerTrf);
   spTrf *= varSpeed[idx];
 }
 
@@ -36,11 +39,11 @@ void AbstractJoint::getSpeedTrf(int idx, Trf3& spTrf) const
 
 void AbstractJoint::getAccelTrf(int idx, Trf3& accTrf) const
 {
-  getVarDer2Trf(idx,accTrf);
+  accTrf = varTrf(idx,Der2Trf);
   accTrf *= sqr(varSpeed[idx]);
 
   Trf3 derTrf;
-  getVarDerTrf(idx,derTrf);
+  derTrf = varTrf(idx,DerTrf);
   derTrf *= varAccel[idx];
 
   accTrf += derTrf;
@@ -51,14 +54,14 @@ void AbstractJoint::getAccelTrf(int idx, Trf3& accTrf) const
 void AbstractJoint::getJerkTrf(int idx, Trf3& jerkTrf) const
 {
   Trf3 derTrf;
-  getVarDerTrf(idx,derTrf);
+  derTrf = varTrf(idx,DerTrf);
   derTrf *= varJerk[idx];
 
   Trf3 accTrf;
-  getVarDer2Trf(idx,accTrf);
+  accTrf = varTrf(idx,Der2Trf);
   accTrf *= varSpeed[idx] * varAccel[idx];
 
-  getVarDer3Trf(idx,jerkTrf);
+  jerkTrf = varTrf(idx,Der3Trf);
   jerkTrf *= sqr(varSpeed[idx]) * varSpeed[idx];
 
   jerkTrf += derTrf;
@@ -71,12 +74,7 @@ void AbstractJoint::setPos()
 {
   pos.init();
 
-  Trf3 trf;
-
-  for (int i=0; i<varCnt; i++) {
-    getVarTrf(i,trf);
-    pos.preMultWith(trf);
-  }
+  for (int i=0; i<varCnt; i++) pos.preMultWith(varTrf(i,PosTrf));
 
   pos.invertInto(invPos);
 }
@@ -91,7 +89,7 @@ void AbstractJoint::setSpeed()
   Trf3 derTrf,trf,curTrf;
 
   for (int i=0; i<varCnt; i++) {
-    getVarTrf(i,trf);
+    trf = varTrf(i,PosTrf);
     der1.preMultWith(trf);
 
     getSpeedTrf(i,derTrf);
@@ -118,7 +116,7 @@ void AbstractJoint::setAccel()
   Trf3 accTrf,trf,curTrf;
 
   for (int i=0; i<varCnt; i++) {
-    getVarTrf(i,trf);
+    trf = varTrf(i,PosTrf);
     der2.preMultWith(trf);
 
     getAccelTrf(i,accTrf);
@@ -153,7 +151,7 @@ void AbstractJoint::setJerk()
   Trf3 jerkTrf,trf,curTrf;
 
   for (int i=0; i<varCnt; i++) {
-    getVarTrf(i,trf);
+    trf = varTrf(i,PosTrf);
     der3.preMultWith(trf);
 
     getJerkTrf(i,jerkTrf);
@@ -187,14 +185,20 @@ void AbstractJoint::setJerk()
 
 AbstractJoint::AbstractJoint(Grip& grp, const wchar_t *name, int nrVars)
 : Object(grp.model,name),
+  trfStore(new Trf3[nrVars*(2+VarTrfKinds)]),
+  dblStore(new double[nrVars*(4+VarTrfKinds)]),
+  boolStore(new bool[nrVars*3]),
   pos(), invPos(), der1(), invDer1(),
   der2(), invDer2(), der3(), invDer3(),
-  fixedPos(new bool[nrVars]), varIdx(new int[nrVars]),
-  derLst(new Trf3[nrVars]), derLstValid(false),
-  invDerLst(new Trf3[nrVars]), invDerLstValid(new bool[nrVars]),
-  varPos(new double[nrVars]), varSpeed(new double[nrVars]),
-  varAccel(new double[nrVars]), varJerk(new double[nrVars]),
-  isAngular(new bool[nrVars]), varCnt(nrVars), grip(grp)
+  fixedPos(boolStore), varIdx(new int[nrVars]),
+  derLst(trfStore), derLstValid(false),
+  invDerLst(trfStore+nrVars), invDerLstValid(boolStore+nrVars),
+  varTrfCache(trfStore+2*nrVars),
+  varTrfKey(dblStore),
+  depModCnt(NULL), depKey(0),
+  varPos(dblStore+nrVars*VarTrfKinds), varSpeed(varPos+nrVars),
+  varAccel(varSpeed+nrVars), varJerk(varAccel+nrVars),
+  isAngular(boolStore+2*nrVars), varCnt(nrVars), grip(grp)
 {
 //  delete grip.joint;
   grip.joint = this;
@@ -204,11 +208,14 @@ AbstractJoint::AbstractJoint(Grip& grp, const wchar_t *name, int nrVars)
     varPos[i]         = 0.0;
     varSpeed[i]       = 0.0;
     varAccel[i]       = 0.0;
+    varJerk[i]        = 0.0;
     fixedPos[i]       = false;
     varIdx[i]         = -1;
     isAngular[i]      = false;
   }
 
+  clearVarTrfCache();
+
   der1.zero();    der1.isDerivative    = true;
   invDer1.zero(); invDer1.isDerivative = true;
   der2.zero();    der2.isDerivative    = true;
@@ -223,22 +230,28 @@ AbstractJoint::AbstractJoint(Grip& grp, const wchar_t *name, int nrVars)
 
 AbstractJoint::AbstractJoint(Grip& newGrp, const AbstractJoint& cp)
 : Object(newGrp.model,cp),
+  trfStore(new Trf3[cp.varCnt*(2+VarTrfKinds)]),
+  dblStore(new double[cp.varCnt*(4+VarTrfKinds)]),
+  boolStore(new bool[cp.varCnt*3]),
+  pos(cp.pos), invPos(cp.invPos),
   der1(cp.der1), invDer1(cp.invDer1),
   der2(cp.der2), invDer2(cp.invDer2),
   der3(cp.der3), invDer3(cp.invDer3),
-  fixedPos(new bool[cp.varCnt]),
-  varIdx(new int[cp.varCnt]), pos(cp.pos), invPos(cp.invPos),
-  derLst(new Trf3[cp.varCnt]), derLstValid(false),
-  invDerLst(new Trf3[cp.varCnt]), invDerLstValid(new bool[cp.varCnt]),
-  varPos(new double[cp.varCnt]), varSpeed(new double[cp.varCnt]),
-  varAccel(new double[cp.varCnt]), varJerk(new double[cp.varCnt]),
-  isAngular(new bool[cp.varCnt]), varCnt(cp.varCnt), grip(newGrp)
+  fixedPos(boolStore), varIdx(new int[cp.varCnt]),
+  derLst(trfStore), derLstValid(false),
+  invDerLst(trfStore+cp.varCnt), invDerLstValid(boolStore+cp.varCnt),
+  varTrfCache(trfStore+2*cp.varCnt),
+  varTrfKey(dblStore),
+  depModCnt(cp.depModCnt), depKey(cp.depKey),
+  varPos(dblStore+cp.varCnt*VarTrfKinds), varSpeed(varPos+cp.varCnt),
+  varAccel(varSpeed+cp.varCnt), varJerk(varAccel+cp.varCnt),
+  isAngular(boolStore+2*cp.varCnt), varCnt(cp.varCnt), grip(newGrp)
 {
   delete grip.joint;
   grip.joint = this;
 
   for (int i=0; i<varCnt; i++) {
-    invDerLstValid[i] = cp.invDerLstValid[i];
+    invDerLstValid[i] = false; // invDerLst is not copied
     varPos[i]         = cp.varPos[i];
     varSpeed[i]       = cp.varSpeed[i];
     varAccel[i]       = cp.varAccel[i];
@@ -248,30 +261,55 @@ AbstractJoint::AbstractJoint(Grip& newGrp, const AbstractJoint& cp)
     isAngular[i]      = cp.isAngular[i];
   }
 
-  if (&newGrp.model != &cp.model) setModelTopoModified();
+  clearVarTrfCache();
+
+  // Only through Model::cloneFrom, that builds the topologies itself
 }
 
 //-------------------------------------------------------------------------------
 
 AbstractJoint::~AbstractJoint()
 {
-  delete[] fixedPos;
+  setModelTopoModified(); // First, the topologies detach from this joint
+
+  delete[] trfStore;
+  delete[] dblStore;
+  delete[] boolStore;
   delete[] varIdx;
-  delete[] derLst;
-  delete[] invDerLst;
-  delete[] invDerLstValid;
-  delete[] varPos;
-  delete[] varSpeed;
-  delete[] varAccel;
-  delete[] varJerk;
-  delete[] isAngular;
 
   Function *func = model.getFunctionList().findByConnection(*this);
   delete func;
 
   if (grip.joint == this) grip.joint = NULL;
+}
 
-  setModelTopoModified();
+//-------------------------------------------------------------------------------
+// The values move along
+
+void AbstractJoint::attachVars(double *posLst, double *speedLst,
+                               double *accelLst, double *jerkLst)
+{
+  for (int i=0; i<varCnt; ++i) {
+    posLst[i]   = varPos[i];
+    speedLst[i] = varSpeed[i];
+    accelLst[i] = varAccel[i];
+    jerkLst[i]  = varJerk[i];
+  }
+
+  varPos   = posLst;
+  varSpeed = speedLst;
+  varAccel = accelLst;
+  varJerk  = jerkLst;
+}
+
+//-------------------------------------------------------------------------------
+
+void AbstractJoint::detachVars()
+{
+  double *own = ownVars();
+  if (varPos == own) return;
+
+  attachVars(own,own+varCnt,own+2*varCnt,own+3*varCnt);
 }
 
 //-------------------------------------------------------------------------------
@@ -291,7 +329,7 @@ int AbstractJoint::getVarCnt(bool fixd) const
 
 bool AbstractJoint::getFixed(int locIdx) const
 {
-  if (locIdx < 0 || locIdx > varCnt) return false;
+  if (locIdx < 0 || locIdx >= varCnt) return false;
 
   return fixedPos[locIdx];
 }
@@ -300,7 +338,7 @@ bool AbstractJoint::getFixed(int locIdx) const
 
 void AbstractJoint::setFixed(int locIdx, bool isFixed)
 {
-  if (locIdx < 0 || locIdx > varCnt) return;
+  if (locIdx < 0 || locIdx >= varCnt) return;
 
   fixedPos[locIdx] = isFixed;
 
@@ -382,9 +420,10 @@ void AbstractJoint::setVal(int locIdx, double newVal)
   if (locIdx < 0 || locIdx >= varCnt) return;
 
   varPos[locIdx] = newVal;
+  clearTrfCaches();
   setPos();
 
-  setModelModified();
+  setModelPosModified(); // The topologies refactor
 }
 
 //-------------------------------------------------------------------------------
@@ -510,8 +549,115 @@ void AbstractJoint::clearTrfCaches()
 
 //-------------------------------------------------------------------------------
 
+void AbstractJoint::clearVarTrfCache()
+{
+  int sz = varCnt * VarTrfKinds;
+
+  for (int i=0; i<sz; ++i) varTrfKey[i] = std::numeric_limits<double>::quiet_NaN();
+}
+
+//-------------------------------------------------------------------------------
+
+void AbstractJoint::setDependency(const unsigned *modCnt)
+{
+  depModCnt = modCnt;
+  if (depModCnt) depKey = *depModCnt;
+
+  clearVarTrfCache();
+  clearTrfCaches();
+}
+
+//-------------------------------------------------------------------------------
+// What the var trfs depend on changed, with the vars unchanged.
+// Single threaded, see updateTrfCaches()
+
+void AbstractJoint::dependencyChanged() const
+{
+  int sz = varCnt * VarTrfKinds;
+
+  for (int i=0; i<sz; ++i) varTrfKey[i] = std::numeric_limits<double>::quiet_NaN();
+
+  derLstValid = false;
+  for (int i=0; i<varCnt; ++i) invDerLstValid[i] = false;
+
+  depKey = *depModCnt;
+}
+
+//-------------------------------------------------------------------------------
+// Most joints are evaluated several times per var position (pos, speed,
+// accel, jerk and the derivatives of the equations): the trig of
+// getVarTrf() and its derivatives is done once per position.
+
+const Trf3& AbstractJoint::varTrf(int idx, int kind) const
+{
+  checkDependency();
+
+  int c = idx*VarTrfKinds + kind;
+
+  Trf3& trf = varTrfCache[c];
+  if (varTrfKey[c] == varPos[idx]) return trf;
+
+  switch (kind) {
+    case PosTrf:    getVarTrf(idx,trf); break;
+    case DerTrf:    getVarDerTrf(idx,trf); break;
+    case Der2Trf:   getVarDer2Trf(idx,trf); break;
+    case Der3Trf:   getVarDer3Trf(idx,trf); break;
+    case InvPosTrf: getVarInvTrf(idx,trf); break;
+    default: throw IndexOutOfBoundsException("AbstractJoint::varTrf");
+  }
+
+  varTrfKey[c] = varPos[idx];
+
+  return trf;
+}
+
+//-------------------------------------------------------------------------------
+
+void AbstractJoint::getVarInvTrf(int idx, Trf3& trf) const
+{
+  trf = varTrf(idx,PosTrf);
+  trf.invert();
+}
+
+//-------------------------------------------------------------------------------
+
+void AbstractJoint::updateTrfCaches(int derivOrder) const
+{
+  for (int i=0; i<varCnt; ++i) {
+    varTrf(i,PosTrf);
+    varTrf(i,InvPosTrf);
+    if (derivOrder < 1) continue; // Positions only
+
+    varTrf(i,DerTrf);
+    if (derivOrder > 1) varTrf(i,Der2Trf);
+    if (derivOrder > 2) varTrf(i,Der3Trf);
+
+    getInvDerivative(i);
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void AbstractJoint::updateTrfCachesAll(AbstractJoint *const *jntLst, int cnt,
+                                                             int derivOrder)
+{
+  for (int i=0; i<cnt; ++i) jntLst[i]->updateTrfCaches(derivOrder);
+}
+
+//-------------------------------------------------------------------------------
+// Joints of the same type return the same updater, see JntKernel
+
+AbstractJoint::VarTrfUpdater AbstractJoint::getVarTrfUpdater() const
+{
+  return &updateTrfCachesAll;
+}
+
+//-------------------------------------------------------------------------------
+
 const Trf3& AbstractJoint::getDerivative(int locIdx) const
 {
+  checkDependency();
+
   if (!derLstValid) getDerivativeAll();
 
   return derLst[locIdx];
@@ -521,6 +667,8 @@ const Trf3& AbstractJoint::getDerivative(int locIdx) const
 
 const Trf3& AbstractJoint::getInvDerivative(int locIdx) const
 {
+  checkDependency();
+
   if (!derLstValid) getDerivativeAll();
 
   if (!invDerLstValid[locIdx]) {
@@ -546,27 +694,21 @@ void AbstractJoint::getDerivativeAll() const
   derLst[0].init();
 
   for (int i=1; i<varCnt; i++) {
-    getVarTrf(i-1,derLst[i]);
+    derLst[i] = varTrf(i-1,PosTrf);
     if (i>1) derLst[i] *= derLst[i-1];
   }
 
-  Trf3 trf;
-
-  for (int i=0; i<varCnt; i++) {
-    getVarDerTrf(i,trf);
-    derLst[i].preMultWith(trf);
-  }
+  for (int i=0; i<varCnt; i++) derLst[i].preMultWith(varTrf(i,DerTrf));
 
   Trf3 eTrf;
 
   if (varCnt >= 2) {
-    getVarTrf(varCnt-1,eTrf);
+    eTrf = varTrf(varCnt-1,PosTrf);
     derLst[varCnt-2].preMultWith(eTrf);
   }
 
   for (int i=varCnt-3; i>=0; --i) {
-    getVarTrf(i+1,trf);
-    eTrf *= trf; 
+    eTrf *= varTrf(i+1,PosTrf);
 
     derLst[i].preMultWith(eTrf);
   }
@@ -578,94 +720,16 @@ void AbstractJoint::getDerivativeAll() const
 
 void AbstractJoint::getAccMixed(Trf3& mixTrf) const
 {
-  mixTrf.zero();
-  mixTrf.isDerivative = true;
-
-  Trf3 subTrf1,derTrf1,trf1,curTrf1;
-
-  subTrf1.zero();
-  subTrf1.isDerivative = true;
-
-  for (int i=0; i<varCnt-1; i++) {
-    getVarTrf(i,trf1);
-    subTrf1.preMultWith(trf1);
-
-    getSpeedTrf(i,derTrf1);
-    derTrf1 *= curTrf1;
-
-    subTrf1 += derTrf1;
-    curTrf1.preMultWith(trf1);
-
-    Trf3 subTrf2,derTrf2,trf2,curTrf2;
-
-    subTrf2.zero();
-    subTrf2.isDerivative = true;
-
-    for (int j=i+1; j<varCnt; ++j) {
-      getVarTrf(j,trf2);
-      subTrf2.preMultWith(trf2);
-
-      getSpeedTrf(i,derTrf2);
-      derTrf2 *= curTrf2;
-
-      subTrf2 += derTrf2;
-      curTrf2.preMultWith(trf2);
-    }
-
-    subTrf2 *= subTrf1;
-    mixTrf += subTrf2;
-  }
-
-  mixTrf *= 2.0;
+  Trf3 jerkTrf;
+  getMixed(false,false,mixTrf,jerkTrf);
 }
 
 //-------------------------------------------------------------------------------
 
 void AbstractJoint::getInvAccMixed(Trf3& invMixTrf) const
 {
-  invMixTrf.zero();
-  invMixTrf.isDerivative = true;
-
-  Trf3 subTrf1,derTrf1,trf1,curTrf1;
-
-  subTrf1.zero();
-  subTrf1.isDerivative = true;
-
-  for (int i=0; i<varCnt-1; i++) {
-    getVarTrf(i,trf1); trf1.invert();
-    subTrf1 *= trf1;
-
-    getSpeedTrf(i,derTrf1);
-    derTrf1 *= trf1; derTrf1.preMultWith(trf1); derTrf1 *= -1.0;
-
-    derTrf1.preMultWith(curTrf1);
-
-    subTrf1 += derTrf1;
-    curTrf1 *= trf1;
-
-    Trf3 subTrf2,derTrf2,trf2,curTrf2;
-
-    subTrf2.zero();
-    subTrf2.isDerivative = true;
-
-    for (int j=i+1; j<varCnt; ++j) {
-      getVarTrf(j,trf2); trf2.invert();
-      subTrf2 *= trf2;
-
-      getSpeedTrf(i,derTrf2);
-
-      derTrf2 *= trf2; derTrf2.preMultWith(trf2); derTrf2 *= -1.0;
-      derTrf2.preMultWith(curTrf2);
-
-      subTrf2 += derTrf2;
-      curTrf2 *= trf2;
-    }
-
-    subTrf2.preMultWith(subTrf1);
-    invMixTrf += subTrf2;
-  }
-
-  invMixTrf *= 2.0;
+  Trf3 jerkTrf;
+  getMixed(true,false,invMixTrf,jerkTrf);
 }
 
 //-------------------------------------------------------------------------------
@@ -742,15 +806,15 @@ void AbstractJoint::getSecDerivative(int locIdx, Trf3& accTrf) const
   accTrf.zero();
   accTrf.isDerivative = true;
 
-  if (locIdx < 0 || locIdx > varCnt) return;
+  if (locIdx < 0 || locIdx >= varCnt) return;
 
   accTrf.init();
 
   Trf3 trf;
 
   for (int i=0; i<varCnt; i++) {
-    if (i == locIdx) getVarDer2Trf(i,trf);
-    else getVarTrf(i,trf);
+    if (i == locIdx) trf = varTrf(i,Der2Trf);
+    else trf = varTrf(i,PosTrf);
 
     accTrf.preMultWith(trf);
   }
@@ -781,251 +845,141 @@ void AbstractJoint::getInvSecDerivative(int locIdx, Trf3& accTrf) const
 }
 
 //-------------------------------------------------------------------------------
+// sum += a * b
 
-void AbstractJoint::getPosRange(int lwbIdx, int upbIdx, Trf3& posTrf) const
-{
-  posTrf.init();
-
-  Trf3 trf;
-
-  for (int i=lwbIdx; i<upbIdx; ++i) {
-    getVarTrf(i,trf);
-    posTrf.preMultWith(trf);
-  }
-}
-
-//-------------------------------------------------------------------------------
-
-void AbstractJoint::getInvPosRange(int lwbIdx, int upbIdx, Trf3& posTrf) const
+static void addProduct(Trf3& sum, const Trf3& a, const Trf3& b)
 {
-  posTrf.init();
+  Trf3 trf(a);
+  trf *= b;
 
-  Trf3 trf;
-
-  for (int i=lwbIdx; i<upbIdx; ++i) {
-    getVarTrf(i,trf); trf.invert();
-    posTrf *= trf;
-  }
+  sum += trf;
 }
 
 //-------------------------------------------------------------------------------
+// The mixed terms of the time derivatives of pos (or invPos), in one sweep
+// over the vars. Multiplying in var i, with T, V and A its pos, speed and
+// accel trfs and the sums over the vars before i:
+//
+//   pos: P   = T P                        (the prefix product)
+//   V's: D   = T D   + V P                (one speed trf)
+//   A's: E   = T E   + A P                (one accel trf)
+//   VV:  DD  = T DD  + V D                (two speed trfs)
+//   AV:  DE  = T DE  + A D + V E          (an accel and a speed trf)
+//   VVV: DDD = T DDD + V DD               (three speed trfs)
+//
+// accMix = 2 DD, jerkMix = 3 DE + 6 DDD.
+// The inverse multiplies on the right with the inverse trfs.
 
-void AbstractJoint::getOneDerRange(int lwbIdx, int upbIdx, Trf3& derTrf) const
+void AbstractJoint::getMixed(bool inverse, bool jerk,
+                             Trf3& accMix, Trf3& jerkMix) const
 {
-  derTrf.init();
+  Trf3 posTrf, d, e, dd, de, ddd;
 
-  Trf3 trf,trf2;
+  posTrf.init();
+  d.zero();   d.isDerivative   = true;
+  e.zero();   e.isDerivative   = true;
+  dd.zero();  dd.isDerivative  = true;
+  de.zero();  de.isDerivative  = true;
+  ddd.zero(); ddd.isDerivative = true;
 
-  for (int i=lwbIdx; i<upbIdx; ++i) {
-    getPosRange(0,i,trf);
+  Trf3 spTrf, accTrf, trf;
 
-    getSpeedTrf(i,trf2);
-    trf.preMultWith(trf2);
+  for (int i=0; i<varCnt; i++) {
+    getSpeedTrf(i,spTrf);
+    if (jerk) getAccelTrf(i,accTrf);
 
-    getPosRange(i+1,upbIdx,trf2);
-    trf.preMultWith(trf2);
+    if (!inverse) {
+      const Trf3& posI = varTrf(i,PosTrf);
 
-    derTrf += trf;
-  }
-}
+      if (jerk) {
+        ddd.preMultWith(posI);
+        addProduct(ddd,spTrf,dd);
 
-//-------------------------------------------------------------------------------
+        de.preMultWith(posI);
+        addProduct(de,accTrf,d);
+        addProduct(de,spTrf,e);
 
-void AbstractJoint::getInvOneDerRange(int lwbIdx, int upbIdx, Trf3& derTrf) const
-{
-  derTrf.init();
+        e.preMultWith(posI);
+        addProduct(e,accTrf,posTrf);
+      }
 
-  Trf3 trf,trf1,trf2;
+      dd.preMultWith(posI);
+      addProduct(dd,spTrf,d);
 
-  for (int i=lwbIdx; i<upbIdx; ++i) {
-    getInvPosRange(0,i,trf);
+      d.preMultWith(posI);
+      addProduct(d,spTrf,posTrf);
 
-    getVarTrf(i,trf1); trf1.invert();
-
-    getSpeedTrf(i,trf2);
-    trf2 *= trf1; trf2.preMultWith(trf1); trf2 *= -1.0;
+      posTrf.preMultWith(posI);
+    }
+    else {
+      const Trf3& invPosI = varTrf(i,InvPosTrf);
 
-    trf *= trf2;
+      if (jerk) { // Inverse accel trf
+        trf = invPosI;
+        trf *= spTrf;
+        trf.preMultWith(spTrf);
+        trf *= 2.0;
 
-    getInvPosRange(i+1,upbIdx,trf2);
-    trf *= trf2;
+        trf -= accTrf;
+        trf *= invPosI;
+        trf.preMultWith(invPosI);
 
-    derTrf += trf;
-  }
-}
+        accTrf = trf;
+      }
 
-//-------------------------------------------------------------------------------
+      spTrf *= invPosI; spTrf.preMultWith(invPosI); spTrf *= -1.0;
 
-void AbstractJoint::getTwoDerRange(int lwbIdx, int upbIdx, Trf3& derTrf) const
-{
-  derTrf.init();
+      if (jerk) {
+        ddd *= invPosI;
+        addProduct(ddd,dd,spTrf);
 
-  Trf3 trf,trf2,spTrf;
+        de *= invPosI;
+        addProduct(de,d,accTrf);
+        addProduct(de,e,spTrf);
 
-  for (int i=lwbIdx; i<upbIdx-1; ++i) {
-    getPosRange(0,i,trf);
+        e *= invPosI;
+        addProduct(e,posTrf,accTrf);
+      }
 
-    getSpeedTrf(i,spTrf);
-    trf.preMultWith(spTrf);
+      dd *= invPosI;
+      addProduct(dd,d,spTrf);
 
-    getOneDerRange(i+1,upbIdx,trf2);
-    trf.preMultWith(trf2);
+      d *= invPosI;
+      addProduct(d,posTrf,spTrf);
 
-    derTrf += trf;
+      posTrf *= invPosI;
+    }
   }
-}
-
-//-------------------------------------------------------------------------------
-
-void AbstractJoint::getInvTwoDerRange(int lwbIdx, int upbIdx, Trf3& derTrf) const
-{
-  derTrf.init();
-
-  Trf3 trf,trf2,spTrf;
 
-  for (int i=lwbIdx; i<upbIdx-1; ++i) {
-    getInvPosRange(0,i,trf);
+  accMix = dd;
+  accMix *= 2.0;
 
-    getVarTrf(i,trf2); trf2.invert();
-
-    getSpeedTrf(i,spTrf);
-    spTrf *= trf2; spTrf.preMultWith(trf2); spTrf *= -1.0;
-    trf *= spTrf;
+  jerkMix.zero();
+  jerkMix.isDerivative = true;
 
-    getInvOneDerRange(i+1,upbIdx,trf2);
-    trf *= trf2;
+  if (jerk) {
+    de  *= 3.0;
+    ddd *= 6.0;
 
-    derTrf += trf;
+    jerkMix += de;
+    jerkMix += ddd;
   }
 }
 
 //-------------------------------------------------------------------------------
 
-void AbstractJoint::getJerkMixed(Trf3& mixTrf)
+void AbstractJoint::getJerkMixed(Trf3& mixTrf) const
 {
-  mixTrf.zero();
-  mixTrf.isDerivative = true;
-
-  Trf3 trf, trf2;
-
-  for (int i=1; i<varCnt; i++) {
-    getOneDerRange(0,i,trf);
-
-    getAccelTrf(i,trf2);
-    trf.preMultWith(trf2);
-
-    getPosRange(i+1,varCnt,trf2);
-    trf.preMultWith(trf2);
-    trf *= 3.0;
-
-    mixTrf += trf;
-  }
-
-  for (int i=0; i<varCnt-1; i++) {
-    getPosRange(0,i,trf);
-
-    getAccelTrf(i,trf2);
-    trf.preMultWith(trf2);
-
-    getOneDerRange(i+1,varCnt,trf2);
-    trf.preMultWith(trf2);
-    trf *= 3.0;
-
-    mixTrf += trf;
-  }
-
-  for (int i=0; i<varCnt-2; i++) {
-    getPosRange(0,i,trf);
-
-    getSpeedTrf(i,trf2);
-    trf.preMultWith(trf2);
-
-    getTwoDerRange(i+1,varCnt,trf2);
-    trf.preMultWith(trf2);
-    trf *= 6.0;
-
-    mixTrf += trf;
-  }
+  Trf3 accTrf;
+  getMixed(false,true,accTrf,mixTrf);
 }
 
 //-------------------------------------------------------------------------------
 
-void AbstractJoint::getInvJerkMixed(Trf3& invMixTrf)
+void AbstractJoint::getInvJerkMixed(Trf3& invMixTrf) const
 {
-  invMixTrf.zero();
-  invMixTrf.isDerivative = true;
-
-  Trf3 trf, trf1, trf2, invPosTrf, spTrf;
-
-  for (int i=1; i<varCnt; i++) {
-    getInvOneDerRange(0,i,trf);
-
-    getVarTrf(i,invPosTrf); invPosTrf.invert();
-    getSpeedTrf(i,trf1);
-
-    trf2 = invPosTrf;
-    trf2 *= trf1;
-    trf2.preMultWith(trf1);
-    trf2 *= 2.0;
-
-    getAccelTrf(i,trf1);
-    trf2 -= trf1;
-
-    trf2 *= invPosTrf;
-    trf2.preMultWith(invPosTrf); // Now inverse accel trf
-
-    trf *= trf2;
-
-    getInvPosRange(i+1,varCnt,trf2);
-    trf *= trf2;
-    trf *= 3.0;
-
-    invMixTrf += trf;
-  }
-
-  for (int i=0; i<varCnt-1; i++) {
-    getInvPosRange(0,i,trf);
-
-    getVarTrf(i,invPosTrf); invPosTrf.invert();
-    getSpeedTrf(i,trf1);
-
-    trf2 = invPosTrf;
-    trf2 *= trf1;
-    trf2.preMultWith(trf1);
-    trf2 *= 2.0;
-
-    getAccelTrf(i,trf1);
-    trf2 -= trf1;
-
-    trf2 *= invPosTrf;
-    trf2.preMultWith(invPosTrf); // Now inverse accel trf
-
-    trf *= trf2;
-
-    getInvOneDerRange(i+1,varCnt,trf2);
-    trf *= trf2;
-    trf *= 3.0;
-
-    invMixTrf += trf;
-  }
-
-  for (int i=0; i<varCnt-2; i++) {
-    getInvPosRange(0,i,trf);
-
-    getVarTrf(i,invPosTrf); invPosTrf.invert();
-    getSpeedTrf(i,trf2);
-    trf2 *= invPosTrf;
-    trf2.preMultWith(invPosTrf);
-    trf2 *= -1.0; // Now invspeed
-
-    trf *= trf2;
-
-    getInvTwoDerRange(i+1,varCnt,trf2);
-    trf *= trf2;
-    trf *= 6.0;
-
-    invMixTrf += trf;
-  }
+  Trf3 accTrf;
+  getMixed(true,true,accTrf,invMixTrf);
 }
 
 //-------------------------------------------------------------------------------
@@ -1101,15 +1055,15 @@ void AbstractJoint::getThirdDerivative(int locIdx, Trf3& jerkTrf) const
   jerkTrf.zero();
   jerkTrf.isDerivative = true;
 
-  if (locIdx < 0 || locIdx > varCnt) return;
+  if (locIdx < 0 || locIdx >= varCnt) return;
 
   jerkTrf.init();
 
   Trf3 trf;
 
   for (int i=0; i<varCnt; i++) {
-    if (i == locIdx) getVarDer3Trf(i,trf);
-    else getVarTrf(i,trf);
+    if (i == locIdx) trf = varTrf(i,Der3Trf);
+    else trf = varTrf(i,PosTrf);
 
     jerkTrf.preMultWith(trf);
   }
@@ -19,6 +19,7 @@ namespace InoKin {
 //---------------------------------------------------------------------------
 
 AbstractTrack::AbstractTrack()
+: modCnt(0)
 {
 
 }
@@ -26,9 +27,26 @@ AbstractTrack::AbstractTrack()
 //---------------------------------------------------------------------------
 
 AbstractTrack::AbstractTrack(const AbstractTrack& cp)
+: modCnt(0)
 {
 }
 
+//---------------------------------------------------------------------------
+
+void AbstractTrack::evaluate(double at_s, int maxOrder, TrackSample& smp,
+                                                         int& cursor) const
+{
+  smp.s = at_s;
+  smp.order = maxOrder > 2 ? 3 : 2;
+
+  getPointAndDir(at_s,smp.pnt,smp.dir,cursor);
+  getAcc(at_s,smp.acc,cursor);
+
+  if (maxOrder > 2) getJerk(at_s,smp.jerk,cursor);
+
+  getXDir(at_s,smp.xDir,smp.xDer,cursor);
+}
+
 } // namespace
 
 //---------------------------------------------------------------------------
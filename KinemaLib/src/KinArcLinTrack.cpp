@@ -12,8 +12,11 @@
 
 #include "KinArcLinTrack.h"
 
+#include "KinWorkerPool.h"
+
 #include "Exceptions.h"
 
+#include <algorithm>
 // #include <cmath>
 
 using namespace Ino;
@@ -267,7 +270,7 @@ void ArcLinTrackPt::getJerk(double atRel, Vec3& j) const
 
 ArcLinTrack::ArcLinTrack(bool trkClosed, double trackPipeDiameter)
 : AbstractTrack(), trk(true), closed(trkClosed),
-  trackPipeRadius(trackPipeDiameter/2.0), length(0.0)
+  trackPipeRadius(trackPipeDiameter/2.0), length(0.0), boxLst()
 {
 }
 
@@ -275,7 +278,7 @@ ArcLinTrack::ArcLinTrack(bool trkClosed, double trackPipeDiameter)
 
 ArcLinTrack::ArcLinTrack(const ArcLinTrack& cp)
 : AbstractTrack(cp), trk(cp.trk.isObjectOwner()), closed(cp.closed),
-  trackPipeRadius(cp.trackPipeRadius), length(cp.length)
+  trackPipeRadius(cp.trackPipeRadius), length(cp.length), boxLst()
 {
   int sz = cp.trk.size();
 
@@ -299,7 +302,10 @@ ArcLinTrack::~ArcLinTrack()
 void ArcLinTrack::clear()
 {
   trk.clear();
+  boxLst.clear();
   closed = false;
+
+  setModified();
 }
 
 //---------------------------------------------------------------------------
@@ -314,6 +320,8 @@ const Vec3& ArcLinTrack::getPoint(int idx) const
 
 int ArcLinTrack::addPoint(const Vec3& pt)
 {
+  setModified();
+
   return trk.add(new ArcLinTrackPt(pt));
 }
 
@@ -447,6 +455,10 @@ void ArcLinTrack::validate()
   
   if (closed) length += (fabs(trk[sz-1]->maxS +
                                                fabs(trk[0]->minS))/2.0);
+
+  buildBoxTree();
+
+  setModified();
 }
 
 //---------------------------------------------------------------------------
@@ -467,15 +479,37 @@ int ArcLinTrack::findUpper(double at_s) const
 
 //---------------------------------------------------------------------------
 
-void ArcLinTrack::findPointPair(double at_s, int& lowidx,
-                                int& hghidx, double& relParm) const
+// cursor: segment of the previous call (< 0: none), marches to the new one.
+// Falls back to the binary search for far jumps.
+
+void ArcLinTrack::findPointPair(double at_s, int& lowidx, int& hghidx,
+                                double& relParm, int& cursor) const
 {
+  const int MaxMarch = 8;
+
   int sz = trk.size();
 
-  at_s = fmod(at_s,length);
-  if (at_s < 0.0) at_s += length;
+  if (at_s < 0.0 || at_s >= length) {
+    at_s = fmod(at_s,length);
+    if (at_s < 0.0) at_s += length;
+  }
+
+  if (cursor < 0 || cursor >= sz) hghidx = findUpper(at_s);
+  else {
+    int steps = 0;
+    hghidx = cursor + 1;
+
+    while (hghidx > 0 && trk[hghidx-1]->s > at_s && steps++ < MaxMarch)
+      hghidx--;
+
+    while (hghidx < sz && trk[hghidx]->s <= at_s && steps++ < MaxMarch)
+      hghidx++;
+
+    if (steps >= MaxMarch) hghidx = findUpper(at_s);
+  }
+
+  cursor = hghidx-1;
 
-  hghidx = findUpper(at_s);
   lowidx = hghidx-1; if (lowidx < 0) lowidx = sz-1;
   if (hghidx >= sz) hghidx = 0;
 
@@ -489,17 +523,19 @@ void ArcLinTrack::findPointPair(double at_s, int& lowidx,
 }
 
 /* ---------------------------------------------------------------------- */
+// Points fst .. fst+cnt-1, lastS: co track position before point fst.
+// Marches a segment cursor along the co track: each search starts at
+// the segment of the previous result, so it hardly descends the box tree.
 
-void ArcLinTrack::setCoTrack(const ArcLinTrack& coTrk,
-                                      bool reverseDir,double maxSDiff)
+void ArcLinTrack::setCoTrackRange(const ArcLinTrack& coTrk, bool reverseDir,
+                                  double maxSDiff, int fst, int cnt,
+                                  double lastS)
 {
   maxSDiff /= 2.0;
 
-  double lastS = 0;
+  int seg = -1;
 
-  int sz = trk.size();
-
-  for (int i=0; i<sz; i++) {
+  for (int i=fst; i<fst+cnt; i++) {
     if (lastS < 0) lastS += coTrk.length;
     else if (lastS > coTrk.length) lastS -= coTrk.length;
 
@@ -511,7 +547,7 @@ void ArcLinTrack::setCoTrack(const ArcLinTrack& coTrk,
     double maxS = lastS + maxSDiff;
     if (maxS > coTrk.length) maxS -= coTrk.length;
 
-    lastS = coTrk.findPoint(*trk[i],minS,maxS,trk[i]->zDir);
+    lastS = coTrk.nearestPoint(*trk[i],true,minS,maxS,seg,trk[i]->zDir);
     
     trk[i]->zDir -= *trk[i]; trk[i]->zDir.unitLen3();
 
@@ -519,6 +555,85 @@ void ArcLinTrack::setCoTrack(const ArcLinTrack& coTrk,
   }
 }
 
+/* ---------------------------------------------------------------------- */
+
+void ArcLinTrack::setCoTrack(const ArcLinTrack& coTrk,
+                                      bool reverseDir,double maxSDiff)
+{
+  setCoTrackRange(coTrk,reverseDir,maxSDiff,0,trk.size(),0.0);
+
+  setModified();
+}
+
+/* ---------------------------------------------------------------------- */
+// The points in chunks of CoTrackChunk points, so the result does not
+// depend on threadCnt. The start of each chunk is seeded, one after the
+// other, by a ranged search around the s expected from the seed of the
+// previous chunk, never by a search of the whole co track (which might
+// find another part of it running close by).
+
+void ArcLinTrack::setCoTrackParallel(const ArcLinTrack& coTrk,
+                        bool reverseDir, double maxSDiff, int threadCnt)
+{
+  if (threadCnt < 1) threadCnt = (int)std::thread::hardware_concurrency();
+
+  int sz = trk.size();
+  int chunkCnt = (sz + CoTrackChunk - 1)/CoTrackChunk;
+
+  if (chunkCnt < 2 || length <= 0.0) {
+    setCoTrack(coTrk,reverseDir,maxSDiff);
+    return;
+  }
+
+  std::vector<double> seedLst(chunkCnt,0.0);
+
+  double sRatio = coTrk.length/length;
+  int seg = -1;
+  Vec3 trkPt;
+
+  for (int k=1; k<chunkCnt; ++k) {
+    int fst = k*CoTrackChunk, prvFst = fst - CoTrackChunk;
+
+    double ds = (trk[fst]->s - trk[prvFst]->s) * sRatio;
+    double expS = seedLst[k-1] + ds;
+    double halfWidth = (fabs(ds) + maxSDiff)/2.0;
+
+    if (2.0*halfWidth >= coTrk.length) {
+      seedLst[k] = coTrk.nearestPoint(*trk[fst],false,0.0,0.0,seg,trkPt);
+      continue;
+    }
+
+    if (expS < 0) expS += coTrk.length;
+    else if (expS > coTrk.length) expS -= coTrk.length;
+
+    double minS = expS - halfWidth;
+    if (minS < 0) minS += coTrk.length;
+
+    double maxS = expS + halfWidth;
+    if (maxS > coTrk.length) maxS -= coTrk.length;
+
+    seedLst[k] = coTrk.nearestPoint(*trk[fst],true,minS,maxS,seg,trkPt);
+  }
+
+  auto doChunk = [&](int k) {
+    int fst = k*CoTrackChunk;
+    int cnt = sz - fst;
+    if (cnt > CoTrackChunk) cnt = CoTrackChunk;
+
+    setCoTrackRange(coTrk,reverseDir,maxSDiff,fst,cnt,seedLst[k]);
+  };
+
+  if (threadCnt < 2) {
+    for (int k=0; k<chunkCnt; ++k) doChunk(k);
+  }
+  else {
+    WorkerPool pool(std::min(threadCnt,chunkCnt));
+    pool.run(chunkCnt,doChunk);
+  }
+
+  setModified();
+}
+
 //---------------------------------------------------------------------------
 
 double ArcLinTrack::getMaxS() const
@@ -531,6 +646,15 @@ double ArcLinTrack::getMaxS() const
 //---------------------------------------------------------------------------
 
 void ArcLinTrack::getPoint(double at_s, Vec3& p) const
+{
+  int cursor = -1;
+
+  getPoint(at_s,p,cursor);
+}
+
+//---------------------------------------------------------------------------
+
+void ArcLinTrack::getPoint(double at_s, Vec3& p, int& cursor) const
 {
   int sz = trk.size();
 
@@ -559,7 +683,7 @@ void ArcLinTrack::getPoint(double at_s, Vec3& p) const
   int lowidx, hghidx;
   double rel_parm;
 
-  findPointPair(at_s, lowidx, hghidx, rel_parm);
+  findPointPair(at_s, lowidx, hghidx, rel_parm, cursor);
 
   Vec3 p2;
   trk[lowidx]->getPoint(rel_parm,p);      p  *= (1.0 - rel_parm);
@@ -571,6 +695,15 @@ void ArcLinTrack::getPoint(double at_s, Vec3& p) const
 //---------------------------------------------------------------------------
 
 void ArcLinTrack::getPointAndDir(double at_s, Vec3& pnt, Vec3& dir) const
+{
+  int cursor = -1;
+
+  getPointAndDir(at_s,pnt,dir,cursor);
+}
+
+//---------------------------------------------------------------------------
+
+void ArcLinTrack::getPointAndDir(double at_s, Vec3& pnt, Vec3& dir, int& cursor) const
 {
   int sz = trk.size();
 
@@ -603,7 +736,7 @@ void ArcLinTrack::getPointAndDir(double at_s, Vec3& pnt, Vec3& dir) const
   int lowIdx, hghIdx;
   double relParm;
 
-  findPointPair(at_s, lowIdx, hghIdx, relParm);
+  findPointPair(at_s, lowIdx, hghIdx, relParm, cursor);
 
   Vec3 v1,v2,p1,p2;
   trk[lowIdx]->getDir(relParm,v1);       
@@ -627,6 +760,15 @@ void ArcLinTrack::getPointAndDir(double at_s, Vec3& pnt, Vec3& dir) const
 //---------------------------------------------------------------------------
 
 void ArcLinTrack::getDir(double at_s, Vec3& dir) const
+{
+  int cursor = -1;
+
+  getDir(at_s,dir,cursor);
+}
+
+//---------------------------------------------------------------------------
+
+void ArcLinTrack::getDir(double at_s, Vec3& dir, int& cursor) const
 {
   int sz = trk.size();
 
@@ -651,7 +793,7 @@ void ArcLinTrack::getDir(double at_s, Vec3& dir) const
   int lowidx, hghidx;
   double rel_parm;
 
-  findPointPair(at_s, lowidx, hghidx, rel_parm);
+  findPointPair(at_s, lowidx, hghidx, rel_parm, cursor);
 
   Vec3 v1,v2,p1,p2;
   trk[lowidx]->getDir(rel_parm,v1);     v1 *= (1.0-rel_parm);
@@ -668,6 +810,15 @@ void ArcLinTrack::getDir(double at_s, Vec3& dir) const
 //---------------------------------------------------------------------------
 
 void ArcLinTrack::getAcc(double at_s, Vec3& acc) const
+{
+  int cursor = -1;
+
+  getAcc(at_s,acc,cursor);
+}
+
+//---------------------------------------------------------------------------
+
+void ArcLinTrack::getAcc(double at_s, Vec3& acc, int& cursor) const
 {
     if (!closed) {
       if (at_s < 0.0 || at_s > length) {
@@ -681,7 +832,7 @@ void ArcLinTrack::getAcc(double at_s, Vec3& acc) const
     int lowidx, hghidx;
     double rel_parm;
 
-    findPointPair(at_s, lowidx, hghidx, rel_parm);
+    findPointPair(at_s, lowidx, hghidx, rel_parm, cursor);
 
     Vec3 a1,a2,v1,v2,p1,p2;
     trk[lowidx]->getAcc(rel_parm,a1);
@@ -711,6 +862,15 @@ void ArcLinTrack::getAcc(double at_s, Vec3& acc) const
 //---------------------------------------------------------------------------
 
 void ArcLinTrack::getJerk(double at_s, Ino::Vec3& jerk) const
+{
+  int cursor = -1;
+
+  getJerk(at_s,jerk,cursor);
+}
+
+//---------------------------------------------------------------------------
+
+void ArcLinTrack::getJerk(double at_s, Ino::Vec3& jerk, int& cursor) const
 {
     if (!closed) {
       if (at_s < 0.0 || at_s > length) {
@@ -724,7 +884,7 @@ void ArcLinTrack::getJerk(double at_s, Ino::Vec3& jerk) const
     int lowidx, hghidx;
     double rel_parm;
 
-    findPointPair(at_s, lowidx, hghidx, rel_parm);
+    findPointPair(at_s, lowidx, hghidx, rel_parm, cursor);
 
     Vec3 j1,j2,a1,a2,v1,v2,p1,p2;
     trk[lowidx]->getJerk(rel_parm,j1);
@@ -770,6 +930,15 @@ void ArcLinTrack::getJerk(double at_s, Ino::Vec3& jerk) const
 //---------------------------------------------------------------------------
 
 void ArcLinTrack::getXDir(double at_s, Vec3& x, Vec3& xDer) const
+{
+  int cursor = -1;
+
+  getXDir(at_s,x,xDer,cursor);
+}
+
+//---------------------------------------------------------------------------
+
+void ArcLinTrack::getXDir(double at_s, Vec3& x, Vec3& xDer, int& cursor) const
 {
   x.isDerivative = false;
   xDer.isDerivative = true;
@@ -796,7 +965,7 @@ void ArcLinTrack::getXDir(double at_s, Vec3& x, Vec3& xDer) const
   int lowidx, hghidx;
   double rel_parm;
 
-  findPointPair(at_s, lowidx, hghidx, rel_parm);
+  findPointPair(at_s, lowidx, hghidx, rel_parm, cursor);
 
   Vec3 a1,a2,v1,v2,p1,p2;
   trk[lowidx]->getAcc(rel_parm,a1);
@@ -846,174 +1015,562 @@ void ArcLinTrack::getXDir(double at_s, Vec3& x, Vec3& xDer) const
 }
 
 //---------------------------------------------------------------------------
+// As getPointAndDir(), getAcc(), getJerk() and getXDir() together,
+// with a single lookup and evaluation of the neighbouring points
 
-static double along(const Vec3& p1, const Vec3& p2, const Vec3& p,
-                                                    Vec3& prjP, double &dist)
+void ArcLinTrack::evaluate(double at_s, int maxOrder, TrackSample& smp,
+                                                      int& cursor) const
 {
-  Vec3 dir(p2); dir -= p1; dir.unitLen3();
+  smp.s = at_s;
+  smp.order = maxOrder > 2 ? 3 : 2;
 
-  Vec3 pp(p); pp -= p1;
+  smp.xDir.isDerivative = false;
+  smp.xDer.isDerivative = true;
 
-  double s = dir * pp;
+  if (!closed && (at_s < 0.0 || at_s > length)) {
+    int idx = at_s < 0.0 ? 0 : trk.size()-1;
+    if (idx < 0) idx = 0;
 
-  prjP = dir; prjP *= s; prjP += p1;
+    const ArcLinTrackPt& endPt = *trk[idx];
 
-  dir.rot90();
+    endPt.getDir(0.0,smp.dir);
+    smp.dir.unitLen3();
+
+    smp.pnt = smp.dir; smp.pnt *= at_s < 0.0 ? at_s : at_s-length;
+    smp.pnt += endPt.getPoint();
+
+    smp.acc = Vec3(0,0,0);
+    smp.acc.isDerivative = true;
+
+    smp.jerk = smp.acc;
+    smp.xDir = endPt.getZDir();
+    smp.xDer = smp.acc;
+
+    return;
+  }
+
+  int lowidx, hghidx;
+  double rel_parm;
+
+  findPointPair(at_s, lowidx, hghidx, rel_parm, cursor);
+
+  const ArcLinTrackPt& lowPt = *trk[lowidx];
+  const ArcLinTrackPt& hghPt = *trk[hghidx];
+
+  Vec3 a1,a2,v1,v2,p1,p2;
+  lowPt.getAcc(rel_parm,a1);
+  lowPt.getDir(rel_parm,v1);
+  lowPt.getPoint(rel_parm,p1);
+
+  hghPt.getAcc(rel_parm-1.0,a2);
+  hghPt.getDir(rel_parm-1.0,v2);
+  hghPt.getPoint(rel_parm-1.0,p2);
+
+  if (maxOrder > 2) {
+    Vec3 j1,j2;
+    lowPt.getJerk(rel_parm,j1);
+    hghPt.getJerk(rel_parm-1.0,j2);
+
+    j1 *= (1.0-rel_parm); j2 *= rel_parm;
+    smp.jerk = j1; smp.jerk += j2; smp.jerk += (a2 - a1)*3.0;
+  }
+
+  a1 *= (1.0-rel_parm); a2 *= rel_parm;
+  Vec3 acc = a1; acc += a2; acc += (v2 - v1)*2.0;
+
+  v1 *= (1.0-rel_parm); v2 *= rel_parm;
+
+  Vec3 dir = v1; dir += v2; dir += (p2 - p1);
 
-  dist = fabs(dir * pp);
+  p1 *= (1.0 - rel_parm); p2 *= rel_parm;
+  smp.pnt = p1; smp.pnt += p2;
 
-  return s;
+  // Normalised as the getters do, the direction as getDir(),
+  // the direction used for the derivatives as getAcc() and getXDir():
+
+  smp.dir = dir;
+  if (smp.dir.len3() > 0.0) smp.dir.unitLen3();
+
+  double len = dir.len3();
+  dir /= len;
+
+  double proj = acc * dir;
+
+  acc -= (dir*proj);
+  acc /= (len*len);
+
+  smp.acc = acc;
+
+  if (maxOrder > 2) {
+    Vec3& jerk = smp.jerk;
+
+    jerk /= (len*len*len);
+    proj *= 3.0;
+    jerk -= (acc * proj);
+
+    proj = jerk*dir + acc*acc;
+
+    jerk -= (dir * proj);
+  }
+
+  // x-direction, as getXDir():
+
+  Vec3 z  = lowPt.getZDir();
+  Vec3 z2 = hghPt.getZDir();
+
+  Vec3 dz = z2; dz -= z; dz /= lowPt.maxS;
+
+  z *= (1.0-rel_parm);
+  z2 *= rel_parm;
+
+  z += z2;
+
+  smp.xDir = dir.outer(z);
+
+  double xLen = smp.xDir.len3();
+
+  smp.xDir /= xLen;
+
+  smp.xDer = acc.outer(z); smp.xDer += dir.outer(dz); smp.xDer /= xLen;
+
+  Vec3 dx2 = smp.xDir; dx2 *= (smp.xDir*smp.xDer);
+
+  smp.xDer -= dx2;
 }
 
 //---------------------------------------------------------------------------
+// Segment seg runs from track point seg to the next one
 
-double ArcLinTrack::findPoint(const Vec3& p) const
+int ArcLinTrack::getSegCnt() const
 {
-  Vec3 trkPt;
+  int sz = trk.size();
+  if (sz < 2) return 0;
 
-  return findPoint(p,trkPt);
+  return closed ? sz : sz-1;
+}
+
+//---------------------------------------------------------------------------
+
+double ArcLinTrack::getSegSpan(int seg) const
+{
+  int nxt = seg+1 < trk.size() ? seg+1 : 0;
+
+  double span = trk[nxt]->s - trk[seg]->s;
+  if (span <= 0.0) span += length;
+
+  return span;
 }
 
-// --------------------------------------------------------------------------
-// --- Currently interpolated as a polyline (to be improved) ----------------
-// --------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// Point, first and second derivative to rel of the track as interpolated
+// by getPoint(), getDir() and getAcc()
 
-double ArcLinTrack::findPoint(const Vec3& p, Vec3& trkPt) const
+void ArcLinTrack::getSegPoint(int seg, double rel, Vec3& p,
+                                                   Vec3& v, Vec3& a) const
 {
-  int sz = trk.size();
+  const ArcLinTrackPt& lowPt = *trk[seg];
+  const ArcLinTrackPt& hghPt = *trk[seg+1 < trk.size() ? seg+1 : 0];
+
+  Vec3 p1,p2,v1,v2,a1,a2;
+  lowPt.getPoint(rel,p1);     lowPt.getDir(rel,v1);     lowPt.getAcc(rel,a1);
+  hghPt.getPoint(rel-1.0,p2); hghPt.getDir(rel-1.0,v2); hghPt.getAcc(rel-1.0,a2);
 
-  if (sz < 2) return 0.0;
+  a = a2; a -= a1; a *= rel; a += a1; a += (v2 - v1)*2.0;
+  v = v2; v -= v1; v *= rel; v += v1; v += (p2 - p1);
+  p = p2; p -= p1; p *= rel; p += p1;
+}
+
+//---------------------------------------------------------------------------
+// Closest point of segment seg for lwb <= rel <= upb, returns the
+// squared distance.
+// Samples the distance, then Newton on the sign changes of its
+// derivative, safeguarded by bisection.
+
+double ArcLinTrack::nearestOnSeg(const Vec3& p, int seg, double lwb,
+                          double upb, double& rel, Vec3& trkPt) const
+{
+  const int SampleCnt = 2;
 
-  int idx = 0;
-  double minDist = 0.0;
+  Vec3 c, v, a;
+  double prvR = 0.0, prvG = 0.0, minDist = 0.0;
 
-  for (int i=0; i<sz; i++) {
-    const Vec3& trkP = trk[i]->getPoint();
+  for (int k=0; k<=SampleCnt; ++k) {
+    double r = lwb + (upb-lwb)*k/SampleCnt;
 
-    double dist = p.distTo3(trkP);
+    getSegPoint(seg,r,c,v,a);
+    c -= p;
 
-    if (i < 1 || dist < minDist) {
+    double dist = c*c, g = c*v;
+
+    if (k < 1 || dist < minDist) {
       minDist = dist;
-      idx = i;
+      rel = r;
+      trkPt = c; trkPt += p;
     }
+
+    if (k > 0 && prvG < 0.0 && g > 0.0) {
+      double lo = prvR, hi = r, cur = (lo + hi)/2.0;
+
+      for (int it=0; it<30; ++it) {
+        getSegPoint(seg,cur,c,v,a);
+        c -= p;
+
+        double cg = c*v, dg = v*v + c*a;
+
+        if (cg < 0.0) lo = cur;
+        else hi = cur;
+
+        double nxt = dg > 0.0 ? cur - cg/dg : (lo + hi)/2.0;
+        if (nxt <= lo || nxt >= hi) nxt = (lo + hi)/2.0;
+
+        bool done = fabs(nxt - cur) < 1e-12;
+        cur = nxt;
+
+        if (done) break;
+      }
+
+      getSegPoint(seg,cur,c,v,a);
+      c -= p;
+
+      if (c*c < minDist) {
+        minDist = c*c;
+        rel = cur;
+        trkPt = c; trkPt += p;
+      }
+    }
+
+    prvR = r;
+    prvG = g;
   }
 
-  double s1=0.0, minDist1 = minDist;
-  Vec3 trkPt1;
+  return minDist;
+}
 
-  int idx1 = idx-1, idx2 = idx;
-  if (idx1 < 0) idx1 = sz-1;
+//---------------------------------------------------------------------------
+// The segment lies within the sagittas of the point arcs from its chord
+
+static double segSagitta(const ArcLinTrackPt& pt, double spanS)
+{
+  if (!pt.getIsArc()) return 0.0;
+
+  double rad = pt.getRad();
+  double ang = fabs(spanS)/rad;
+
+  if (ang > Vec2::Pi) return 2.0*rad;
+
+  return rad * (1.0 - cos(ang/2.0));
+}
+
+//---------------------------------------------------------------------------
 
-  if (idx < 1 && !closed) {
-    s1 =  along(trk[0]->getPoint(),trk[1]->getPoint(),p,trkPt1,minDist1);
-    s1 += trk[0]->getS();
+static const int LeafSegCnt = 4;
+
+void ArcLinTrack::buildBox(int node, int fst, int cnt)
+{
+  Vec3& lo = boxLst[2*node];
+  Vec3& hi = boxLst[2*node+1];
+
+  if (cnt <= LeafSegCnt) {
+    int sz = trk.size();
+
+    for (int i=fst; i<fst+cnt; ++i) {
+      const ArcLinTrackPt& lowPt = *trk[i];
+      const ArcLinTrackPt& hghPt = *trk[i+1 < sz ? i+1 : 0];
+
+      double h = std::max(segSagitta(lowPt,lowPt.maxS),
+                          segSagitta(hghPt,hghPt.minS));
+      h += 1e-9 * (1.0 + lowPt.distTo3(hghPt));
+
+      Vec3 segLo(lowPt), segHi(lowPt);
+
+      segLo.x = std::min(segLo.x,hghPt.x) - h;
+      segLo.y = std::min(segLo.y,hghPt.y) - h;
+      segLo.z = std::min(segLo.z,hghPt.z) - h;
+      segHi.x = std::max(segHi.x,hghPt.x) + h;
+      segHi.y = std::max(segHi.y,hghPt.y) + h;
+      segHi.z = std::max(segHi.z,hghPt.z) + h;
+
+      if (i == fst) { lo = segLo; hi = segHi; continue; }
+
+      lo.x = std::min(lo.x,segLo.x); hi.x = std::max(hi.x,segHi.x);
+      lo.y = std::min(lo.y,segLo.y); hi.y = std::max(hi.y,segHi.y);
+      lo.z = std::min(lo.z,segLo.z); hi.z = std::max(hi.z,segHi.z);
+    }
   }
   else {
-    s1 =  along(trk[idx1]->getPoint(),trk[idx2]->getPoint(),p,trkPt1,minDist1);
-    s1 += trk[idx1]->getS();
+    int half = cnt/2;
+
+    buildBox(2*node+1,fst,half);
+    buildBox(2*node+2,fst+half,cnt-half);
+
+    const Vec3& lo1 = boxLst[4*node+2]; const Vec3& hi1 = boxLst[4*node+3];
+    const Vec3& lo2 = boxLst[4*node+4]; const Vec3& hi2 = boxLst[4*node+5];
+
+    lo.x = std::min(lo1.x,lo2.x); hi.x = std::max(hi1.x,hi2.x);
+    lo.y = std::min(lo1.y,lo2.y); hi.y = std::max(hi1.y,hi2.y);
+    lo.z = std::min(lo1.z,lo2.z); hi.z = std::max(hi1.z,hi2.z);
   }
+}
 
+//---------------------------------------------------------------------------
 
-  double s2=0.0, minDist2 = minDist;
-  Vec3 trkPt2;
+void ArcLinTrack::buildBoxTree()
+{
+  boxLst.clear();
 
-  idx1 = idx; idx2 = idx+1;
-  if (idx2 >= sz) idx2 = 0;
+  int segCnt = getSegCnt();
+  if (segCnt < 1) return;
 
-  if (idx >= sz-1 && !closed) {
-    s2 =  along(trk[sz-2]->getPoint(),trk[sz-1]->getPoint(),p,trkPt2,minDist2);
-    s2 += trk[sz-2]->getS();
-  }
-  else {
-    s2 =  along(trk[idx1]->getPoint(),trk[idx2]->getPoint(),p,trkPt2,minDist2);
-    s2 += trk[idx1]->getS();
+  int leafCnt = 1;
+  while (leafCnt * LeafSegCnt < segCnt) leafCnt *= 2;
+
+  boxLst.resize(2*(2*leafCnt-1));
+
+  buildBox(0,0,segCnt);
+}
+
+//---------------------------------------------------------------------------
+
+static double boxDist(const Vec3& p, const Vec3& lo, const Vec3& hi)
+{
+  double dx = std::max(std::max(lo.x - p.x,p.x - hi.x),0.0);
+  double dy = std::max(std::max(lo.y - p.y,p.y - hi.y),0.0);
+  double dz = std::max(std::max(lo.z - p.z,p.z - hi.z),0.0);
+
+  return dx*dx + dy*dy + dz*dz;
+}
+
+//---------------------------------------------------------------------------
+
+static double chordDist(const Vec3& p1, const Vec3& p2, const Vec3& p)
+{
+  Vec3 dir(p2); dir -= p1;
+  Vec3 d(p); d -= p1;
+
+  double sqLen = dir*dir;
+  double t = sqLen > 0.0 ? (d*dir)/sqLen : 0.0;
+
+  if (t > 1.0) t = 1.0;
+  else if (t < 0.0) t = 0.0;
+
+  dir *= t; d -= dir;
+
+  return d.len3();
+}
+
+//---------------------------------------------------------------------------
+// Range lwb..upb of rel within segment s range fstS..fstS+span
+
+static int rangeOverlap(double fstS, double span, bool ranged,
+                        double minS, double maxS, double length,
+                        double *lwb, double *upb)
+{
+  if (!ranged) {
+    lwb[0] = 0.0; upb[0] = 1.0;
+    return 1;
   }
 
-  if (minDist1 < minDist2) {
-    trkPt = trkPt1;
-    return s1;
+  double loLst[2], hiLst[2];
+  int rngCnt = 1;
+
+  if (minS <= maxS) {
+    loLst[0] = minS; hiLst[0] = maxS;
   }
   else {
-    trkPt = trkPt2;
-    return s2;
+    loLst[0] = minS; hiLst[0] = length;
+    loLst[1] = 0.0;  hiLst[1] = maxS;
+    rngCnt = 2;
+  }
+
+  int cnt = 0;
+
+  for (int i=0; i<rngCnt; ++i) {
+    double lo = std::max((loLst[i] - fstS)/span,0.0);
+    double hi = std::min((hiLst[i] - fstS)/span,1.0);
+
+    if (lo > hi) continue;
+
+    lwb[cnt] = lo; upb[cnt] = hi;
+    cnt++;
   }
+
+  return cnt;
 }
 
 //---------------------------------------------------------------------------
+// Segments fst .. fst+cnt-1, improves bestSeg, minDist (squared), bestS
+// and trkPt. bestSeg < 0: nothing found yet
 
-double ArcLinTrack::findPoint(const Vec3& p, double minS, double maxS,
-                                                        Vec3& trkPt) const
+void ArcLinTrack::nearestOnSegs(const Vec3& p, int fst, int cnt, bool ranged,
+                                double minS, double maxS, int& bestSeg,
+                                double& minDist, double& bestS,
+                                Vec3& trkPt) const
 {
   int sz = trk.size();
 
-  if (sz < 2) return 0.0;
+  for (int i=fst; i<fst+cnt; ++i) {
+    const ArcLinTrackPt& lowPt = *trk[i];
+    const ArcLinTrackPt& hghPt = *trk[i+1 < sz ? i+1 : 0];
+
+    if (bestSeg >= 0) { // Lower bound: distance to the chord - sagitta
+      double h = std::max(segSagitta(lowPt,lowPt.maxS),
+                          segSagitta(hghPt,hghPt.minS));
+      double lb = chordDist(lowPt,hghPt,p) - h;
+
+      if (lb > 0.0 && lb*lb >= minDist) continue;
+    }
+
+    double span = getSegSpan(i);
+    double lwb[2], upb[2];
 
-  int idx = 0;
-  double minDist = 0.0;
-  bool fst = true;
+    int rngCnt = rangeOverlap(lowPt.s,span,ranged,minS,maxS,length,lwb,upb);
 
-  for (int i=0; i<sz; i++) {
-    const Vec3& trkP = trk[i]->getPoint();
+    for (int k=0; k<rngCnt; ++k) {
+      double rel = 0.0;
+      Vec3 pt;
 
-    double s = trk[i]->getS();
+      double dist = nearestOnSeg(p,i,lwb[k],upb[k],rel,pt);
 
-    if (minS <= maxS) {
-      if (s < minS || s > maxS) continue;
+      if (bestSeg < 0 || dist < minDist) {
+        minDist = dist;
+        bestSeg = i;
+        bestS   = lowPt.s + rel*span;
+        trkPt   = pt;
+      }
     }
-    else {
-      if (s < minS && s > maxS) continue;
+  }
+}
+
+//---------------------------------------------------------------------------
+// Depth first through the box tree, nearest child first, skipping the
+// boxes further away than the closest point found so far.
+// If ranged, only s in minS..maxS (minS > maxS: passing the start)
+// seg: segment tried first (< 0: none), returns the closest segment.
+// A seed near the answer prunes all but the boxes around p.
+
+double ArcLinTrack::nearestPoint(const Vec3& p, bool ranged, double minS,
+                               double maxS, int& seg, Vec3& trkPt) const
+{
+  int segCnt = getSegCnt();
+  if (segCnt < 1 || boxLst.empty()) return 0.0;
+
+  const int StackSz = 3*64;
+  int stack[StackSz], top = 0;
+
+  stack[top++] = 0; stack[top++] = 0; stack[top++] = segCnt;
+
+  double minDist = 0.0, bestS = 0.0;
+  int bestSeg = -1;
+
+  if (seg < 0 || seg >= segCnt) seg = -1;
+  else nearestOnSegs(p,seg,1,ranged,minS,maxS,bestSeg,minDist,bestS,trkPt);
+
+  while (top > 0) {
+    int cnt  = stack[--top];
+    int fst  = stack[--top];
+    int node = stack[--top];
+
+    if (bestSeg >= 0 &&
+        boxDist(p,boxLst[2*node],boxLst[2*node+1]) >= minDist) continue;
+
+    if (ranged) {
+      double lwb[2], upb[2];
+      double fstS = trk[fst]->s;
+      double span = trk[fst+cnt-1]->s + getSegSpan(fst+cnt-1) - fstS;
+
+      if (rangeOverlap(fstS,span,true,minS,maxS,length,lwb,upb) < 1) continue;
     }
 
-    double dist = p.distTo3(trkP);
+    if (cnt > LeafSegCnt) {
+      int half = cnt/2;
+      int n1 = 2*node+1, n2 = 2*node+2;
 
-    if (fst || dist < minDist) {
-      minDist = dist;
-      idx = i;
-      fst = false;
+      double d1 = boxDist(p,boxLst[2*n1],boxLst[2*n1+1]);
+      double d2 = boxDist(p,boxLst[2*n2],boxLst[2*n2+1]);
+
+      if (top + 6 > StackSz)
+        throw IndexOutOfBoundsException("ArcLinTrack::nearestPoint");
+
+      if (d1 <= d2) { // Nearest last, first popped
+        stack[top++] = n2; stack[top++] = fst+half; stack[top++] = cnt-half;
+        stack[top++] = n1; stack[top++] = fst;      stack[top++] = half;
+      }
+      else {
+        stack[top++] = n1; stack[top++] = fst;      stack[top++] = half;
+        stack[top++] = n2; stack[top++] = fst+half; stack[top++] = cnt-half;
+      }
+
+      continue;
+    }
+
+    if (seg < fst || seg >= fst+cnt)
+      nearestOnSegs(p,fst,cnt,ranged,minS,maxS,bestSeg,minDist,bestS,trkPt);
+    else { // Skip the seed
+      nearestOnSegs(p,fst,seg-fst,ranged,minS,maxS,
+                                         bestSeg,minDist,bestS,trkPt);
+      nearestOnSegs(p,seg+1,fst+cnt-seg-1,ranged,minS,maxS,
+                                         bestSeg,minDist,bestS,trkPt);
     }
   }
 
-  if (fst) return 0.0;
+  seg = bestSeg;
+  if (bestSeg < 0) return 0.0;
 
-  double s1=0.0, minDist1 = minDist;
-  Vec3 trkPt1;
+  // An open track continues straight beyond its ends, see getPoint()
 
-  int idx1 = idx-1, idx2 = idx;
-  if (idx1 < 0) idx1 = sz-1;
+  if (!closed && !ranged) {
+    for (int k=0; k<2; ++k) {
+      const ArcLinTrackPt& endPt = *trk[k < 1 ? 0 : trk.size()-1];
 
-  if (idx < 1 && !closed) {
-    s1 =  along(trk[0]->getPoint(),trk[1]->getPoint(),p,trkPt1,minDist1);
-    s1 += trk[0]->getS();
-  }
-  else {
-    s1 =  along(trk[idx1]->getPoint(),trk[idx2]->getPoint(),p,trkPt1,minDist1);
-    s1 += trk[idx1]->getS();
-  }
+      Vec3 dir;
+      endPt.getDir(0.0,dir); dir.unitLen3();
 
+      Vec3 d(p); d -= endPt;
+      double ds = dir * d;
 
-  double s2=0.0, minDist2 = minDist;
-  Vec3 trkPt2;
+      if (k < 1 ? ds >= 0.0 : ds <= 0.0) continue;
 
-  idx1 = idx; idx2 = idx+1;
-  if (idx2 >= sz) idx2 = 0;
+      Vec3 pt(dir); pt *= ds; pt += endPt;
+      d = p; d -= pt;
 
-  if (idx >= sz-1 && !closed) {
-    s2 =  along(trk[sz-2]->getPoint(),trk[sz-1]->getPoint(),p,trkPt2,minDist2);
-    s2 += trk[sz-2]->getS();
-  }
-  else {
-    s2 =  along(trk[idx1]->getPoint(),trk[idx2]->getPoint(),p,trkPt2,minDist2);
-    s2 += trk[idx1]->getS();
+      if (d*d < minDist) {
+        minDist = d*d;
+        trkPt = pt;
+        bestS = k < 1 ? ds : length + ds;
+      }
+    }
   }
 
-  if (minDist1 < minDist2) {
-    trkPt = trkPt1;
-    return s1;
-  }
-  else {
-    trkPt = trkPt2;
-    return s2;
-  }
+  return bestS;
+}
+
+//---------------------------------------------------------------------------
+
+double ArcLinTrack::findPoint(const Vec3& p) const
+{
+  Vec3 trkPt;
+
+  return findPoint(p,trkPt);
+}
+
+//---------------------------------------------------------------------------
+// The closest point of the track as interpolated by getPoint()
+
+double ArcLinTrack::findPoint(const Vec3& p, Vec3& trkPt) const
+{
+  int seg = -1;
+
+  return nearestPoint(p,false,0.0,0.0,seg,trkPt);
+}
+
+//---------------------------------------------------------------------------
+
+double ArcLinTrack::findPoint(const Vec3& p, double minS, double maxS,
+                                                        Vec3& trkPt) const
+{
+  int seg = -1;
+
+  return nearestPoint(p,true,minS,maxS,seg,trkPt);
 }
 
 } // namespace
@@ -1055,6 +1612,13 @@ void ArcLinTrackSetCoTrack(void* track, void* coTrack, bool reverseDir, double m
   trk->setCoTrack(*coTrk, reverseDir, maxSDiff);
 }
 
+void ArcLinTrackSetCoTrackParallel(void* track, void* coTrack, bool reverseDir, double maxSDiff, int threadCnt)   {
+  InoKin::ArcLinTrack* trk = (InoKin::ArcLinTrack*)track;
+  InoKin::ArcLinTrack* coTrk = (InoKin::ArcLinTrack*)coTrack;
+
+  trk->setCoTrackParallel(*coTrk, reverseDir, maxSDiff, threadCnt);
+}
+
 int ArcLinTrackGetSize(void* track) {
   InoKin::ArcLinTrack* trk = (InoKin::ArcLinTrack*)track;
 
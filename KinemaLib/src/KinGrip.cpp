@@ -29,8 +29,8 @@ Grip::Grip(Model& model, const wchar_t *name,
            Body& body_1, const Trf3& pos_1,
            Body& body_2, const Trf3& pos_2)
 : Object(model,name),
-  pos1(*new Trf3(pos_1)), invPos1(*new Trf3()),
-  pos2(*new Trf3(pos_2)), invPos2(*new Trf3()),
+  pos1(pos_1), invPos1(),
+  pos2(pos_2), invPos2(),
   body1(&body_1), body2(&body_2), joint(NULL),
   parentRel(false), loopCnt(0)
 {
@@ -46,8 +46,8 @@ Grip::Grip(Model& model, const wchar_t *name,
 
 Grip::Grip(Model& model, const Grip& cp)
 : Object(model,cp),
-  pos1(*new Trf3(cp.pos1)), invPos1(*new Trf3(cp.invPos1)),
-  pos2(*new Trf3(cp.pos2)), invPos2(*new Trf3(cp.invPos2)),
+  pos1(cp.pos1), invPos1(cp.invPos1),
+  pos2(cp.pos2), invPos2(cp.invPos2),
   body1(NULL), body2(NULL), joint(NULL),
   parentRel(cp.parentRel), loopCnt(cp.loopCnt)
 {
@@ -58,11 +58,6 @@ Grip::Grip(Model& model, const Grip& cp)
 
 Grip::~Grip()
 {
-  delete &pos1;
-  delete &invPos1;
-  delete &pos2;
-  delete &invPos2;
-
   if (body1 != NULL) body1->remove(this);
   if (body2 != NULL) body2->remove(this);
 
@@ -161,7 +156,7 @@ void GripList::setAngularVars(bool *angularVar) const
 
     for (int j=0; j<varCnt; ++j) {
       int idx = jnt->getVarIdx(j);
-      if (idx < 0) continue;
+      if (idx < 0 || jnt->getFixed(j)) continue; // Fixed vars: other index range
 
       angularVar[idx] = jnt->getIsAngular(j);
     }
@@ -28,7 +28,7 @@ AbstractJoint *JntBall::clone(Grip& newGrip) const
 //-------------------------------------------------------------------------------
 
 JntBall::JntBall(Grip& grp, const wchar_t *name)
-: AbstractJoint(grp,name,3)
+: JntKernel<JntBall>(grp,name,3)
 {
   isAngular[0] = true;
   isAngular[1] = true;
@@ -38,139 +38,18 @@ JntBall::JntBall(Grip& grp, const wchar_t *name)
 //-------------------------------------------------------------------------------
 
 JntBall::JntBall(Grip& grp, const JntBall& cp)
-: AbstractJoint(grp,cp)
+: JntKernel<JntBall>(grp,cp)
 {
 }
 
 //-------------------------------------------------------------------------------
 
-void JntBall::getVarTrf(int idx, Trf3& trf) const
+void JntBall::varTrfKernel(int idx, int kind, Trf3& trf) const
 {
-  trf.init();
-  trf.isDerivative = false;
-
-  if (idx == 0) {
-    double ca = cos(varPos[0]);
-    double sa = sin(varPos[0]);
-
-    trf(0,0) =  ca;  trf(0,1) = sa; trf(0,2) = 0; trf(0,3) = 0;
-    trf(1,0) = -sa;  trf(1,1) = ca; trf(1,2) = 0; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =  0; trf(2,2) = 1; trf(2,3) = 0;
-  }
-  else if (idx == 1) {
-    double cb = cos(varPos[1]);
-    double sb = sin(varPos[1]);
-
-    trf(0,0) =  cb;  trf(0,1) =  0; trf(0,2) = -sb; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  1; trf(1,2) =   0; trf(1,3) = 0;
-    trf(2,0) =  sb;  trf(2,1) =  0; trf(2,2) =  cb; trf(2,3) = 0;
-  }
-  else if (idx == 2) {
-    double cc = cos(varPos[2]);
-    double sc = sin(varPos[2]);
-
-    trf(0,0) =   1;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  cc; trf(1,2) =  sc; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) = -sc; trf(2,2) =  cc; trf(2,3) = 0;
-  }
-}
-
-//-------------------------------------------------------------------------------
-
-void JntBall::getVarDerTrf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx == 0) {
-    double ca = cos(varPos[0]);
-    double sa = sin(varPos[0]);
-
-    trf(0,0) = -sa;  trf(0,1) =  ca; trf(0,2) = 0; trf(0,3) = 0;
-    trf(1,0) = -ca;  trf(1,1) = -sa; trf(1,2) = 0; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-  }
-  else if (idx == 1) {
-    double cb = cos(varPos[1]);
-    double sb = sin(varPos[1]);
-
-    trf(0,0) = -sb;  trf(0,1) =  0; trf(0,2) = -cb; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-    trf(2,0) =  cb;  trf(2,1) =  0; trf(2,2) = -sb; trf(2,3) = 0;
-  }
-  else if (idx == 2) {
-    double cc = cos(varPos[2]);
-    double sc = sin(varPos[2]);
-
-    trf(0,0) =   0;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) = -sc; trf(1,2) =  cc; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) = -cc; trf(2,2) = -sc; trf(2,3) = 0;
-  }
-}
-
-//-------------------------------------------------------------------------------
-
-void JntBall::getVarDer2Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx == 0) {
-    double ca = cos(varPos[0]);
-    double sa = sin(varPos[0]);
-
-    trf(0,0) = -ca;  trf(0,1) = -sa; trf(0,2) = 0; trf(0,3) = 0;
-    trf(1,0) =  sa;  trf(1,1) = -ca; trf(1,2) = 0; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-  }
-  else if (idx == 1) {
-    double cb = cos(varPos[1]);
-    double sb = sin(varPos[1]);
-
-    trf(0,0) = -cb;  trf(0,1) =  0; trf(0,2) =  sb; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-    trf(2,0) = -sb;  trf(2,1) =  0; trf(2,2) = -cb; trf(2,3) = 0;
-  }
-  else if (idx == 2) {
-    double cc = cos(varPos[2]);
-    double sc = sin(varPos[2]);
-
-    trf(0,0) =   0;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) = -cc; trf(1,2) = -sc; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =  sc; trf(2,2) = -cc; trf(2,3) = 0;
-  }
-}
-
-//-------------------------------------------------------------------------------
-
-void JntBall::getVarDer3Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx == 0) {
-    double ca = cos(varPos[0]);
-    double sa = sin(varPos[0]);
-
-    trf(0,0) =  sa;  trf(0,1) = -ca; trf(0,2) = 0; trf(0,3) = 0;
-    trf(1,0) =  ca;  trf(1,1) =  sa; trf(1,2) = 0; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-  }
-  else if (idx == 1) {
-    double cb = cos(varPos[1]);
-    double sb = sin(varPos[1]);
-
-    trf(0,0) =  sb;  trf(0,1) =  0; trf(0,2) =  cb; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-    trf(2,0) = -cb;  trf(2,1) =  0; trf(2,2) =  sb; trf(2,3) = 0;
-  }
-  else if (idx == 2) {
-    double cc = cos(varPos[2]);
-    double sc = sin(varPos[2]);
-
-    trf(0,0) =   0;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  sc; trf(1,2) = -cc; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =  cc; trf(2,2) =  sc; trf(2,3) = 0;
+  switch (idx) {
+    case 0: rotVarTrf<2>(varPos[0],kind,trf); break;
+    case 1: rotVarTrf<1>(varPos[1],kind,trf); break;
+    case 2: rotVarTrf<0>(varPos[2],kind,trf); break;
   }
 }
 
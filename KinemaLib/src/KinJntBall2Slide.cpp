@@ -30,7 +30,7 @@ AbstractJoint *JntBall2Slide::clone(Grip& newGrip) const
 //-------------------------------------------------------------------------------
 
 JntBall2Slide::JntBall2Slide(Grip& grp, const wchar_t *name)
-: AbstractJoint(grp,name,5)
+: JntKernel<JntBall2Slide>(grp,name,5)
 {
   isAngular[0] = false;
   isAngular[1] = true;
@@ -42,215 +42,20 @@ JntBall2Slide::JntBall2Slide(Grip& grp, const wchar_t *name)
 //-------------------------------------------------------------------------------
 
 JntBall2Slide::JntBall2Slide(Grip& grp, const JntBall2Slide& cp)
-: AbstractJoint(grp,cp)
+: JntKernel<JntBall2Slide>(grp,cp)
 {
 }
 
 //-------------------------------------------------------------------------------
 
-void JntBall2Slide::getVarTrf(int idx, Trf3& trf) const
+void JntBall2Slide::varTrfKernel(int idx, int kind, Trf3& trf) const
 {
-  trf.init();
-  trf.isDerivative = false;
-
   switch (idx) {
-    case 0:
-      trf(0,0) = 1;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 1; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 1; trf(2,3) = varPos[0];
-    break;
-
-    case 1: {
-      double ca = cos(varPos[1]);
-      double sa = sin(varPos[1]);
-
-      trf(0,0) =  ca;  trf(0,1) = sa; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = -sa;  trf(1,1) = ca; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) =   0;  trf(2,1) =  0; trf(2,2) = 1; trf(2,3) = 0;
-    }
-    break;
-
-    case 2: {
-      double cb = cos(varPos[2]);
-      double sb = sin(varPos[2]);
-
-      trf(0,0) =  cb;  trf(0,1) =  0; trf(0,2) = -sb; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) =  1; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) =  sb;  trf(2,1) =  0; trf(2,2) =  cb; trf(2,3) = 0;
-    }
-    break;
-
-    case 3: {
-      double cc = cos(varPos[3]);
-      double sc = sin(varPos[3]);
-
-      trf(0,0) = 1;  trf(0,1) =   0; trf(0,2) =  0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) =  cc; trf(1,2) = sc; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = -sc; trf(2,2) = cc; trf(2,3) = 0;
-    }
-    break;
-
-    case 4:
-      trf(0,0) = 1;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 1; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 1; trf(2,3) = varPos[4];
-    break;
-  }
-}
-
-//-------------------------------------------------------------------------------
-
-void JntBall2Slide::getVarDerTrf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  switch (idx) {
-    case 0:
-      trf(0,0) = 0;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 1;
-    break;
-
-    case 1: {
-      double ca = cos(varPos[1]);
-      double sa = sin(varPos[1]);
-
-      trf(0,0) = -sa;  trf(0,1) =  ca; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = -ca;  trf(1,1) = -sa; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-    }
-    break;
-
-    case 2: {
-      double cb = cos(varPos[2]);
-      double sb = sin(varPos[2]);
-
-      trf(0,0) = -sb;  trf(0,1) =  0; trf(0,2) = -cb; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) =  cb;  trf(2,1) =  0; trf(2,2) = -sb; trf(2,3) = 0;
-    }
-    break;
-
-    case 3: {
-      double cc = cos(varPos[3]);
-      double sc = sin(varPos[3]);
-
-      trf(0,0) = 0;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = -sc; trf(1,2) =  cc; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = -cc; trf(2,2) = -sc; trf(2,3) = 0;
-    }
-    break;
-
-    case 4:
-      trf(0,0) = 0;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 1;
-    break;
-  }
-}
-
-//-------------------------------------------------------------------------------
-
-void JntBall2Slide::getVarDer2Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  switch (idx) {
-    case 0:
-      trf(0,0) = 0;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 0;
-    break;
-
-    case 1: {
-      double ca = cos(varPos[1]);
-      double sa = sin(varPos[1]);
-
-      trf(0,0) = -ca;  trf(0,1) = -sa; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) =  sa;  trf(1,1) = -ca; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-    }
-    break;
-
-    case 2: {
-      double cb = cos(varPos[2]);
-      double sb = sin(varPos[2]);
-
-      trf(0,0) = -cb;  trf(0,1) =  0; trf(0,2) =  sb; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) = -sb;  trf(2,1) =  0; trf(2,2) = -cb; trf(2,3) = 0;
-    }
-    break;
-
-    case 3: {
-      double cc = cos(varPos[3]);
-      double sc = sin(varPos[3]);
-
-      trf(0,0) = 0;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = -cc; trf(1,2) = -sc; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) =  sc; trf(2,2) = -cc; trf(2,3) = 0;
-    }
-    break;
-
-    case 4:
-      trf(0,0) = 0;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 0;
-    break;
-  }
-}
-
-//-------------------------------------------------------------------------------
-
-void JntBall2Slide::getVarDer3Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  switch (idx) {
-    case 0:
-      trf(0,0) = 0;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 0;
-    break;
-
-    case 1: {
-      double ca = cos(varPos[1]);
-      double sa = sin(varPos[1]);
-
-      trf(0,0) =  sa;  trf(0,1) = -ca; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) =  ca;  trf(1,1) =  sa; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-    }
-    break;
-
-    case 2: {
-      double cb = cos(varPos[2]);
-      double sb = sin(varPos[2]);
-
-      trf(0,0) =  sb;  trf(0,1) =  0; trf(0,2) =  cb; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) = -cb;  trf(2,1) =  0; trf(2,2) =  sb; trf(2,3) = 0;
-    }
-    break;
-
-    case 3: {
-      double cc = cos(varPos[3]);
-      double sc = sin(varPos[3]);
-
-      trf(0,0) = 0;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) =  sc; trf(1,2) = -cc; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) =  cc; trf(2,2) =  sc; trf(2,3) = 0;
-    }
-    break;
-
-    case 4:
-      trf(0,0) = 0;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 0;
-    break;
+    case 0: slideVarTrf<2>(varPos[0],1.0,kind,trf); break;
+    case 1: rotVarTrf<2>(varPos[1],kind,trf); break;
+    case 2: rotVarTrf<1>(varPos[2],kind,trf); break;
+    case 3: rotVarTrf<0>(varPos[3],kind,trf); break;
+    case 4: slideVarTrf<2>(varPos[4],1.0,kind,trf); break;
   }
 }
 
@@ -28,7 +28,7 @@ AbstractJoint *JntBallSlide::clone(Grip& newGrip) const
 //---------------------------------------------------------------------------
 
 JntBallSlide::JntBallSlide(Grip& grp, const wchar_t *name)
-: AbstractJoint(grp,name,4)
+: JntKernel<JntBallSlide>(grp,name,4)
 {
   isAngular[0] = true;
   isAngular[1] = true;
@@ -39,192 +39,26 @@ JntBallSlide::JntBallSlide(Grip& grp, const wchar_t *name)
 //---------------------------------------------------------------------------
 
 JntBallSlide::JntBallSlide(Grip& grp, const JntBallSlide& cp)
-: AbstractJoint(grp,cp)
+: JntKernel<JntBallSlide>(grp,cp)
 {
 }
 
 //---------------------------------------------------------------------------
 
-void JntBallSlide::getVarTrf(int idx, Trf3& trf) const
+void JntBallSlide::varTrfKernel(int idx, int kind, Trf3& trf) const
 {
-  trf.init();
-  trf.isDerivative = false;
-
-  switch (idx) {
-    case 0: {
-      double ca = cos(varPos[0]);
-      double sa = sin(varPos[0]);
-
-      trf(0,0) =  ca;  trf(0,1) = sa; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = -sa;  trf(1,1) = ca; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) =   0;  trf(2,1) =  0; trf(2,2) = 1; trf(2,3) = 0;
-    }
-    break;
-
-    case 1: {
-      double cb = cos(varPos[1]);
-      double sb = sin(varPos[1]);
-
-      trf(0,0) =  cb;  trf(0,1) =  0; trf(0,2) = -sb; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) =  1; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) =  sb;  trf(2,1) =  0; trf(2,2) =  cb; trf(2,3) = 0;
-    }
-    break;
-
-    case 2: {
-      double cc = cos(varPos[2]);
-      double sc = sin(varPos[2]);
-
-      trf(0,0) = 1;  trf(0,1) =   0; trf(0,2) =  0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) =  cc; trf(1,2) = sc; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = -sc; trf(2,2) = cc; trf(2,3) = 0;
-    }
-    break;
-
-    case 3:
-      trf(0,0) = 1;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 1; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 1; trf(2,3) = varPos[3];
-    break;
-  }
-}
-
-//---------------------------------------------------------------------------
-
-void JntBallSlide::getVarDerTrf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = false;
-
-  switch (idx) {
-    case 0: {
-      double ca = cos(varPos[0]);
-      double sa = sin(varPos[0]);
-
-      trf(0,0) = -sa;  trf(0,1) =  ca; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = -ca;  trf(1,1) = -sa; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-    }
-    break;
-
-    case 1: {
-      double cb = cos(varPos[1]);
-      double sb = sin(varPos[1]);
-
-      trf(0,0) = -sb;  trf(0,1) =  0; trf(0,2) = -cb; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) =  cb;  trf(2,1) =  0; trf(2,2) = -sb; trf(2,3) = 0;
-    }
-    break;
-
-    case 2: {
-      double cc = cos(varPos[2]);
-      double sc = sin(varPos[2]);
-
-      trf(0,0) = 0;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = -sc; trf(1,2) =  cc; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = -cc; trf(2,2) = -sc; trf(2,3) = 0;
-    }
-    break;
-
-    case 3:
-      trf(0,0) = 0;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 1;
-    break;
-  }
-}
-
-//---------------------------------------------------------------------------
-
-void JntBallSlide::getVarDer2Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = false;
-
   switch (idx) {
-    case 0: {
-      double ca = cos(varPos[0]);
-      double sa = sin(varPos[0]);
-
-      trf(0,0) = -ca;  trf(0,1) = -sa; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) =  sa;  trf(1,1) = -ca; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-    }
-    break;
-
-    case 1: {
-      double cb = cos(varPos[1]);
-      double sb = sin(varPos[1]);
-
-      trf(0,0) = -cb;  trf(0,1) =  0; trf(0,2) =  sb; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) = -sb;  trf(2,1) =  0; trf(2,2) = -cb; trf(2,3) = 0;
-    }
-    break;
-
-    case 2: {
-      double cc = cos(varPos[2]);
-      double sc = sin(varPos[2]);
-
-      trf(0,0) = 0;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = -cc; trf(1,2) = -sc; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) =  sc; trf(2,2) = -cc; trf(2,3) = 0;
-    }
-    break;
-
-    case 3:
-      trf(0,0) = 0;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 0;
-    break;
+    case 0: rotVarTrf<2>(varPos[0],kind,trf); break;
+    case 1: rotVarTrf<1>(varPos[1],kind,trf); break;
+    case 2: rotVarTrf<0>(varPos[2],kind,trf); break;
+    case 3: slideVarTrf<2>(varPos[3],1.0,kind,trf); break;
   }
-}
 
-//---------------------------------------------------------------------------
-
-void JntBallSlide::getVarDer3Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = false;
-
-  switch (idx) {
-    case 0: {
-      double ca = cos(varPos[0]);
-      double sa = sin(varPos[0]);
-
-      trf(0,0) =  sa;  trf(0,1) = -ca; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) =  ca;  trf(1,1) =  sa; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-    }
-    break;
-
-    case 1: {
-      double cb = cos(varPos[1]);
-      double sb = sin(varPos[1]);
-
-      trf(0,0) =  sb;  trf(0,1) =  0; trf(0,2) =  cb; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) = -cb;  trf(2,1) =  0; trf(2,2) =  sb; trf(2,3) = 0;
-    }
-    break;
-
-    case 2: {
-      double cc = cos(varPos[2]);
-      double sc = sin(varPos[2]);
-
-      trf(0,0) = 0;  trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) =  sc; trf(1,2) = -cc; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) =  cc; trf(2,2) =  sc; trf(2,3) = 0;
-    }
-    break;
-
-    case 3:
-      trf(0,0) = 0;  trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0;  trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0;  trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 0;
-    break;
-  }
+  // Before the kernels this joint returned its derivative trfs with
+  // isDerivative = false, unlike the other joints. Kept, so the results
+  // stay identical:
+  if (kind == DerTrf || kind == Der2Trf || kind == Der3Trf)
+    trf.isDerivative = false;
 }
 
 //---------------------------------------------------------------------------
@@ -28,7 +28,7 @@ AbstractJoint *JntCross::clone(Grip& newGrip) const
 //---------------------------------------------------------------------------
 
 JntCross::JntCross(Grip& grp, const wchar_t *name)
-: AbstractJoint(grp,name,2)
+: JntKernel<JntCross>(grp,name,2)
 {
   isAngular[0] = true;
   isAngular[1] = true;
@@ -37,107 +37,17 @@ JntCross::JntCross(Grip& grp, const wchar_t *name)
 //---------------------------------------------------------------------------
 
 JntCross::JntCross(Grip& grp, const JntCross& cp)
-: AbstractJoint(grp,cp)
+: JntKernel<JntCross>(grp,cp)
 {
 }
 
 //---------------------------------------------------------------------------
 
-void JntCross::getVarTrf(int idx, Trf3& trf) const
+void JntCross::varTrfKernel(int idx, int kind, Trf3& trf) const
 {
-  trf.init();
-  trf.isDerivative = false;
-
-  if (idx == 0) {
-    double ca = cos(varPos[0]);
-    double sa = sin(varPos[0]);
-
-    trf(0,0) =  ca;  trf(0,1) = sa; trf(0,2) = 0; trf(0,3) = 0;
-    trf(1,0) = -sa;  trf(1,1) = ca; trf(1,2) = 0; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =  0; trf(2,2) = 1; trf(2,3) = 0;
-  }
-  else if (idx == 1) {
-    double cb = cos(varPos[1]);
-    double sb = sin(varPos[1]);
-
-    trf(0,0) =  cb;  trf(0,1) =  0; trf(0,2) = -sb; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  1; trf(1,2) =   0; trf(1,3) = 0;
-    trf(2,0) =  sb;  trf(2,1) =  0; trf(2,2) =  cb; trf(2,3) = 0;
-  }
-}
-
-//---------------------------------------------------------------------------
-
-void JntCross::getVarDerTrf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx == 0) {
-    double ca = cos(varPos[0]);
-    double sa = sin(varPos[0]);
-
-    trf(0,0) = -sa;  trf(0,1) =  ca; trf(0,2) = 0; trf(0,3) = 0;
-    trf(1,0) = -ca;  trf(1,1) = -sa; trf(1,2) = 0; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-  }
-  else if (idx == 1) {
-    double cb = cos(varPos[1]);
-    double sb = sin(varPos[1]);
-
-    trf(0,0) = -sb;  trf(0,1) =  0; trf(0,2) = -cb; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-    trf(2,0) =  cb;  trf(2,1) =  0; trf(2,2) = -sb; trf(2,3) = 0;
-  }
-}
-
-//---------------------------------------------------------------------------
-
-void JntCross::getVarDer2Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx == 0) {
-    double ca = cos(varPos[0]);
-    double sa = sin(varPos[0]);
-
-    trf(0,0) = -ca;  trf(0,1) = -sa; trf(0,2) = 0; trf(0,3) = 0;
-    trf(1,0) =  sa;  trf(1,1) = -ca; trf(1,2) = 0; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-  }
-  else if (idx == 1) {
-    double cb = cos(varPos[1]);
-    double sb = sin(varPos[1]);
-
-    trf(0,0) = -cb;  trf(0,1) =  0; trf(0,2) =  sb; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-    trf(2,0) = -sb;  trf(2,1) =  0; trf(2,2) = -cb; trf(2,3) = 0;
-  }
-}
-
-//---------------------------------------------------------------------------
-
-void JntCross::getVarDer3Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx == 0) {
-    double ca = cos(varPos[0]);
-    double sa = sin(varPos[0]);
-
-    trf(0,0) =  sa;  trf(0,1) = -ca; trf(0,2) = 0; trf(0,3) = 0;
-    trf(1,0) =  ca;  trf(1,1) =  sa; trf(1,2) = 0; trf(1,3) = 0;
-    trf(2,0) =   0;  trf(2,1) =   0; trf(2,2) = 0; trf(2,3) = 0;
-  }
-  else if (idx == 1) {
-    double cb = cos(varPos[1]);
-    double sb = sin(varPos[1]);
-
-    trf(0,0) =  sb;  trf(0,1) =  0; trf(0,2) =  cb; trf(0,3) = 0;
-    trf(1,0) =   0;  trf(1,1) =  0; trf(1,2) =   0; trf(1,3) = 0;
-    trf(2,0) = -cb;  trf(2,1) =  0; trf(2,2) =  sb; trf(2,3) = 0;
+  switch (idx) {
+    case 0: rotVarTrf<2>(varPos[0],kind,trf); break;
+    case 1: rotVarTrf<1>(varPos[1],kind,trf); break;
   }
 }
 
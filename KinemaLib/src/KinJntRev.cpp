@@ -28,7 +28,7 @@ AbstractJoint *JntRev::clone(Grip& newGrip) const
 //---------------------------------------------------------------------------
 
 JntRev::JntRev(Grip& grp, const wchar_t *name)
-: AbstractJoint(grp,name,1)
+: JntKernel<JntRev>(grp,name,1)
 {
   isAngular[0] = true;
 }
@@ -36,72 +36,15 @@ JntRev::JntRev(Grip& grp, const wchar_t *name)
 //---------------------------------------------------------------------------
 
 JntRev::JntRev(Grip& grp, const JntRev& cp)
-: AbstractJoint(grp,cp)
+: JntKernel<JntRev>(grp,cp)
 {
 }
 
 //---------------------------------------------------------------------------
 
-void JntRev::getVarTrf(int idx, Trf3& trf) const
+void JntRev::varTrfKernel(int idx, int kind, Trf3& trf) const
 {
-  trf.init();
-  trf.isDerivative = false;
-
-  if (idx != 0) return;
-
-  double c = cos(varPos[0]);
-  double s = sin(varPos[0]);
-
-  trf(0,0) =  c; trf(0,1) = s;
-  trf(1,0) = -s; trf(1,1) = c;
-}
-
-//---------------------------------------------------------------------------
-
-void JntRev::getVarDerTrf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx != 0) return;
-
-  double c = cos(varPos[0]);
-  double s = sin(varPos[0]);
-
-  trf(0,0) = -s; trf(0,1) =  c;
-  trf(1,0) = -c; trf(1,1) = -s;
-}
-
-//---------------------------------------------------------------------------
-
-void JntRev::getVarDer2Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx != 0) return;
-
-  double c = cos(varPos[0]);
-  double s = sin(varPos[0]);
-
-  trf(0,0) = -c; trf(0,1) = -s;
-  trf(1,0) =  s; trf(1,1) = -c;
-}
-
-//---------------------------------------------------------------------------
-
-void JntRev::getVarDer3Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx != 0) return;
-
-  double c = cos(varPos[0]);
-  double s = sin(varPos[0]);
-
-  trf(0,0) =  s; trf(0,1) = -c;
-  trf(1,0) =  c; trf(1,1) =  s;
+  if (idx == 0) rotVarTrf<2>(varPos[0],kind,trf);
 }
 
 //---------------------------------------------------------------------------
@@ -28,7 +28,7 @@ AbstractJoint *JntRevSlide::clone(Grip& newGrip) const
 //---------------------------------------------------------------------------
 
 JntRevSlide::JntRevSlide(Grip& grp, const wchar_t *name)
-: AbstractJoint(grp,name,2)
+: JntKernel<JntRevSlide>(grp,name,2)
 {
   isAngular[0] = true;
   isAngular[1] = false;
@@ -37,73 +37,17 @@ JntRevSlide::JntRevSlide(Grip& grp, const wchar_t *name)
 //---------------------------------------------------------------------------
 
 JntRevSlide::JntRevSlide(Grip& grp, const JntRevSlide& cp)
-: AbstractJoint(grp,cp)
+: JntKernel<JntRevSlide>(grp,cp)
 {
 }
 
 //---------------------------------------------------------------------------
 
-void JntRevSlide::getVarTrf(int idx, Trf3& trf) const
+void JntRevSlide::varTrfKernel(int idx, int kind, Trf3& trf) const
 {
-  trf.init();
-  trf.isDerivative = false;
-
-  if (idx == 0) {
-    double c = cos(varPos[0]);
-    double s = sin(varPos[0]);
-
-    trf(0,0) =  c; trf(0,1) = s;
-    trf(1,0) = -s; trf(1,1) = c;
-  }
-  else if (idx == 1) trf(2,3) = -varPos[1];
-}
-
-//---------------------------------------------------------------------------
-
-void JntRevSlide::getVarDerTrf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx == 0) {
-    double c = cos(varPos[0]);
-    double s = sin(varPos[0]);
-
-    trf(0,0) = -s; trf(0,1) =  c;
-    trf(1,0) = -c; trf(1,1) = -s;
-  }
-  else if (idx == 1) trf(2,3) = -1.0;
-}
-
-//---------------------------------------------------------------------------
-
-void JntRevSlide::getVarDer2Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx == 0) {
-    double c = cos(varPos[0]);
-    double s = sin(varPos[0]);
-
-    trf(0,0) = -c; trf(0,1) = -s;
-    trf(1,0) =  s; trf(1,1) = -c;
-  }
-}
-
-//---------------------------------------------------------------------------
-
-void JntRevSlide::getVarDer3Trf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx == 0) {
-    double c = cos(varPos[0]);
-    double s = sin(varPos[0]);
-
-    trf(0,0) =  s; trf(0,1) = -c;
-    trf(1,0) =  c; trf(1,1) =  s;
+  switch (idx) {
+    case 0: rotVarTrf<2>(varPos[0],kind,trf); break;
+    case 1: slideVarTrf<2>(varPos[1],-1.0,kind,trf); break;
   }
 }
 
@@ -25,7 +25,7 @@ AbstractJoint *JntSlide::clone(Grip& newGrip) const
 //-------------------------------------------------------------------------------
 
 JntSlide::JntSlide(Grip& grp, const wchar_t *name)
-: AbstractJoint(grp,name,1)
+: JntKernel<JntSlide>(grp,name,1)
 {
   isAngular[0] = false;
 }
@@ -33,48 +33,15 @@ JntSlide::JntSlide(Grip& grp, const wchar_t *name)
 //-------------------------------------------------------------------------------
 
 JntSlide::JntSlide(Grip& grp, const JntSlide& cp)
-: AbstractJoint(grp,cp)
+: JntKernel<JntSlide>(grp,cp)
 {
 }
 
 //-------------------------------------------------------------------------------
 
-void JntSlide::getVarTrf(int idx, Trf3& trf) const
+void JntSlide::varTrfKernel(int idx, int kind, Trf3& trf) const
 {
-  trf.init();
-  trf.isDerivative = false;
-
-  if (idx != 0) return;
-
-  trf(2,3) = -varPos[0];
-}
-
-//-------------------------------------------------------------------------------
-
-void JntSlide::getVarDerTrf(int idx, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-
-  if (idx != 0) return;
-
-  trf(2,3) = -1.0;
-}
-
-//-------------------------------------------------------------------------------
-
-void JntSlide::getVarDer2Trf(int /*idx*/, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
-}
-
-//-------------------------------------------------------------------------------
-
-void JntSlide::getVarDer3Trf(int /*idx*/, Trf3& trf) const
-{
-  trf.zero();
-  trf.isDerivative = true;
+  if (idx == 0) slideVarTrf<2>(varPos[0],-1.0,kind,trf);
 }
 
 //-------------------------------------------------------------------------------
@@ -14,6 +14,7 @@
 #include "Exceptions.h"
 
 #include <cmath>
+#include <limits>
 
 using namespace Ino;
 
@@ -23,8 +24,12 @@ namespace InoKin {
 
 JntTrack::JntTrack(Grip& grp, const wchar_t *name,
                          const AbstractTrack& track, double wheelRad)
-: AbstractJoint(grp,name,4), rad(fabs(wheelRad)), trk(&track)
+: JntKernel<JntTrack>(grp,name,4), rad(fabs(wheelRad)), trk(&track),
+  trkCursor(-1)
 {
+  clearTrackCache();
+  setDependency(&trk->getModCount());
+
   isAngular[0] = false;
   isAngular[1] = true;
   isAngular[2] = true;
@@ -34,8 +39,11 @@ JntTrack::JntTrack(Grip& grp, const wchar_t *name,
 //---------------------------------------------------------------------------
 
 JntTrack::JntTrack(Grip& grp, const JntTrack& cp)
-: AbstractJoint(grp,cp), rad(cp.rad), trk(cp.trk)
+: JntKernel<JntTrack>(grp,cp), rad(cp.rad), trk(cp.trk),
+  trkCursor(cp.trkCursor)
 {
+  clearTrackCache();
+
 }
 
 //---------------------------------------------------------------------------
@@ -124,271 +132,214 @@ static void rightAccTrf(const Vec3& v, const Vec3& a, const Vec3& j,
 
 //---------------------------------------------------------------------------
 
-void JntTrack::getVarTrf(int idx, Trf3& trf) const
+// The track frame at smp, x: track x-direction, y: track direction
+
+static void trackFrame(const TrackSample& smp, Trf3& trf)
 {
   trf.init();
   trf.isDerivative = false;
 
-  switch (idx) {
-  case 0: { // position matrix
-      Vec3 p, v;
-      trk->getPointAndDir(varPos[0],p,v);
+  const Vec3& p = smp.pnt;
+  const Vec3& v = smp.dir;
+  const Vec3& n = smp.xDir;
 
-      Vec3 n,nd;
-      trk->getXDir(varPos[0],n,nd);
+  trf(0,0) = n.x; trf(0,1) = v.x; trf(0,2) = n.y*v.z - n.z*v.y;
+  trf(1,0) = n.y; trf(1,1) = v.y; trf(1,2) = n.z*v.x - n.x*v.z;
+  trf(2,0) = n.z; trf(2,1) = v.z; trf(2,2) = n.x*v.y - n.y*v.x;
 
-      trf(0,0) = n.x; trf(0,1) = v.x; trf(0,2) = n.y*v.z - n.z*v.y;
-      trf(1,0) = n.y; trf(1,1) = v.y; trf(1,2) = n.z*v.x - n.x*v.z;
-      trf(2,0) = n.z; trf(2,1) = v.z; trf(2,2) = n.x*v.y - n.y*v.x;
+  trf(0,3) = p.x; trf(1,3) = p.y; trf(2,3) = p.z;
+}
 
-      trf(0,3) = p.x; trf(1,3) = p.y; trf(2,3) = p.z;
+//---------------------------------------------------------------------------
+// The track cache: re-evaluated only if varPos[0] moved, the track
+// changed, or if the jerk is wanted and not present
 
-      trf.invert();
-    }
-    break;
+void JntTrack::updateTrack(int maxOrder) const
+{
+  unsigned modCnt = trk->getModCount();
 
-  case 1: { // camber angle
-      double ca = cos(varPos[1]);
-      double sa = sin(varPos[1]);
+  if (trkKey == varPos[0] && trkModKey == modCnt &&
+                                    trkSmp.order >= maxOrder) return;
 
-      trf(0,0) = ca;  trf(0,1) = 0; trf(0,2) = -sa; trf(0,3) = 0;
-      trf(1,0) =  0;  trf(1,1) = 1; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) = sa;  trf(2,1) = 0; trf(2,2) =  ca; trf(2,3) = 0;
-    }
-    break;
+  trk->evaluate(varPos[0],maxOrder,trkSmp,trkCursor);
 
-  case 2: { // misalignment
-      double cb = cos(varPos[2]);
-      double sb = sin(varPos[2]);
+  trackFrame(trkSmp,trkFrame);
 
-      trf(0,0) = 1; trf(0,1) =   0; trf(0,2) =  0; trf(0,3) = 0;
-      trf(1,0) = 0; trf(1,1) =  cb; trf(1,2) = sb; trf(1,3) = 0;
-      trf(2,0) = 0; trf(2,1) = -sb; trf(2,2) = cb; trf(2,3) = 0;
-    }
-    break;
+  trkInvFrame = trkFrame;
+  trkInvFrame.invert();
 
-  case 3: { // Wheel radius and sideways slide
-      trf(0,0) = 1; trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = -rad-trk->getPipeRadius();
-      trf(1,0) = 0; trf(1,1) = 1; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0; trf(2,1) = 0; trf(2,2) = 1; trf(2,3) = -varPos[3];
-    }
-    break;
-  }
+  trkDerValid = false;
+  trkKey = varPos[0];
+  trkModKey = modCnt;
 }
 
 //---------------------------------------------------------------------------
 
-void JntTrack::getVarDerTrf(int idx, Trf3& trf) const
+void JntTrack::clearTrackCache()
 {
-  trf.zero();
-  trf.isDerivative = true;
+  trkKey = std::numeric_limits<double>::quiet_NaN();
+  trkModKey = 0;
+  trkSmp.order = -1;
+  trkDerValid = false;
+}
 
-  switch (idx) {
-  case 0: { // position matrix
-      Vec3 v, a;
-      trk->getDir(varPos[0],v);
-      trk->getAcc(varPos[0],a);
+//---------------------------------------------------------------------------
 
-      Vec3 n,nd;
-      trk->getXDir(varPos[0],n,nd);
+const Trf3& JntTrack::getTrackDerTrf() const
+{
+  if (!trkDerValid) {
+    getTrackDerTrf(trkDerTrf);
+    trkDerValid = true;
+  }
 
-      trf(0,0) = nd.x; trf(0,1) = a.x; trf(0,2) = nd.y*v.z - nd.z*v.y + n.y*a.z - n.z*a.y;
-      trf(1,0) = nd.y; trf(1,1) = a.y; trf(1,2) = nd.z*v.x - nd.x*v.z + n.z*a.x - n.x*a.z;
-      trf(2,0) = nd.z; trf(2,1) = a.z; trf(2,2) = nd.x*v.y - nd.y*v.x + n.x*a.y - n.y*a.x;
+  return trkDerTrf;
+}
 
-      trf(0,3) = v.x; trf(1,3) = v.y; trf(2,3) = v.z;
+//---------------------------------------------------------------------------
 
-      Trf3 lTrf; getVarTrf(idx,lTrf);
+void JntTrack::getTrackDerTrf(Trf3& trf) const
+{
+  trf.zero();
+  trf.isDerivative = true;
 
-      trf *= lTrf;
-      trf.preMultWith(lTrf);
-      trf *= -1.0;
-    }
-    break;
+  const TrackSample& smp = trkSmp;
 
-  case 1: { // camber angle
-      double ca = cos(varPos[1]);
-      double sa = sin(varPos[1]);
+  const Vec3& v = smp.dir;
+  const Vec3& a = smp.acc;
 
-      trf(0,0) = -sa;  trf(0,1) = 0; trf(0,2) = -ca; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) = 0; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) =  ca;  trf(2,1) = 0; trf(2,2) = -sa; trf(2,3) = 0;
-    }
-    break;
+  const Vec3& n  = smp.xDir;
+  const Vec3& nd = smp.xDer;
 
-  case 2: { // misalignment
-      double cb = cos(varPos[2]);
-      double sb = sin(varPos[2]);
+  trf(0,0) = nd.x; trf(0,1) = a.x; trf(0,2) = nd.y*v.z - nd.z*v.y + n.y*a.z - n.z*a.y;
+  trf(1,0) = nd.y; trf(1,1) = a.y; trf(1,2) = nd.z*v.x - nd.x*v.z + n.z*a.x - n.x*a.z;
+  trf(2,0) = nd.z; trf(2,1) = a.z; trf(2,2) = nd.x*v.y - nd.y*v.x + n.x*a.y - n.y*a.x;
 
-      trf(0,0) = 0; trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-      trf(1,0) = 0; trf(1,1) = -sb; trf(1,2) =  cb; trf(1,3) = 0;
-      trf(2,0) = 0; trf(2,1) = -cb; trf(2,2) = -sb; trf(2,3) = 0;
-    }
-    break;
+  trf(0,3) = v.x; trf(1,3) = v.y; trf(2,3) = v.z;
 
-  case 3: { // Wheel radius and sideways slide
-      trf(0,0) = 0; trf(0,1) = 0; trf(0,2) = 0; trf(0,3) =  0;
-      trf(1,0) = 0; trf(1,1) = 0; trf(1,2) = 0; trf(1,3) =  0;
-      trf(2,0) = 0; trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = -1;
-    }
-    break;
-  }
+  trf *= trkInvFrame;
+  trf.preMultWith(trkInvFrame);
+  trf *= -1.0;
 }
 
 //---------------------------------------------------------------------------
 // ATTN: this one is not functional!!
 
-void JntTrack::getVarDer2Trf(int idx, Trf3& trf) const
+void JntTrack::getTrackDer2Trf(Trf3& trf) const
 {
   trf.zero();
   trf.isDerivative = true;
 
-  switch (idx) {
-  case 0: { // position matrix
-//      throw OperationNotSupportedException("JntTrack::getVarDer2Trf");
-
-      Vec3 v, a, j;
-      trk->getDir(varPos[0],v);
-      trk->getAcc(varPos[0],a);
-      trk->getJerk(varPos[0],j);
+  const TrackSample& smp = trkSmp;
 
-      Trf3 lTrf,  rTrf;  leftVarTrf(v,lTrf);      rightVarTrf(v,rTrf);
-      Trf3 ldTrf, rdTrf; leftDerTrf(v,a,ldTrf);   rightDerTrf(v,a,rdTrf);
-      Trf3 laTrf, raTrf; leftAccTrf(v,a,j,laTrf); rightAccTrf(v,a,j,raTrf);
-
-      trf = rTrf; trf.preMultWith(laTrf);
-      rdTrf.preMultWith(ldTrf);
-      rdTrf *= 2.0;
-
-      trf += rdTrf;
-
-      raTrf.preMultWith(lTrf);
+//      throw OperationNotSupportedException("JntTrack::getVarDer2Trf");
 
-      trf += raTrf;
+  const Vec3& v = smp.dir;
+  const Vec3& a = smp.acc;
+  const Vec3& j = smp.jerk;
 
-      trf(0,3) = a.x; trf(1,3) = a.y; trf(2,3) = a.z;
+  Trf3 lTrf,  rTrf;  leftVarTrf(v,lTrf);      rightVarTrf(v,rTrf);
+  Trf3 ldTrf, rdTrf; leftDerTrf(v,a,ldTrf);   rightDerTrf(v,a,rdTrf);
+  Trf3 laTrf, raTrf; leftAccTrf(v,a,j,laTrf); rightAccTrf(v,a,j,raTrf);
 
-      // Invert:
-      getVarTrf(idx,lTrf);
-      getVarDerTrf(idx,ldTrf);
+  trf = rTrf; trf.preMultWith(laTrf);
+  rdTrf.preMultWith(ldTrf);
+  rdTrf *= 2.0;
 
-      trf *= lTrf;
-      trf.preMultWith(lTrf);
-      trf *= -1.0;
+  trf += rdTrf;
 
-      lTrf.invert();
-      lTrf *= ldTrf;
-      lTrf.preMultWith(ldTrf);
-      lTrf *= 2.0;
+  raTrf.preMultWith(lTrf);
 
-      trf += lTrf;
-    }
-    break;
+  trf += raTrf;
 
-  case 1: { // camber angle
-      double ca = cos(varPos[1]);
-      double sa = sin(varPos[1]);
+  trf(0,3) = a.x; trf(1,3) = a.y; trf(2,3) = a.z;
 
-      trf(0,0) = -ca;  trf(0,1) = 0; trf(0,2) =  sa; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) = 0; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) = -sa;  trf(2,1) = 0; trf(2,2) = -ca; trf(2,3) = 0;
-    }
-    break;
+  // Invert:
+  trf *= trkInvFrame;
+  trf.preMultWith(trkInvFrame);
+  trf *= -1.0;
 
-  case 2: { // misalignment
-      double cb = cos(varPos[2]);
-      double sb = sin(varPos[2]);
+  const Trf3& dTrf = getTrackDerTrf();
 
-      trf(0,0) = 0; trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-      trf(1,0) = 0; trf(1,1) = -cb; trf(1,2) = -sb; trf(1,3) = 0;
-      trf(2,0) = 0; trf(2,1) =  sb; trf(2,2) = -cb; trf(2,3) = 0;
-    }
-    break;
+  lTrf = trkFrame;
+  lTrf *= dTrf;
+  lTrf.preMultWith(dTrf);
+  lTrf *= 2.0;
 
-  case 3: { // Wheel radius and sideways slide
-      trf(0,0) = 0; trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0; trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0; trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 0;
-    }
-    break;
-  }
+  trf += lTrf;
 }
 
 //---------------------------------------------------------------------------
 // ATTN: this one is not functional!!
 
-void JntTrack::getVarDer3Trf(int idx, Trf3& trf) const
+void JntTrack::getTrackDer3Trf(Trf3& trf) const
 {
   trf.zero();
   trf.isDerivative = true;
 
-  switch (idx) {
-  case 0: { // position matrix
+  const TrackSample& smp = trkSmp;
+
 //      throw OperationNotSupportedException("JntTrack::getVarDer3Trf");
 
-      Vec3 v, a, j;
-      trk->getDir(varPos[0],v);
-      trk->getAcc(varPos[0],a);
-      trk->getJerk(varPos[0],j);
+  const Vec3& v = smp.dir;
+  const Vec3& a = smp.acc;
+  const Vec3& j = smp.jerk;
 
-      Trf3 ltrf,  rtrf;  leftVarTrf(v,ltrf);      rightVarTrf(v,rtrf);
-      Trf3 ldtrf, rdtrf; leftDerTrf(v,a,ldtrf);   rightDerTrf(v,a,rdtrf);
-      Trf3 latrf, ratrf; leftAccTrf(v,a,j,latrf); rightAccTrf(v,a,j,ratrf);
+  Trf3 ltrf,  rtrf;  leftVarTrf(v,ltrf);      rightVarTrf(v,rtrf);
+  Trf3 ldtrf, rdtrf; leftDerTrf(v,a,ldtrf);   rightDerTrf(v,a,rdtrf);
+  Trf3 latrf, ratrf; leftAccTrf(v,a,j,latrf); rightAccTrf(v,a,j,ratrf);
 
-      trf = rtrf; trf.preMultWith(latrf);
-      rdtrf.preMultWith(ldtrf);
-      rdtrf *= 2.0;
+  trf = rtrf; trf.preMultWith(latrf);
+  rdtrf.preMultWith(ldtrf);
+  rdtrf *= 2.0;
 
-      trf += rdtrf;
+  trf += rdtrf;
 
-      ratrf.preMultWith(ltrf);
+  ratrf.preMultWith(ltrf);
 
-      trf += ratrf;
+  trf += ratrf;
 
-      trf(0,3) = a.x; trf(1,3) = a.y; trf(2,3) = a.z;
+  trf(0,3) = a.x; trf(1,3) = a.y; trf(2,3) = a.z;
 
-      // Invert:
-      getVarTrf(idx,ltrf);
-      getVarDerTrf(idx,ldtrf);
+  // Invert:
+  trf *= trkInvFrame;
+  trf.preMultWith(trkInvFrame);
+  trf *= -1.0;
 
-      trf *= ltrf;
-      trf.preMultWith(ltrf);
-      trf *= -1.0;
+  const Trf3& dTrf = getTrackDerTrf();
 
-      ltrf.invert();
-      ltrf *= ldtrf;
-      ltrf.preMultWith(ldtrf);
-      ltrf *= 2.0;
+  ltrf = trkFrame;
+  ltrf *= dTrf;
+  ltrf.preMultWith(dTrf);
+  ltrf *= 2.0;
 
-      trf += ltrf;
-    }
-    break;
+  trf += ltrf;
+}
 
-  case 1: { // camber angle
-      double ca = cos(varPos[1]);
-      double sa = sin(varPos[1]);
+//---------------------------------------------------------------------------
 
-      trf(0,0) =  sa;  trf(0,1) = 0; trf(0,2) =  ca; trf(0,3) = 0;
-      trf(1,0) =   0;  trf(1,1) = 0; trf(1,2) =   0; trf(1,3) = 0;
-      trf(2,0) = -ca;  trf(2,1) = 0; trf(2,2) =  sa; trf(2,3) = 0;
+void JntTrack::varTrfKernel(int idx, int kind, Trf3& trf) const
+{
+  switch (idx) {
+  case 0: // position matrix
+    updateTrack(kind == Der2Trf || kind == Der3Trf ? 3 : 2);
+
+    switch (kind) {
+      case PosTrf:    trf = trkInvFrame; break;
+      case DerTrf:    trf = getTrackDerTrf(); break;
+      case Der2Trf:   getTrackDer2Trf(trf); break;
+      case Der3Trf:   getTrackDer3Trf(trf); break;
+      case InvPosTrf: trf = trkFrame; break;
     }
     break;
 
-  case 2: { // misalignment
-      double cb = cos(varPos[2]);
-      double sb = sin(varPos[2]);
+  case 1: rotVarTrf<1>(varPos[1],kind,trf); break; // camber angle
+  case 2: rotVarTrf<0>(varPos[2],kind,trf); break; // misalignment
 
-      trf(0,0) = 0; trf(0,1) =   0; trf(0,2) =   0; trf(0,3) = 0;
-      trf(1,0) = 0; trf(1,1) =  sb; trf(1,2) = -cb; trf(1,3) = 0;
-      trf(2,0) = 0; trf(2,1) =  cb; trf(2,2) =  sb; trf(2,3) = 0;
-    }
-    break;
+  case 3: // Wheel radius and sideways slide
+    slideVarTrf<2>(varPos[3],-1.0,kind,trf);
 
-  case 3: { // Wheel radius and sideways slide
-      trf(0,0) = 0; trf(0,1) = 0; trf(0,2) = 0; trf(0,3) = 0;
-      trf(1,0) = 0; trf(1,1) = 0; trf(1,2) = 0; trf(1,3) = 0;
-      trf(2,0) = 0; trf(2,1) = 0; trf(2,2) = 0; trf(2,3) = 0;
-    }
+    if (kind == PosTrf) trf(0,3) = -rad-trk->getPipeRadius();
+    else if (kind == InvPosTrf) trf(0,3) = rad+trk->getPipeRadius();
     break;
   }
 }
@@ -406,12 +357,12 @@ void JntTrack::initVarsFromPos(bool fixedAlso)
 
   if (fixedAlso || !getFixed(0)) varPos[0] = trk->findPoint(p);
 
-  Vec3 v;
-  trk->getPoint(varPos[0],p);
-  trk->getDir(varPos[0],v);
+  TrackSample smp;
+  trk->evaluate(varPos[0],2,smp,trkCursor);
 
-  Vec3 n,nd;
-  trk->getXDir(varPos[0],n,nd);
+  p = smp.pnt;
+  const Vec3& v = smp.dir;
+  const Vec3& n = smp.xDir;
 
   Trf3 rTrf;
 
@@ -440,6 +391,9 @@ void JntTrack::initVarsFromPos(bool fixedAlso)
 void JntTrack::replaceTrack(const AbstractTrack &newTrk)
 {
   trk = &newTrk;
+  trkCursor = -1;
+  clearTrackCache();
+  setDependency(&trk->getModCount());
 }
 
 } // namespace
@@ -18,6 +18,8 @@
 #include "Trf.h"
 #include "Exceptions.h"
 
+#include <unordered_map>
+
 //---------------------------------------------------------------------------
 
 using namespace Ino;
@@ -38,6 +40,7 @@ void Model::version(char& major, char& minor, char& release)
 Model::Model(const wchar_t *name)
 : mdlName(dupStr(name)),
   modified(true),
+  posVersion(0),
   offset(),
   bodyLst(*new BodyList()),
   gripLst(*new GripList()),
@@ -54,6 +57,7 @@ Model::Model(const wchar_t *name)
 Model::Model(const Model& cp, bool withSequences)
 : mdlName(NULL),
   modified(true),
+  posVersion(0),
   offset(cp.offset),
   bodyLst(*new BodyList()),
   gripLst(*new GripList()),
@@ -127,8 +131,14 @@ void Model::cloneFrom(const Model& src, bool withSequences)
   mdlName  = dupStr(src.mdlName);
   modified = true;
 
-  src.bodyLst.setIds();
-  src.gripLst.setIds();
+  // The copies are in the order of the source lists, the source itself
+  // is left as it is (no setIds()), it may be in use by other threads
+
+  std::unordered_map<const Body *, int> bodyIdx;
+  std::unordered_map<const Grip *, int> gripIdx;
+
+  src.bodyLst.getIndexMap(bodyIdx);
+  src.gripLst.getIndexMap(gripIdx);
 
   int bSz = src.bodyLst.size();
   bodyLst.ensureCapacity(bSz);
@@ -145,7 +155,7 @@ void Model::cloneFrom(const Model& src, bool withSequences)
     int sz = srcBody->gripLst.size();
 
     for (int j=0; j<sz ;++j) {
-      dstBody->gripLst.add(gripLst.byId(srcBody->gripLst[j]->getId()));
+      dstBody->gripLst.add(gripLst[gripIdx.at(srcBody->gripLst[j])]);
     }
   }
 
@@ -154,12 +164,15 @@ void Model::cloneFrom(const Model& src, bool withSequences)
     const Grip *srcGrp = src.gripLst[i];
    
     const Body *srcBody = srcGrp->body1;
-    if (srcBody) dstGrp->body1 = bodyLst.byId(srcBody->getId());
+    if (srcBody) dstGrp->body1 = bodyLst[bodyIdx.at(srcBody)];
 
     srcBody = srcGrp->body2;
-    if (srcBody) dstGrp->body2 = bodyLst.byId(srcBody->getId());
+    if (srcBody) dstGrp->body2 = bodyLst[bodyIdx.at(srcBody)];
   }
 
+  bodyLst.setIds();
+  gripLst.setIds();
+
   int tSz = src.topoLst.size();
 
   for (int i=0; i<tSz; ++i) {
@@ -442,6 +455,14 @@ void* GetTopologyModel(void* cppModel, int index)
   return mdl->getTopologyList()[index];
 }
 
+bool SolveAllTopologiesModel(void* cppModel, int maxIter, double rotTol, double posTol,
+                             int derivOrder, int threadCnt)
+{
+  InoKin::Model* mdl = (InoKin::Model*)cppModel;
+
+  return mdl->getTopologyList().solveAll(maxIter, rotTol, posTol, derivOrder, threadCnt);
+}
+
 
 // End Interface Section
 //---------------------------------------------------------------------------
@@ -27,7 +27,7 @@ Object::Object(Model& kmodel, const wchar_t *name)
 //---------------------------------------------------------------------------
 
 Object::Object(Model& kmodel, const Object& cp)
-: nam(dupStr(cp.nam)), id(cp.id), model(kmodel)
+: nam(cp.nam), id(cp.id), model(kmodel)
 {
 }
 
@@ -35,17 +35,15 @@ Object::Object(Model& kmodel, const Object& cp)
 
 Object::~Object()
 {
-  delete[] nam;
 }
 
 //---------------------------------------------------------------------------
 
 void Object::setName(const wchar_t *newName)
 {
-  if (!compareStr(nam,newName)) return;
+  if (!compareStr(nam.get(),newName)) return;
 
-  delete[] nam;
-  nam = dupStr(newName);
+  nam.reset(dupStr(newName));
 
   setModelModified();
 }
@@ -64,6 +62,13 @@ void Object::setModelModified() const
   model.setModified();
 }
 
+//---------------------------------------------------------------------------
+
+void Object::setModelPosModified() const
+{
+  model.setPosModified();
+}
+
 } // namespace
 
 //---------------------------------------------------------------------------
@@ -24,7 +24,7 @@ namespace InoKin {
 
 Probe::Probe(Body& prbBody, const wchar_t *name, const Trf3& initPos)
 : Object(prbBody.model,name),
-  pos(*new Trf3(initPos)),
+  pos(initPos),
   body(prbBody)
 {
   body.probeLst.add(this);
@@ -36,7 +36,7 @@ Probe::Probe(Body& prbBody, const wchar_t *name, const Trf3& initPos)
 
 Probe::Probe(Body& prbBody, const Probe& cp)
 : Object(prbBody.model,cp),
-  pos(* new Trf3(cp.pos)),
+  pos(cp.pos),
   body(prbBody)
 {
   body.probeLst.add(this);
@@ -54,8 +54,6 @@ Probe::~Probe()
   // TODO solve mem leak
   // body.probeLst.remove(this);
 
-  delete &pos;
-
   setModelModified();
 }
 
@@ -68,6 +68,18 @@ void Sequence::addCurrentTopoState()
   add(new State(*this, size(), 0L, topology));
 }
 
+//---------------------------------------------------------------------------
+
+void Sequence::appendStates(const Sequence& src, int fstIdx)
+{
+  int sz = src.size();
+  if (fstIdx < 0) fstIdx = 0;
+
+  ensureCapacity(size() + sz - fstIdx);
+
+  for (int i=fstIdx; i<sz; ++i) add(new State(*this,size(),*src[i]));
+}
+
 bool writeState(FILE* fd, const InoKin::State* st)
 {
   int sz = st->getVarPosSize();
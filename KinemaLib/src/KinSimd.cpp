@@ -0,0 +1,385 @@
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Kinema: Kinematic Simulation Program ---------------------------
+//---------------------------------------------------------------------------
+//-------------------- Copyright Inofor Hoek Aut BV Dec 1999-2013 -----------
+//-------------------------------------------------- C.Wolters --------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Vectorized kernels for the 6 x k loop Jacobians ----------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#include "KinSimd.h"
+
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define INOKIN_SIMD_X86
+
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define INOKIN_AVX2_FUNC
+#define INOKIN_AVX512_FUNC
+#else
+#define INOKIN_AVX2_FUNC   __attribute__((target("avx2,fma")))
+#define INOKIN_AVX512_FUNC __attribute__((target("avx512f")))
+#endif
+#endif
+
+namespace InoKin {
+
+//---------------------------------------------------------------------------
+// Scalar versions
+
+static void gram6Scalar(const double *c, int stride, int sz, double *prod)
+{
+  const double *c0 = c,          *c1 = c + stride,   *c2 = c + 2*stride;
+  const double *c3 = c + 3*stride, *c4 = c + 4*stride, *c5 = c + 5*stride;
+
+  for (int j=0; j<sz; ++j) {
+    for (int i=j; i<sz; ++i) {
+      *prod++ = c0[j]*c0[i] + c1[j]*c1[i] + c2[j]*c2[i] +
+                c3[j]*c3[i] + c4[j]*c4[i] + c5[j]*c5[i];
+    }
+  }
+}
+
+static void project6Scalar(const double *c, int stride, int fst, int cnt,
+                                              const double *v, double *out)
+{
+  c += fst;
+
+  for (int i=0; i<cnt; ++i) {
+    out[i] = c[i]*v[0] + c[stride+i]*v[1] + c[2*stride+i]*v[2] +
+             c[3*stride+i]*v[3] + c[4*stride+i]*v[4] + c[5*stride+i]*v[5];
+  }
+}
+
+static void multAdd6Scalar(const double *c, int stride, int fst, int cnt,
+                                              const double *x, double *v)
+{
+  c += fst;
+
+  for (int k=0; k<6; ++k) {
+    const double *ck = c + k*stride;
+
+    double s = 0.0;
+    for (int i=0; i<cnt; ++i) s += ck[i] * x[i];
+
+    v[k] += s;
+  }
+}
+
+#ifdef INOKIN_SIMD_X86
+
+//---------------------------------------------------------------------------
+// AVX2, four columns at a time
+
+INOKIN_AVX2_FUNC
+static void gram6Avx2(const double *c, int stride, int sz, double *prod)
+{
+  const double *c0 = c,          *c1 = c + stride,   *c2 = c + 2*stride;
+  const double *c3 = c + 3*stride, *c4 = c + 4*stride, *c5 = c + 5*stride;
+
+  for (int j=0; j<sz; ++j) {
+    __m256d a0 = _mm256_set1_pd(c0[j]), a1 = _mm256_set1_pd(c1[j]);
+    __m256d a2 = _mm256_set1_pd(c2[j]), a3 = _mm256_set1_pd(c3[j]);
+    __m256d a4 = _mm256_set1_pd(c4[j]), a5 = _mm256_set1_pd(c5[j]);
+
+    int i = j;
+
+    for (; i+4<=sz; i+=4) {
+      __m256d s = _mm256_mul_pd(a0,_mm256_loadu_pd(c0+i));
+      s = _mm256_fmadd_pd(a1,_mm256_loadu_pd(c1+i),s);
+      s = _mm256_fmadd_pd(a2,_mm256_loadu_pd(c2+i),s);
+      s = _mm256_fmadd_pd(a3,_mm256_loadu_pd(c3+i),s);
+      s = _mm256_fmadd_pd(a4,_mm256_loadu_pd(c4+i),s);
+      s = _mm256_fmadd_pd(a5,_mm256_loadu_pd(c5+i),s);
+
+      _mm256_storeu_pd(prod+(i-j),s);
+    }
+
+    for (; i<sz; ++i) {
+      prod[i-j] = c0[j]*c0[i] + c1[j]*c1[i] + c2[j]*c2[i] +
+                  c3[j]*c3[i] + c4[j]*c4[i] + c5[j]*c5[i];
+    }
+
+    prod += sz-j;
+  }
+}
+
+INOKIN_AVX2_FUNC
+static void project6Avx2(const double *c, int stride, int fst, int cnt,
+                                            const double *v, double *out)
+{
+  c += fst;
+
+  __m256d v0 = _mm256_set1_pd(v[0]), v1 = _mm256_set1_pd(v[1]);
+  __m256d v2 = _mm256_set1_pd(v[2]), v3 = _mm256_set1_pd(v[3]);
+  __m256d v4 = _mm256_set1_pd(v[4]), v5 = _mm256_set1_pd(v[5]);
+
+  int i = 0;
+
+  for (; i+4<=cnt; i+=4) {
+    __m256d s = _mm256_mul_pd(v0,_mm256_loadu_pd(c+i));
+    s = _mm256_fmadd_pd(v1,_mm256_loadu_pd(c+stride+i),s);
+    s = _mm256_fmadd_pd(v2,_mm256_loadu_pd(c+2*stride+i),s);
+    s = _mm256_fmadd_pd(v3,_mm256_loadu_pd(c+3*stride+i),s);
+    s = _mm256_fmadd_pd(v4,_mm256_loadu_pd(c+4*stride+i),s);
+    s = _mm256_fmadd_pd(v5,_mm256_loadu_pd(c+5*stride+i),s);
+
+    _mm256_storeu_pd(out+i,s);
+  }
+
+  if (i < cnt) project6Scalar(c-fst,stride,fst+i,cnt-i,v,out+i);
+}
+
+INOKIN_AVX2_FUNC
+static double hsum(__m256d s)
+{
+  __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s),_mm256_extractf128_pd(s,1));
+  return _mm_cvtsd_f64(_mm_add_sd(h,_mm_unpackhi_pd(h,h)));
+}
+
+INOKIN_AVX2_FUNC
+static void multAdd6Avx2(const double *c, int stride, int fst, int cnt,
+                                            const double *x, double *v)
+{
+  c += fst;
+
+  __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+  __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+  __m256d s4 = _mm256_setzero_pd(), s5 = _mm256_setzero_pd();
+
+  int i = 0;
+
+  for (; i+4<=cnt; i+=4) {
+    __m256d xv = _mm256_loadu_pd(x+i);
+
+    s0 = _mm256_fmadd_pd(xv,_mm256_loadu_pd(c+i),s0);
+    s1 = _mm256_fmadd_pd(xv,_mm256_loadu_pd(c+stride+i),s1);
+    s2 = _mm256_fmadd_pd(xv,_mm256_loadu_pd(c+2*stride+i),s2);
+    s3 = _mm256_fmadd_pd(xv,_mm256_loadu_pd(c+3*stride+i),s3);
+    s4 = _mm256_fmadd_pd(xv,_mm256_loadu_pd(c+4*stride+i),s4);
+    s5 = _mm256_fmadd_pd(xv,_mm256_loadu_pd(c+5*stride+i),s5);
+  }
+
+  v[0] += hsum(s0); v[1] += hsum(s1); v[2] += hsum(s2);
+  v[3] += hsum(s3); v[4] += hsum(s4); v[5] += hsum(s5);
+
+  if (i < cnt) multAdd6Scalar(c-fst,stride,fst+i,cnt-i,x+i,v);
+}
+
+//---------------------------------------------------------------------------
+// AVX-512, eight columns at a time, masked remainder
+
+INOKIN_AVX512_FUNC
+static void gram6Avx512(const double *c, int stride, int sz, double *prod)
+{
+  const double *c0 = c,          *c1 = c + stride,   *c2 = c + 2*stride;
+  const double *c3 = c + 3*stride, *c4 = c + 4*stride, *c5 = c + 5*stride;
+
+  for (int j=0; j<sz; ++j) {
+    __m512d a0 = _mm512_set1_pd(c0[j]), a1 = _mm512_set1_pd(c1[j]);
+    __m512d a2 = _mm512_set1_pd(c2[j]), a3 = _mm512_set1_pd(c3[j]);
+    __m512d a4 = _mm512_set1_pd(c4[j]), a5 = _mm512_set1_pd(c5[j]);
+
+    for (int i=j; i<sz; i+=8) {
+      __mmask8 m = sz-i >= 8 ? (__mmask8)0xFF : (__mmask8)((1 << (sz-i)) - 1);
+
+      __m512d s = _mm512_mul_pd(a0,_mm512_maskz_loadu_pd(m,c0+i));
+      s = _mm512_fmadd_pd(a1,_mm512_maskz_loadu_pd(m,c1+i),s);
+      s = _mm512_fmadd_pd(a2,_mm512_maskz_loadu_pd(m,c2+i),s);
+      s = _mm512_fmadd_pd(a3,_mm512_maskz_loadu_pd(m,c3+i),s);
+      s = _mm512_fmadd_pd(a4,_mm512_maskz_loadu_pd(m,c4+i),s);
+      s = _mm512_fmadd_pd(a5,_mm512_maskz_loadu_pd(m,c5+i),s);
+
+      _mm512_mask_storeu_pd(prod+(i-j),m,s);
+    }
+
+    prod += sz-j;
+  }
+}
+
+INOKIN_AVX512_FUNC
+static void project6Avx512(const double *c, int stride, int fst, int cnt,
+                                              const double *v, double *out)
+{
+  c += fst;
+
+  __m512d v0 = _mm512_set1_pd(v[0]), v1 = _mm512_set1_pd(v[1]);
+  __m512d v2 = _mm512_set1_pd(v[2]), v3 = _mm512_set1_pd(v[3]);
+  __m512d v4 = _mm512_set1_pd(v[4]), v5 = _mm512_set1_pd(v[5]);
+
+  for (int i=0; i<cnt; i+=8) {
+    __mmask8 m = cnt-i >= 8 ? (__mmask8)0xFF : (__mmask8)((1 << (cnt-i)) - 1);
+
+    __m512d s = _mm512_mul_pd(v0,_mm512_maskz_loadu_pd(m,c+i));
+    s = _mm512_fmadd_pd(v1,_mm512_maskz_loadu_pd(m,c+stride+i),s);
+    s = _mm512_fmadd_pd(v2,_mm512_maskz_loadu_pd(m,c+2*stride+i),s);
+    s = _mm512_fmadd_pd(v3,_mm512_maskz_loadu_pd(m,c+3*stride+i),s);
+    s = _mm512_fmadd_pd(v4,_mm512_maskz_loadu_pd(m,c+4*stride+i),s);
+    s = _mm512_fmadd_pd(v5,_mm512_maskz_loadu_pd(m,c+5*stride+i),s);
+
+    _mm512_mask_storeu_pd(out+i,m,s);
+  }
+}
+
+INOKIN_AVX512_FUNC
+static void multAdd6Avx512(const double *c, int stride, int fst, int cnt,
+                                              const double *x, double *v)
+{
+  c += fst;
+
+  __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+  __m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+  __m512d s4 = _mm512_setzero_pd(), s5 = _mm512_setzero_pd();
+
+  for (int i=0; i<cnt; i+=8) {
+    __mmask8 m = cnt-i >= 8 ? (__mmask8)0xFF : (__mmask8)((1 << (cnt-i)) - 1);
+
+    __m512d xv = _mm512_maskz_loadu_pd(m,x+i);
+
+    s0 = _mm512_fmadd_pd(xv,_mm512_maskz_loadu_pd(m,c+i),s0);
+    s1 = _mm512_fmadd_pd(xv,_mm512_maskz_loadu_pd(m,c+stride+i),s1);
+    s2 = _mm512_fmadd_pd(xv,_mm512_maskz_loadu_pd(m,c+2*stride+i),s2);
+    s3 = _mm512_fmadd_pd(xv,_mm512_maskz_loadu_pd(m,c+3*stride+i),s3);
+    s4 = _mm512_fmadd_pd(xv,_mm512_maskz_loadu_pd(m,c+4*stride+i),s4);
+    s5 = _mm512_fmadd_pd(xv,_mm512_maskz_loadu_pd(m,c+5*stride+i),s5);
+  }
+
+  v[0] += _mm512_reduce_add_pd(s0); v[1] += _mm512_reduce_add_pd(s1);
+  v[2] += _mm512_reduce_add_pd(s2); v[3] += _mm512_reduce_add_pd(s3);
+  v[4] += _mm512_reduce_add_pd(s4); v[5] += _mm512_reduce_add_pd(s5);
+}
+
+#endif
+
+//---------------------------------------------------------------------------
+// Checks the cpu and whether the OS saves the AVX (and AVX-512) registers
+
+static Simd::Level detectLevel()
+{
+#ifdef INOKIN_SIMD_X86
+#ifdef _MSC_VER
+  int info[4];
+
+  __cpuid(info,0);
+  if (info[0] < 7) return Simd::Scalar;
+
+  __cpuid(info,1);
+
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx     = (info[2] & (1 << 28)) != 0;
+  bool fma     = (info[2] & (1 << 12)) != 0;
+
+  if (!osxsave || !avx || !fma) return Simd::Scalar;
+
+  unsigned __int64 xcr0 = _xgetbv(0);
+  if ((xcr0 & 0x6) != 0x6) return Simd::Scalar;
+
+  __cpuidex(info,7,0);
+
+  bool avx2    = (info[1] & (1 << 5)) != 0;
+  bool avx512f = (info[1] & (1 << 16)) != 0;
+
+  if (!avx2) return Simd::Scalar;
+  if (avx512f && (xcr0 & 0xE6) == 0xE6) return Simd::Avx512;
+
+  return Simd::Avx2;
+#else
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512f")) return Simd::Avx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return Simd::Avx2;
+
+  return Simd::Scalar;
+#endif
+#else
+  return Simd::Scalar;
+#endif
+}
+
+//---------------------------------------------------------------------------
+
+static std::atomic<int>& levelInUse()
+{
+  static std::atomic<int> level((int)Simd::getSupported());
+
+  return level;
+}
+
+//---------------------------------------------------------------------------
+
+Simd::Level Simd::getSupported()
+{
+  static const Level supported = detectLevel();
+
+  return supported;
+}
+
+//---------------------------------------------------------------------------
+
+Simd::Level Simd::getLevel()
+{
+  return (Level)levelInUse().load(std::memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------------
+
+void Simd::setLevel(Level level)
+{
+  if (level > getSupported()) level = getSupported();
+  if (level < Scalar) level = Scalar;
+
+  levelInUse() = (int)level;
+}
+
+//---------------------------------------------------------------------------
+
+void Simd::gram6(const double *c, int stride, int sz, double *prod)
+{
+  switch (getLevel()) {
+#ifdef INOKIN_SIMD_X86
+    case Avx512: gram6Avx512(c,stride,sz,prod); break;
+    case Avx2:   gram6Avx2(c,stride,sz,prod);   break;
+#endif
+    default:     gram6Scalar(c,stride,sz,prod); break;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void Simd::project6(const double *c, int stride, int fst, int cnt,
+                                        const double *v, double *out)
+{
+  switch (getLevel()) {
+#ifdef INOKIN_SIMD_X86
+    case Avx512: project6Avx512(c,stride,fst,cnt,v,out); break;
+    case Avx2:   project6Avx2(c,stride,fst,cnt,v,out);   break;
+#endif
+    default:     project6Scalar(c,stride,fst,cnt,v,out); break;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void Simd::multAdd6(const double *c, int stride, int fst, int cnt,
+                                        const double *x, double *v)
+{
+  switch (getLevel()) {
+#ifdef INOKIN_SIMD_X86
+    case Avx512: multAdd6Avx512(c,stride,fst,cnt,x,v); break;
+    case Avx2:   multAdd6Avx2(c,stride,fst,cnt,x,v);   break;
+#endif
+    default:     multAdd6Scalar(c,stride,fst,cnt,x,v); break;
+  }
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------
@@ -0,0 +1,329 @@
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Kinema: Kinematic Simulation Program ---------------------------
+//---------------------------------------------------------------------------
+//-------------------- Copyright Inofor Hoek Aut BV Dec 1999-2013 -----------
+//-------------------------------------------------- C.Wolters --------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Supernodal sparse LDLT factorization ---------------------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#include "KinSparseLDLT.h"
+
+#include "Matrix.h"
+#include "Exceptions.h"
+
+#include <algorithm>
+
+using namespace Ino;
+
+namespace InoKin {
+
+//---------------------------------------------------------------------------
+
+SparseLDLT::SparseLDLT()
+: sz(0),
+  superLst(), colSuper(), rowStart(), rowLst(), valStart(),
+  aVal(), lVal(),
+  nonZeros(0.0), flops(0.0)
+{
+}
+
+//---------------------------------------------------------------------------
+// Symbolic factorization: the structure of column j of L is the
+// structure of column j of A joined with the structures of the
+// columns of which j is the parent in the elimination tree.
+// Columns j-1 and j form one supernode if j-1 is the only child of j
+// and both have the same structure below j.
+
+void SparseLDLT::analyze(int size, const std::vector<std::vector<int> >& cliqueLst)
+{
+  sz = size;
+
+  superLst.clear();
+  colSuper.assign(sz,0);
+  rowStart.clear();
+  rowLst.clear();
+  valStart.clear();
+
+  nonZeros = 0.0;
+  flops    = 0.0;
+
+  std::vector<std::vector<int> > patLst(sz);
+
+  int cliqueSz = (int)cliqueLst.size();
+
+  for (int i=0; i<cliqueSz; ++i) {
+    const std::vector<int>& clique = cliqueLst[i];
+    int cSz = (int)clique.size();
+
+    for (int j=0; j<cSz; ++j) {
+      int col = clique[j];
+      if (col < 0 || col >= sz)
+        throw IndexOutOfBoundsException("SparseLDLT::analyze");
+
+      for (int k=0; k<cSz; ++k) {
+        if (clique[k] > col) patLst[col].push_back(clique[k]);
+      }
+    }
+  }
+
+  std::vector<std::vector<int> > childLst(sz);
+  std::vector<int> mark(sz,-1);
+
+  for (int j=0; j<sz; ++j) {
+    std::vector<int>& pat = patLst[j];
+
+    std::sort(pat.begin(),pat.end());
+    pat.erase(std::unique(pat.begin(),pat.end()),pat.end());
+
+    int patSz = (int)pat.size();
+    for (int i=0; i<patSz; ++i) mark[pat[i]] = j;
+
+    int childSz = (int)childLst[j].size();
+
+    for (int i=0; i<childSz; ++i) {
+      const std::vector<int>& childPat = patLst[childLst[j][i]];
+      int cpSz = (int)childPat.size();
+
+      for (int k=0; k<cpSz; ++k) {
+        int row = childPat[k];
+
+        if (row > j && mark[row] != j) {
+          mark[row] = j;
+          pat.push_back(row);
+        }
+      }
+    }
+
+    std::sort(pat.begin(),pat.end());
+
+    if (!pat.empty()) childLst[pat[0]].push_back(j);
+
+    double cnt = (double)pat.size();
+    flops += cnt * (cnt + 1.0);
+  }
+
+  // Fundamental supernodes
+
+  if (sz > 0) superLst.push_back(0);
+
+  for (int j=1; j<sz; ++j) {
+    const std::vector<int>& prevPat = patLst[j-1];
+
+    bool merge = !prevPat.empty() && prevPat[0] == j &&
+                 childLst[j].size() == 1 &&
+                 prevPat.size() == patLst[j].size() + 1;
+
+    if (!merge) superLst.push_back(j);
+  }
+
+  superLst.push_back(sz);
+
+  int superSz = getSuperCnt();
+
+  rowStart.reserve(superSz+1);
+  valStart.reserve(superSz+1);
+
+  int valSz = 0;
+
+  for (int s=0; s<superSz; ++s) {
+    int fst = superLst[s], lst = superLst[s+1];
+
+    rowStart.push_back((int)rowLst.size());
+    valStart.push_back(valSz);
+
+    for (int j=fst; j<lst; ++j) {
+      colSuper[j] = s;
+      rowLst.push_back(j);
+    }
+
+    const std::vector<int>& pat = patLst[lst-1];
+    rowLst.insert(rowLst.end(),pat.begin(),pat.end());
+
+    int nc = lst - fst;
+    int nr = nc + (int)pat.size();
+
+    valSz += nr * nc;
+    nonZeros += nr * nc - nc * (nc-1) / 2;
+  }
+
+  rowStart.push_back((int)rowLst.size());
+  valStart.push_back(valSz);
+
+  aVal.assign(valSz,0.0);
+  lVal.assign(valSz,0.0);
+}
+
+//---------------------------------------------------------------------------
+
+void SparseLDLT::clear()
+{
+  std::fill(aVal.begin(),aVal.end(),0.0);
+}
+
+//---------------------------------------------------------------------------
+
+int SparseLDLT::indexOf(int row, int col) const
+{
+  if (row < col) std::swap(row,col);
+
+  if (col < 0 || row >= sz) throw IndexOutOfBoundsException("SparseLDLT::indexOf");
+
+  int s = colSuper[col];
+  int nr = superRows(s);
+
+  const int *rows = &rowLst[rowStart[s]];
+  const int *p = std::lower_bound(rows,rows+nr,row);
+
+  if (p == rows+nr || *p != row)
+    throw IndexOutOfBoundsException("SparseLDLT::indexOf: not in structure");
+
+  return valStart[s] + (col-superLst[s])*nr + int(p-rows);
+}
+
+//---------------------------------------------------------------------------
+
+double SparseLDLT::diag(int idx) const
+{
+  if (idx < 0 || idx >= sz) throw IndexOutOfBoundsException("SparseLDLT::diag");
+
+  int s = colSuper[idx];
+  int c = idx - superLst[s];
+
+  return aVal[valStart[s] + c*superRows(s) + c];
+}
+
+//---------------------------------------------------------------------------
+// Within a supernode the columns are factored left looking,
+// the supernode then updates the supernodes of its rows below
+
+bool SparseLDLT::factor(double damping)
+{
+  lVal = aVal;
+
+  if (damping != 0.0) {
+    for (int j=0; j<sz; ++j) {
+      int s = colSuper[j];
+      int c = j - superLst[s];
+
+      double& d = lVal[valStart[s] + c*superRows(s) + c];
+      d += damping * std::max(d,1.0e-12);
+    }
+  }
+
+  int superSz = getSuperCnt();
+
+  std::vector<int> relPos(sz,0);
+  std::vector<double> ld;
+
+  for (int s=0; s<superSz; ++s) {
+    int nc = superCols(s), nr = superRows(s);
+
+    double *l = &lVal[valStart[s]];
+    const int *rows = &rowLst[rowStart[s]];
+
+    for (int c=0; c<nc; ++c) {
+      double *colC = l + c*nr;
+
+      for (int k=0; k<c; ++k) {
+        const double *colK = l + k*nr;
+        double lkd = colK[c] * colK[k];
+
+        for (int r=c; r<nr; ++r) colC[r] -= colK[r] * lkd;
+      }
+
+      double d = colC[c];
+      if (d == 0.0) return false;
+
+      for (int r=c+1; r<nr; ++r) colC[r] /= d;
+    }
+
+    ld.resize(nc);
+
+    int p = nc;
+
+    while (p < nr) {
+      int t = colSuper[rows[p]];
+      int tFst = superLst[t], tLst = superLst[t+1];
+      int tnr = superRows(t);
+
+      const int *tRows = &rowLst[rowStart[t]];
+      for (int q=0; q<tnr; ++q) relPos[tRows[q]] = q;
+
+      double *tl = &lVal[valStart[t]];
+
+      int pEnd = p;
+      while (pEnd < nr && rows[pEnd] < tLst) pEnd++;
+
+      for (int cp=p; cp<pEnd; ++cp) {
+        for (int k=0; k<nc; ++k) ld[k] = l[k*nr + cp] * l[k*nr + k];
+
+        double *tCol = tl + (rows[cp]-tFst)*tnr;
+
+        for (int rp=cp; rp<nr; ++rp) {
+          double v = 0.0;
+          for (int k=0; k<nc; ++k) v += l[k*nr + rp] * ld[k];
+
+          tCol[relPos[rows[rp]]] -= v;
+        }
+      }
+
+      p = pEnd;
+    }
+  }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+// Solves in place with the factor of factor()
+
+void SparseLDLT::solve(Vector& sol) const
+{
+  int superSz = getSuperCnt();
+
+  for (int s=0; s<superSz; ++s) {
+    int fst = superLst[s], nc = superCols(s), nr = superRows(s);
+
+    const double *l = &lVal[valStart[s]];
+    const int *rows = &rowLst[rowStart[s]];
+
+    for (int c=0; c<nc; ++c) {
+      const double *colC = l + c*nr;
+      double v = sol[fst+c];
+
+      for (int r=c+1; r<nr; ++r) sol[rows[r]] -= colC[r] * v;
+    }
+  }
+
+  for (int s=0; s<superSz; ++s) {
+    int fst = superLst[s], nc = superCols(s), nr = superRows(s);
+
+    const double *l = &lVal[valStart[s]];
+
+    for (int c=0; c<nc; ++c) sol[fst+c] /= l[c*nr + c];
+  }
+
+  for (int s=superSz-1; s>=0; --s) {
+    int fst = superLst[s], nc = superCols(s), nr = superRows(s);
+
+    const double *l = &lVal[valStart[s]];
+    const int *rows = &rowLst[rowStart[s]];
+
+    for (int c=nc-1; c>=0; --c) {
+      const double *colC = l + c*nr;
+      double v = sol[fst+c];
+
+      for (int r=c+1; r<nr; ++r) v -= colC[r] * sol[rows[r]];
+
+      sol[fst+c] = v;
+    }
+  }
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------
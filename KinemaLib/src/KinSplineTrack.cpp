@@ -46,6 +46,8 @@ SplineTrack::~SplineTrack()
 void SplineTrack::clear()
 {
   spline.clear();
+
+  setModified();
 }
 
 //---------------------------------------------------------------------------
@@ -54,6 +56,8 @@ bool SplineTrack::build(bool closed, int controlSz,
                         const Vec3 *ptLst, int ptLstSz,
                         double& rmsDist, double& maxDist)
 {
+  setModified();
+
   return spline.build(4,closed,controlSz,0.0,Spline3D::BuildSimple,
                                              ptLst,ptLstSz,rmsDist,maxDist);
 }
@@ -96,6 +100,8 @@ void SplineTrack::translate(const Vec3& offset)
   trf.invert();
 
   spline.transform(trf);
+
+  setModified();
 }
 
 //---------------------------------------------------------------------------
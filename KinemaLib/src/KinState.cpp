@@ -55,6 +55,17 @@ State::State(Sequence& sequence, const State& cp)
 
 //---------------------------------------------------------------------------
 
+State::State(Sequence& sequence, int index, const State& cp)
+: seq(sequence), seqIdx(index), seqTm(cp.seqTm),
+  varPos(cp.varPos), fixedPos(cp.fixedPos),
+  varSpeed(cp.varSpeed), fixedSpeed(cp.fixedSpeed),
+  varAccel(cp.varAccel), fixedAccel(cp.fixedAccel),
+  varJerk(cp.varJerk), fixedJerk(cp.fixedJerk)
+{
+}
+
+//---------------------------------------------------------------------------
+
 static bool getValue(const Vector& values,
                      const AbstractJoint& jnt, int varIdx, double& varVal)
 {
@@ -25,12 +25,11 @@ namespace InoKin {
 
 //---------------------------------------------------------------------------
 
+// Must be called with trkMutex locked
+
 void TableArc::setupTrack() const
 {
-  if (trk) {
-    delete trk;
-    trk = NULL;
-  }
+  delete trk.exchange(NULL);
 
   int sz = size();
   if (sz < 1) return;
@@ -56,7 +55,25 @@ void TableArc::setupTrack() const
   ArcLinTrack *linTrk = new ArcLinTrack();
   linTrk->setTrack(ptLst,sz+2,true);
 
-  trk = linTrk;
+  trk.store(linTrk);
+}
+
+//---------------------------------------------------------------------------
+// The track is set up on first use, possibly by concurrent threads
+
+const AbstractTrack& TableArc::getTrack() const
+{
+  AbstractTrack *curTrk = trk.load();
+  if (curTrk) return *curTrk;
+
+  std::lock_guard<std::mutex> lock(trkMutex);
+
+  if (!trk.load()) setupTrack();
+
+  curTrk = trk.load();
+  if (!curTrk) throw NullPointerException("TableArc::getTrack");
+
+  return *curTrk;
 }
 
 //---------------------------------------------------------------------------
@@ -82,7 +99,7 @@ TableArc::TableArc(const TableArc& cp)
 
 TableArc::~TableArc()
 {
-  delete trk;
+  delete trk.load();
 }
 
 //---------------------------------------------------------------------------
@@ -91,8 +108,7 @@ TableArc& TableArc::operator=(const TableArc& src)
 {
   TableFunction::operator=(src);
 
-  delete trk;
-  trk = NULL;
+  delete trk.exchange(NULL);
 
   return *this;
 }
@@ -127,8 +143,7 @@ double TableArc::getValueAt(double x) const
 
   if (sz < 1) return 0.0;
 
-  if (!trk) setupTrack();
-  if (!trk) throw NullPointerException("TableArc::getValueAt");
+  const AbstractTrack& track = getTrack();
 
   if (closed) {
     double lx = fmod(x - xLst[0],xLength);
@@ -138,19 +153,19 @@ double TableArc::getValueAt(double x) const
   }
 
   double lwb = 0.0;
-  double upb = trk->getMaxS();
+  double upb = track.getMaxS();
 
   Vec3 pos;
-  trk->getPoint(lwb,pos);
+  track.getPoint(lwb,pos);
   if (pos.x >= x) return pos.y;
 
-  trk->getPoint(upb,pos);
+  track.getPoint(upb,pos);
   if (pos.x <= x) return pos.y;
 
   for (;;) {
     double s = (lwb + upb)/2.0;
 
-    trk->getPoint(s,pos);
+    track.getPoint(s,pos);
 
     if (pos.x < x - 1.0e-4) lwb = s;
     else if (pos.x > x + 1.0e-4) upb = s;
@@ -168,8 +183,7 @@ double TableArc::getDerivativeAt(double x) const
 
   if (sz < 1) return 0.0;
 
-  if (!trk) setupTrack();
-  if (!trk) throw NullPointerException("TableArc::getValueAt");
+  const AbstractTrack& track = getTrack();
 
   if (closed) {
     double lx = fmod(x - xLst[0],xLength);
@@ -179,13 +193,13 @@ double TableArc::getDerivativeAt(double x) const
   }
 
   double lwb = 0.0;
-  double upb = trk->getMaxS();
+  double upb = track.getMaxS();
 
   Vec3 pos;
-  trk->getPoint(lwb,pos);
+  track.getPoint(lwb,pos);
   if (pos.x >= x) return 0.0;
 
-  trk->getPoint(upb,pos);
+  track.getPoint(upb,pos);
   if (pos.x <= x) return 0.0;
 
   Vec3 dir;
@@ -193,8 +207,8 @@ double TableArc::getDerivativeAt(double x) const
   for (;;) {
     double s = (lwb + upb)/2.0;
 
-    trk->getPoint(s,pos);
-    trk->getDir(s,dir);
+    track.getPoint(s,pos);
+    track.getDir(s,dir);
 
     if (pos.x < x - 1.0e-4) lwb = s;
     else if (pos.x > x + 1.0e-4) upb = s;
@@ -212,8 +226,7 @@ double TableArc::getSecDerivativeAt(double x) const
 
   if (sz < 1) return 0.0;
 
-  if (!trk) setupTrack();
-  if (!trk) throw NullPointerException("TableArc::getValueAt");
+  const AbstractTrack& track = getTrack();
 
   if (closed) {
     double lx = fmod(x - xLst[0],xLength);
@@ -223,13 +236,13 @@ double TableArc::getSecDerivativeAt(double x) const
   }
 
   double lwb = 0.0;
-  double upb = trk->getMaxS();
+  double upb = track.getMaxS();
 
   Vec3 pos;
-  trk->getPoint(lwb,pos);
+  track.getPoint(lwb,pos);
   if (pos.x >= x) return 0.0;
 
-  trk->getPoint(upb,pos);
+  track.getPoint(upb,pos);
   if (pos.x <= x) return 0.0;
 
   Vec3 dir,acc;
@@ -238,15 +251,15 @@ double TableArc::getSecDerivativeAt(double x) const
   for (;;) {
     s = (lwb + upb)/2.0;
 
-    trk->getPoint(s,pos);
+    track.getPoint(s,pos);
 
     if (pos.x < x - 1.0e-4) lwb = s;
     else if (pos.x > x + 1.0e-4) upb = s;
     else break;
   }
 
-  trk->getDir(s,dir);
-  trk->getAcc(s,acc);
+  track.getDir(s,dir);
+  track.getAcc(s,acc);
 
   return (acc.y - dir.y/dir.x*acc.x)/sqr(dir.x);
 }
@@ -16,40 +16,112 @@
 #include "KinGrip.h"
 #include "KinAbstractJoint.h"
 #include "KinProbe.h"
+#include "KinFunction.h"
+#include "KinSparseLDLT.h"
+#include "KinVarGraph.h"
+#include "KinWorkerPool.h"
+#include "KinSimd.h"
 #include "Matrix.h"
 #include "Exceptions.h"
 
 #include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <atomic>
 #include <cmath>
 
-#ifdef _WIN32
-#include <malloc.h>
-#else
-#include <alloca.h>
-#endif
-
 using namespace Ino;
 
 namespace InoKin {
 
 //-------------------------------------------------------------------------------
 
+SolverContext::SolverContext()
+: solMat(*new Matrix(0,0)),
+  rhs(*new Vector(0)),
+  solMat2(0,0),
+  solRhs2(0),
+  speedRhs2(0),
+  sparseMat(*new SparseLDLT()),
+  posFactor(0,0),
+  posFactorDamping(0.0),
+  posFactorValid(false),
+  chordFactorValid(false),
+  posFactorVersion(0),
+  prdPos(0), prdFixedPos(0),
+  prdSpeed(0), prdFixedSpeed(0),
+  prdAccel(0),
+  prdPosValid(false), prdSpeedValid(false), prdAccelValid(false),
+  loopJacLst()
+{
+}
+
+//-------------------------------------------------------------------------------
+
+SolverContext::SolverContext(const SolverContext& cp)
+: solMat(*new Matrix(0,0)),
+  rhs(*new Vector(0)),
+  solMat2(0,0),
+  solRhs2(0),
+  speedRhs2(0),
+  sparseMat(*new SparseLDLT(cp.sparseMat)),
+  posFactor(0,0),
+  posFactorDamping(0.0),
+  posFactorValid(false),
+  chordFactorValid(false),
+  posFactorVersion(0),
+  prdPos(0), prdFixedPos(0),
+  prdSpeed(0), prdFixedSpeed(0),
+  prdAccel(0),
+  prdPosValid(false), prdSpeedValid(false), prdAccelValid(false),
+  loopJacLst(cp.loopJacLst)
+{
+}
+
+//-------------------------------------------------------------------------------
+
+SolverContext::~SolverContext()
+{
+  delete &solMat;
+  delete &rhs;
+
+  delete &sparseMat;
+}
+
+//-------------------------------------------------------------------------------
+
+void SolverContext::clear()
+{
+  posFactorValid   = false;
+  chordFactorValid = false;
+  loopJacLst.clear();
+
+  sparseMat.analyze(0,std::vector<std::vector<int> >());
+
+  prdPosValid   = false;
+  prdSpeedValid = false;
+  prdAccelValid = false;
+}
+
+//-------------------------------------------------------------------------------
+
 Topology::Topology(Model& mdl)
 : Ino::Array<GripList *>(true), model(&mdl),
   topoBodyLst(*new BodyList()),
   topoGripLst(*new GripList()),
-  rowSz(0), colSz(0), varSz(0), fixedSz(0),
-  angularVar(NULL),
+  structure(std::make_shared<TopologyStructure>()),
   posValid(false), speedValid(false),
   accelValid(false), jerkValid(false),
   seqLst(true,2),
-  prepMat(*new Matrix(0,0)),
-  solMat(*new Matrix(0,0)),
-  rhs(*new Vector(0)),
-  solMat2(0,0),
-  speedMat2(0,0),
-  solRhs2(0),
-  speedRhs2(0)
+  ctx(*new SolverContext()),
+  solverOptions(),
+  solverStats(),
+  treeStepLst(),
+  jointGroupLst(),
+  varStore(), freeSlotLst(), fixedSlotLst(),
+  varJntLst(), varJntMask(),
+  workerPool(NULL)
 {
 }
 
@@ -59,29 +131,40 @@ Topology::Topology(Model& mdl, const Topology& cp, bool withSequences)
 : LoopList(true,cp.size()), model(&mdl),
   topoBodyLst(*new BodyList()),
   topoGripLst(*new GripList()),
-  rowSz(cp.rowSz), colSz(cp.colSz), varSz(cp.varSz), fixedSz(cp.fixedSz),
-  angularVar(NULL),
+  structure(cp.structure),
   posValid(cp.posValid), speedValid(cp.speedValid),
   accelValid(cp.accelValid), jerkValid(cp.jerkValid),
   seqLst(true,cp.seqLst.size()),
-  prepMat(*new Matrix(0,0)),
-  solMat(*new Matrix(0,0)),
-  rhs(*new Vector(0)),
-  solMat2(0,0),
-  speedMat2(0,0),
-  solRhs2(0),
-  speedRhs2(0)
+  ctx(*new SolverContext(cp.ctx)),
+  solverOptions(cp.solverOptions),
+  solverStats(),
+  treeStepLst(),
+  jointGroupLst(),
+  varStore(), freeSlotLst(), fixedSlotLst(),
+  varJntLst(), varJntMask(),
+  workerPool(NULL)
 {
+  // The lists of mdl are copies of those of cp.model, in the same order
+
+  std::unordered_map<const Body *, int> bodyIdx;
+  std::unordered_map<const Grip *, int> gripIdx;
+
+  cp.model->getBodyList().getIndexMap(bodyIdx);
+  cp.model->getGripList().getIndexMap(gripIdx);
+
+  const BodyList& bodyLst = mdl.getBodyList();
+  const GripList& gripLst = mdl.getGripList();
+
   int sz = cp.topoBodyLst.size();
 
   for (int i=0; i<sz; ++i) {
-    topoBodyLst.add(mdl.getBodyList().byId(cp.topoBodyLst[i]->getId()));
+    topoBodyLst.add(bodyLst[bodyIdx.at(cp.topoBodyLst[i])]);
   }
 
   sz = cp.topoGripLst.size();
 
   for (int i=0; i<sz; ++i) {
-    topoGripLst.add(mdl.getGripList().byId(cp.topoGripLst[i]->getId()));
+    topoGripLst.add(gripLst[gripIdx.at(cp.topoGripLst[i])]);
   }
 
   sz = cp.size();
@@ -93,14 +176,15 @@ Topology::Topology(Model& mdl, const Topology& cp, bool withSequences)
     
     for (int j=0; j<gSz; ++j) {
       const Grip *grp = gLst->get(j);
-      if (grp) gLst->set(j,mdl.getGripList().byId(grp->getId()));
+      if (grp) gLst->set(j,gripLst[gripIdx.at(grp)]);
     }
 
     add(gLst);
   }
 
-  angularVar = new bool[varSz];
-  topoGripLst.setAngularVars(angularVar);
+  buildTreeSteps();
+  groupJoints();
+  attachJointVars();
 
   if (withSequences) {
     for (int i=0; i<cp.seqLst.size(); ++i)
@@ -112,37 +196,41 @@ Topology::Topology(Model& mdl, const Topology& cp, bool withSequences)
 
 Topology::~Topology()
 {
+  detachJointVars();
+
   delete &topoGripLst;
   delete &topoBodyLst;
 
-  delete[] angularVar;
+  delete &ctx;
 
-  delete &prepMat;
-  delete &solMat;
-  delete &rhs;
+  delete workerPool;
 }
 
 //-------------------------------------------------------------------------------
 
 void Topology::clear()
 {
+  detachJointVars();
+
   topoBodyLst.clear();
   topoGripLst.clear();
 
   LoopList::clear();
 
-  rowSz   = 0;
-  colSz   = 0;
-  varSz   = 0;
-  fixedSz = 0;
-
-  delete[] angularVar; angularVar = NULL;
+  structure = std::make_shared<TopologyStructure>(); // The old one may be shared
 
   posValid   = false;
   speedValid = false;
   accelValid = false;
   jerkValid  = false;
 
+  ctx.clear();
+
+  treeStepLst.clear();
+  jointGroupLst.clear();
+
+  delete workerPool; workerPool = NULL; // Sized to the nr of loops
+
   seqLst.clear();
 }
 
@@ -393,10 +481,10 @@ void Topology::assignVarIndices(LoopList& loopLst)
     if (jnt) jnt->clearVarIndices();
   }
 
-  rowSz = 0;
-  colSz = 0; // See below
-  varSz = 0;
-  fixedSz = 0;
+  structure->rowSz = 0;
+  structure->colSz = 0;
+  structure->varSz = 0;
+  structure->fixedSz = 0;
 
   int loopSz = loopLst.size();
 
@@ -413,83 +501,20 @@ void Topology::assignVarIndices(LoopList& loopLst)
       for (int k=0; k<varCnt; ++k) {
         if (jnt->getVarIdx(k) < 0) {
           if (jnt->getFixed(k))
-               jnt->setVarIdx(k,fixedSz++);
-          else jnt->setVarIdx(k,varSz++);
-        }
-      }
-    }
-  }
-
-  // Determine required matrix bandwidth: (set in colSz)
-
-  enum { MaxAllocaSz = 16000 }; // Max nr of items on stack
-
-  int *lwbIdx, *upbIdx;
-
-  if (varSz > MaxAllocaSz) {
-    lwbIdx = new int[varSz];
-    upbIdx = new int[varSz];
-  }
-  else {
-    lwbIdx = (int *)_malloca(varSz*sizeof(int));
-    upbIdx = (int *)_malloca(varSz*sizeof(int));
-  }
-
-  memset(lwbIdx,-1,varSz*sizeof(int));
-  memset(upbIdx, 0,varSz*sizeof(int));
-
-  if (!lwbIdx) throw NullPointerException("lwbIdx");
-  if (!upbIdx) throw NullPointerException("upbIdx");
-
-  for (int i=0; i<loopSz; ++i) {
-    GripList *grpLst = loopLst[i];
-    int gSz = grpLst->size();
-
-    for (int j=0; j<gSz; ++j) {
-      AbstractJoint *jnt = grpLst->get(j)->getJoint();
-      if (!jnt) continue;
-      
-      int varCnt = jnt->getVarCnt();
-
-      for (int k=0; k<varCnt; ++k) {
-        if (jnt->getFixed(k)) continue;
-
-        int idx = jnt->getVarIdx(k);
-
-        if (lwbIdx[idx] < 0) lwbIdx[idx] = rowSz;
-        upbIdx[idx] = rowSz+6;
-      }
-    }
-
-    rowSz += 6;
-  }
-
-  // Determine bandwidth
-
-  colSz = 0;
-
-  for (int i=0; i<varSz; ++i) {
-    for (int j=0; j<i-colSz; ++j) {
-      if (std::max(lwbIdx[i],lwbIdx[j]) < std::min(upbIdx[i],upbIdx[j])) {
-        int bw = i-j;
-        if (bw > colSz) {
-          colSz = bw;
-          break;
+               jnt->setVarIdx(k,structure->fixedSz++);
+          else jnt->setVarIdx(k,structure->varSz++);
         }
       }
     }
   }
 
-  if (colSz) colSz++;
+  structure->rowSz = 6 * loopSz;
 
-  if (varSz > MaxAllocaSz) {
-    delete[] lwbIdx;
-    delete[] upbIdx;
-  }
+  // colSz is set by orderVars()
 
-  delete[] angularVar; angularVar = new bool[varSz];
+  delete[] structure->angularVar; structure->angularVar = new bool[structure->varSz];
 
-  topoGripLst.setAngularVars(angularVar);
+  topoGripLst.setAngularVars(structure->angularVar);
 }
 
 //-------------------------------------------------------------------------------
@@ -526,15 +551,17 @@ void Topology::prepare(Body *fstBody)
   fstBody->setTreeLevel(0);
   topoBodyLst.add(fstBody);
 
-  rowSz = 0;
-  colSz = 0;
-  varSz = 0;
-  fixedSz = 0;
+  structure->rowSz = 0;
+  structure->colSz = 0;
+  structure->varSz = 0;
+  structure->fixedSz = 0;
 
   for (int i=0; i<topoBodyLst.size(); ++i) bodyScan(i); // Size increasing!!
 
   analyzeLoops();
   setLoopCounts();
+  orderVars();
+  buildLoopJacobians();
 
   int sz = topoGripLst.size();
 
@@ -544,248 +571,1261 @@ void Topology::prepare(Body *fstBody)
     AbstractJoint *jnt = grp->getJoint();
     if (!jnt) throw NullPointerException("Topology::prepare: null joint");
 
+    jnt->clearVarTrfCache(); // The track may have been edited
+
     jnt->initVarsFromPos(true);
   }
+
+  buildTreeSteps();
+  groupJoints();
+  attachJointVars();
 }
 
 //---------------------------------------------------------------------------
 
-void Topology::sizeMats()
+// Each loop couples all of its free vars
+
+void Topology::getVarCliques(std::vector<std::vector<int> >& cliqueLst) const
 {
-  prepMat.resize(6,varSz);
-  solMat.resize(varSz,colSz);
-  rhs.setSize(varSz);
-}
+  int sz = size();
 
-//---------------------------------------------------------------------------
+  cliqueLst.assign(sz,std::vector<int>());
 
-static void updateDists(const Trf3& trf, double& maxRot, double& maxDist)
-{
-  maxRot = std::max(maxRot,fabs(trf(0,2)));
-  maxRot = std::max(maxRot,fabs(trf(1,0)));
-  maxRot = std::max(maxRot,fabs(trf(2,1)));
+  for (int i=0; i<sz; ++i) {
+    GripList& grpLst = *get(i);
+    int gSz = grpLst.size();
 
-  double offset = sqrt(sqr(trf(0,3)) + sqr(trf(1,3)) + sqr(trf(2,3)));
+    for (int j=0; j<gSz; ++j) {
+      AbstractJoint *jnt = grpLst[j]->getJoint();
+      if (!jnt) continue;
 
-  maxDist = std::max(maxDist,offset);
+      int varCnt = jnt->getVarCnt();
+
+      for (int k=0; k<varCnt; ++k) {
+        if (!jnt->getFixed(k)) cliqueLst[i].push_back(jnt->getVarIdx(k));
+      }
+    }
+  }
 }
 
-//-------------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+// Free var perm[i] becomes free var i
 
-bool Topology::composePosMatrixRow(const GripList& grpLst,
-                                   double& maxRot, double& maxDist)
+void Topology::renumberVars(const std::vector<int>& perm)
 {
-  Trf3 loopTrf;
-  if (!grpLst.setPreTrfs(loopTrf)) return false;
+  std::vector<int> inv;
+  VarGraph::invert(perm,inv);
 
-  updateDists(loopTrf,maxRot,maxDist);
-
-  Body *body = grpLst.firstBody();
-  if (!body) return false;
+  int sz = topoGripLst.size();
 
-  enum { MaxAllocaSz = 32000 }; // Max nr of items on stack
+  for (int i=0; i<sz; ++i) {
+    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+    if (!jnt) continue;
 
-  int idxLstSz = 0;
-  int *idxLst;
- 
-  if (varSz > MaxAllocaSz) idxLst = new int[varSz];
-  else idxLst = (int *)_malloca(varSz*sizeof(int));
+    int varCnt = jnt->getVarCnt();
 
-  if (!idxLst) throw NullPointerException("idxlst");
+    for (int k=0; k<varCnt; ++k) {
+      int idx = jnt->getVarIdx(k);
+      if (idx >= 0 && !jnt->getFixed(k)) jnt->setVarIdx(k,inv[idx]);
+    }
+  }
 
-  for (int i=0; i<varSz; ++i) idxLst[i] = -1;
+  topoGripLst.setAngularVars(structure->angularVar);
+}
 
-  Trf3 curTrf;
+//---------------------------------------------------------------------------
 
-  int grpSz = grpLst.size();
+static void bandStats(int varSz, int colSz, double& nonZeros, double& flops)
+{
+  nonZeros = 0.0;
+  flops    = 0.0;
 
-  for (int i=grpSz-1; i>=0; --i) {
-    Grip& grp = *grpLst[i];
+  for (int i=0; i<varSz; ++i) {
+    double cnt = std::min(colSz,varSz-i) - 1;
+    if (cnt < 0) cnt = 0;
 
-    bool atBody1 = body == grp.getBody1();
+    nonZeros += cnt + 1;
+    flops    += cnt * (cnt + 1.0);
+  }
+}
 
-    if (atBody1) curTrf.preMultWith(grp.getPos1());
-    else curTrf.preMultWith(grp.getPos2());
+//---------------------------------------------------------------------------
+// Chooses the numbering of the free vars:
+// The band matrix gets the loop order or reverse Cuthill-McKee,
+// whichever has the smaller bandwidth, the sparse matrix the ordering
+// with the least fill. Sparse is advised if it has less than half the
+// nonzeros of the band matrix, it is slower per element.
+// The vars are then renumbered for the advised matrix.
+
+void Topology::orderVars()
+{
+  std::vector<std::vector<int> > cliqueLst;
+  getVarCliques(cliqueLst);
 
-    const Trf3& preTrf = grpLst.getPreTrf(i);
-    AbstractJoint& jnt = *grp.getJoint();
+  VarGraph graph(structure->varSz,cliqueLst);
 
-    int varCnt = jnt.getVarCnt();
+  std::vector<int> permLst[3];
 
-    for (int j=0; j<varCnt; ++j) {
-      if (jnt.getFixed(j)) continue;
+  permLst[MatrixStats::LoopOrder].resize(structure->varSz);
+  for (int i=0; i<structure->varSz; ++i) permLst[MatrixStats::LoopOrder][i] = i;
 
-      int varIdx = jnt.getVarIdx(j);
+  graph.orderRCM(permLst[MatrixStats::CuthillMcKee]);
+  graph.orderMinDegree(permLst[MatrixStats::MinimumDegree]);
 
-      Trf3 trf(curTrf);
+  int bandBest = MatrixStats::LoopOrder, sparseBest = MatrixStats::LoopOrder;
+  int bandColSz[3];
+  double bandNnz[3], bandFlp[3], sparseNnz[3];
 
-      if (atBody1) trf.preMultWith(jnt.getDerivative(j));
-      else trf.preMultWith(jnt.getInvDerivative(j));
+  std::vector<int> inv;
+  std::vector<std::vector<int> > permCliqueLst(cliqueLst);
 
-      trf.preMultWith(preTrf);
+  for (int o=0; o<3; ++o) {
+    bandColSz[o] = graph.bandWidth(permLst[o]);
+    bandStats(structure->varSz,bandColSz[o],bandNnz[o],bandFlp[o]);
 
-      // Six matrix rows
-      prepMat(0,varIdx) = trf(0,2);
-      prepMat(1,varIdx) = trf(1,0);
-      prepMat(2,varIdx) = trf(2,1);
-      prepMat(3,varIdx) = trf(0,3);
-      prepMat(4,varIdx) = trf(1,3);
-      prepMat(5,varIdx) = trf(2,3);
+    VarGraph::invert(permLst[o],inv);
 
-      rhs[varIdx] -= trf(0,2) * loopTrf(0,2);
-      rhs[varIdx] -= trf(1,0) * loopTrf(1,0);
-      rhs[varIdx] -= trf(2,1) * loopTrf(2,1);
-      rhs[varIdx] -= trf(0,3) * loopTrf(0,3);
-      rhs[varIdx] -= trf(1,3) * loopTrf(1,3);
-      rhs[varIdx] -= trf(2,3) * loopTrf(2,3);
+    for (int i=0; i<(int)cliqueLst.size(); ++i) {
+      for (int j=0; j<(int)cliqueLst[i].size(); ++j)
+        permCliqueLst[i][j] = inv[cliqueLst[i][j]];
+    }
 
-      if (!idxLst) throw NullPointerException("idxlst");
+    ctx.sparseMat.analyze(structure->varSz,permCliqueLst);
+    sparseNnz[o] = ctx.sparseMat.getNonZeros();
 
-      idxLst[idxLstSz++] = varIdx;
-    }
+    if (o == MatrixStats::MinimumDegree) continue; // Not for the band
 
-    if (atBody1) {
-      curTrf.preMultWith(jnt.pos);
-      curTrf.preMultWith(grp.getInvPos2());
-    }
-    else {
-      curTrf.preMultWith(jnt.invPos);
-      curTrf.preMultWith(grp.getInvPos1());
-    }
+    if (bandNnz[o] < bandNnz[bandBest]) bandBest = o;
+  }
 
-    body = grp.getOtherBody(*body);
+  for (int o=1; o<3; ++o) {
+    if (sparseNnz[o] < sparseNnz[sparseBest]) sparseBest = o;
   }
 
-  for (int i=0; i<6; ++i) {
-    for (int j=0; j<idxLstSz; ++j) {
-      int colIdx = idxLst[j];
+  structure->sparseAdvised = 2.0 * sparseNnz[sparseBest] < bandNnz[bandBest];
 
-      double m = prepMat(i,colIdx);
+  int best = structure->sparseAdvised ? sparseBest : bandBest;
 
-      for (int k=0; k<idxLstSz; ++k) {
-        int rowIdx = idxLst[k];
-        if (rowIdx < colIdx) continue;
+  structure->varOrdering = (MatrixStats::VarOrdering)best;
+  structure->colSz = bandColSz[best];
 
-        // Store element of AT-A, optimized storage, see Matrix::solveLDLT()
-        solMat(colIdx,rowIdx-colIdx) += m * prepMat(i,rowIdx);
-      }
-    }
-  }
+  structure->posNonZeros  = graph.getNonZeros();
+  structure->bandNonZeros = bandNnz[best];
+  structure->bandFlops    = bandFlp[best];
 
-  if (varSz > MaxAllocaSz) delete[] idxLst;
+  if (best != MatrixStats::LoopOrder) {
+    renumberVars(permLst[best]);
+    getVarCliques(cliqueLst);
+  }
 
-  return true;
+  ctx.sparseMat.analyze(structure->varSz,cliqueLst);
 }
 
 //---------------------------------------------------------------------------
+// The free vars of each loop in the order of composePosMatrixRow()
 
-bool Topology::composePosEq(double& maxRot, double& maxDist, int& maxIdx)
+void Topology::buildLoopJacobians()
 {
-  maxRot  = 0.0;
-  maxDist = 0.0;
-  maxIdx = -1;
+  int sz = size();
 
-  solMat.clear();
-  rhs.clear();
+  ctx.loopJacLst.assign(sz,LoopJacobian());
 
-  topoGripLst.clearJointTrfCaches();
+  std::vector<int> varLst;
 
-  // model.func_lst.updateAllPos();
+  for (int i=0; i<sz; ++i) {
+    GripList& grpLst = *get(i);
 
-  bool ok = true;
-  int sz = size();
+    varLst.clear();
 
-  for (int i=0; i<sz; i++) {
-    GripList& grpLst = *get(i);
+    for (int j=grpLst.size()-1; j>=0; --j) {
+      AbstractJoint *jnt = grpLst[j]->getJoint();
+      if (!jnt) continue;
 
-    double lastMaxDist = maxDist;
-    if (!composePosMatrixRow(grpLst,maxRot,maxDist)) ok = false;
+      int varCnt = jnt->getVarCnt();
 
-    if (maxDist > lastMaxDist) maxIdx = i;
-  }
+      for (int k=0; k<varCnt; ++k) {
+        if (!jnt->getFixed(k)) varLst.push_back(jnt->getVarIdx(k));
+      }
+    }
 
-  return ok;
+    ctx.loopJacLst[i].init(varLst,ctx.sparseMat);
+  }
 }
 
 //---------------------------------------------------------------------------
+// For the matrix in use, band or sparse
 
-void Topology::limitSolution(Vector& sol)
+MatrixStats Topology::getMatrixStats() const
 {
-  double maxAng = atan(1.0)/4.5;  // 10 degrees
-
-  double maxRot = 0.0;
+  MatrixStats stats;
 
-  for (int i=0; i<varSz; ++i) {
-    if (angularVar[i]) {
-      double val = fabs(sol[i]);
+  stats.rowSz    = structure->rowSz;
+  stats.colSz    = structure->colSz;
+  stats.varSz    = structure->varSz;
+  stats.ordering = structure->varOrdering;
+  stats.sparse   = useSparse();
+  stats.nonZeros = structure->posNonZeros;
 
-      if (val > maxRot)
-        maxRot = val;
-    }
+  if (stats.sparse) {
+    stats.fill  = ctx.sparseMat.getNonZeros() - structure->posNonZeros;
+    stats.flops = ctx.sparseMat.getFlops();
+  }
+  else {
+    stats.fill  = structure->bandNonZeros - structure->posNonZeros;
+    stats.flops = structure->bandFlops;
   }
 
-  if (maxRot > maxAng) sol *= (maxAng/maxRot); 
+  return stats;
 }
 
 //---------------------------------------------------------------------------
 
-Sequence& Topology::newSequence(const wchar_t *name)
+bool Topology::useSparse() const
 {
-  Sequence *seq = new Sequence(*this,name);
-  seqLst.add(seq);
+  switch (solverOptions.matrixMode) {
+    case SolverOptions::BandMatrix:   return false;
+    case SolverOptions::SparseMatrix: return true;
+    default:                          return structure->sparseAdvised;
+  }
+}
 
-  return *seq;
+//---------------------------------------------------------------------------
+
+void Topology::sizeMats()
+{
+  if (useSparse()) ctx.solMat.resize(0,0);
+  else ctx.solMat.resize(structure->varSz,structure->colSz);
+  ctx.rhs.setSize(structure->varSz);
 }
 
 //---------------------------------------------------------------------------
 
-bool Topology::solvePos(int maxIter, double rotTol, double posTol,
-                                                Vector& varPosVec, int& iter)
+static void updateDists(const Trf3& trf, double& maxRot, double& maxDist)
 {
-  if (rowSz < 1 || colSz < 1 || varSz < 1) {
-    posValid   = false;
-    speedValid = false;
-    accelValid = false;
-    jerkValid  = false;
+  maxRot = std::max(maxRot,fabs(trf(0,2)));
+  maxRot = std::max(maxRot,fabs(trf(1,0)));
+  maxRot = std::max(maxRot,fabs(trf(2,1)));
 
-    return false;
-  }
+  double offset = sqrt(sqr(trf(0,3)) + sqr(trf(1,3)) + sqr(trf(2,3)));
 
-  posValid = true;
-  varPosVec.setSize(varSz);
+  maxDist = std::max(maxDist,offset);
+}
+//-------------------------------------------------------------------------------
 
-  sizeMats();
+static void addSol(const Trf3& trf, double *v)
+{
+  v[0] += trf(0,2);
+  v[1] += trf(1,0);
+  v[2] += trf(2,1);
+  v[3] += trf(0,3);
+  v[4] += trf(1,3);
+  v[5] += trf(2,3);
+}
 
-  double maxRot=0.0, maxDist=0.0;
-  int maxIdx = -1;
+//-------------------------------------------------------------------------------
 
-  for (iter=0; iter<maxIter; ++iter) {
+void LoopJacobian::init(const std::vector<int>& varLst,
+                                      const SparseLDLT& sparseMat)
+{
+  int sz = (int)varLst.size();
 
-    if (!composePosEq(maxRot,maxDist,maxIdx))
-      return false;
+  idxLst = varLst;
+  std::sort(idxLst.begin(),idxLst.end());
 
-    if (iter > 0) {
-      if (maxRot <= rotTol && maxDist <= posTol) {
-        solMat2 = solMat;
-        solRhs2 = rhs;
-        return true;
-      }
-    }
+  slotLst.resize(sz);
+
+  for (int n=0; n<sz; ++n) {
+    slotLst[n] = int(std::lower_bound(idxLst.begin(),idxLst.end(),varLst[n]) -
+                                                              idxLst.begin());
+  }
 
-    solMat.solveLDLT(rhs);
+  stride = (sz + 7) & ~7; // Whole vectors per row
+  rowLst.assign(6*stride,0.0);
 
-    limitSolution(rhs);
+  prodLst.assign(sz*(sz+1)/2,0.0);
+  posLst.resize(prodLst.size());
 
-    // double len = rhs.len();
+  int p = 0;
 
-    getPosVector(varPosVec);
-    varPosVec += rhs;
-    setPosVector(varPosVec);
-    updatePositions();
+  for (int c=0; c<sz; ++c) {
+    for (int r=c; r<sz; ++r) posLst[p++] = sparseMat.indexOf(idxLst[r],idxLst[c]);
   }
 
-  posValid = false;
-  varPosVec.setSize(0);
+  for (int i=0; i<6; ++i) res[i] = 0.0;
+}
+
+//-------------------------------------------------------------------------------
+
+void LoopJacobian::setColumn(int n, const Trf3& trf)
+{
+  double *col = &rowLst[slotLst[n]];
+
+  col[0]        = trf(0,2);
+  col[stride]   = trf(1,0);
+  col[2*stride] = trf(2,1);
+  col[3*stride] = trf(0,3);
+  col[4*stride] = trf(1,3);
+  col[5*stride] = trf(2,3);
+}
+
+//-------------------------------------------------------------------------------
+
+void LoopJacobian::composeProduct()
+{
+  Simd::gram6(rowLst.data(),stride,size(),prodLst.data());
+}
+
+//-------------------------------------------------------------------------------
+// In blocks, through a small buffer
+
+void LoopJacobian::subtractProjection(const double *v, Vector& rhsVec) const
+{
+  enum { BlockSz = 64 };
+
+  double proj[BlockSz];
+
+  int sz = size();
+
+  for (int fst=0; fst<sz; fst+=BlockSz) {
+    int cnt = std::min((int)BlockSz,sz-fst);
+
+    Simd::project6(rowLst.data(),stride,fst,cnt,v,proj);
+
+    for (int i=0; i<cnt; ++i) rhsVec[idxLst[fst+i]] -= proj[i];
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void LoopJacobian::addProduct(const Vector& x, double *v) const
+{
+  enum { BlockSz = 64 };
+
+  double xBuf[BlockSz];
+
+  int sz = size();
+
+  for (int fst=0; fst<sz; fst+=BlockSz) {
+    int cnt = std::min((int)BlockSz,sz-fst);
+
+    for (int i=0; i<cnt; ++i) xBuf[i] = x[idxLst[fst+i]];
+
+    Simd::multAdd6(rowLst.data(),stride,fst,cnt,xBuf,v);
+  }
+}
+
+//-------------------------------------------------------------------------------
+// The body tree as one flat list, in the order of the bodies in topoBodyLst:
+// the updates walk it without tree level tests or loop grips in between
+
+void Topology::buildTreeSteps()
+{
+  treeStepLst.clear();
+
+  int sz = topoGripLst.size();
+
+  for (int i=0; i<sz; ++i) {
+    Grip *grp = topoGripLst[i];
+    if (!grp->parentRel) continue;
+
+    TreeStep step;
+    step.grip = grp;
+    step.down = grp->body1->getTreeLevel() < grp->body2->getTreeLevel();
+
+    treeStepLst.push_back(step);
+  }
+}
+
+//-------------------------------------------------------------------------------
+// Groups the joints by type, in order of first appearance
+
+void Topology::groupJoints()
+{
+  jointGroupLst.clear();
+
+  int sz = topoGripLst.size();
+
+  for (int i=0; i<sz; ++i) {
+    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+    if (!jnt) continue;
+
+    AbstractJoint::VarTrfUpdater updater = jnt->getVarTrfUpdater();
+
+    int gSz = (int)jointGroupLst.size(), g = 0;
+    while (g < gSz && jointGroupLst[g].updater != updater) g++;
+
+    if (g == gSz) {
+      jointGroupLst.push_back(JointGroup());
+      jointGroupLst[g].updater = updater;
+    }
+
+    jointGroupLst[g].jntLst.push_back(jnt);
+  }
+}
+
+//-------------------------------------------------------------------------------
+// The joint vars move to varStore, joint by joint. The joints keep
+// working on their vars as before, through their pointers.
+
+void Topology::attachJointVars()
+{
+  detachJointVars();
+
+  int sz = topoGripLst.size(), slotSz = 0;
+
+  for (int i=0; i<sz; ++i) {
+    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+    if (jnt) slotSz += jnt->varCnt;
+  }
+
+  varStore.assign(4*slotSz,0.0);
+  freeSlotLst.assign(structure->varSz,-1);
+  fixedSlotLst.assign(structure->fixedSz,-1);
+
+  for (int i=0, slot=0; i<sz; ++i) {
+    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+    if (!jnt) continue;
+
+    char mask = 0;
+
+    for (int j=0; j<jnt->varCnt; ++j) {
+      int idx = jnt->varIdx[j];
+      if (idx < 0) continue;
+
+      std::vector<int>& slotLst = jnt->fixedPos[j] ? fixedSlotLst : freeSlotLst;
+      if (idx >= (int)slotLst.size())
+        throw IndexOutOfBoundsException("Topology::attachJointVars");
+
+      slotLst[idx] = slot + j;
+      mask |= jnt->fixedPos[j] ? 2 : 1;
+    }
+
+    double *store = varStore.data() + slot;
+
+    jnt->attachVars(store,store+slotSz,store+2*slotSz,store+3*slotSz);
+
+    varJntLst.push_back(jnt);
+    varJntMask.push_back(mask);
+
+    slot += jnt->varCnt;
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void Topology::detachJointVars()
+{
+  int sz = (int)varJntLst.size();
+
+  for (int i=0; i<sz; ++i) varJntLst[i]->detachVars();
+
+  varJntLst.clear();
+  varJntMask.clear();
+
+  varStore.clear();
+  freeSlotLst.clear();
+  fixedSlotLst.clear();
+}
+
+//-------------------------------------------------------------------------------
+// vec must be sized and cleared
+
+void Topology::gatherVars(int qty, bool fixed, Vector& vec) const
+{
+  const std::vector<int>& slotLst = fixed ? fixedSlotLst : freeSlotLst;
+  const double *src = varStore.data() + qty*(varStore.size()/4);
+
+  int sz = std::min((int)slotLst.size(),vec.size());
+
+  for (int i=0; i<sz; ++i) {
+    if (slotLst[i] >= 0) vec[i] = src[slotLst[i]];
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void Topology::scatterVars(int qty, bool fixed, const Vector& vec)
+{
+  const std::vector<int>& slotLst = fixed ? fixedSlotLst : freeSlotLst;
+  double *dst = varStore.data() + qty*(varStore.size()/4);
+
+  int sz = std::min((int)slotLst.size(),vec.size());
+
+  for (int i=0; i<sz; ++i) {
+    if (slotLst[i] >= 0) dst[slotLst[i]] = vec[i];
+  }
+
+  updateJointVars(qty,fixed ? 2 : 1);
+}
+
+//-------------------------------------------------------------------------------
+
+void Topology::scatterVars(int qty, const Vector& varVec,
+                                    const Vector& fixedVec)
+{
+  double *dst = varStore.data() + qty*(varStore.size()/4);
+
+  int sz = std::min((int)freeSlotLst.size(),varVec.size());
+
+  for (int i=0; i<sz; ++i) {
+    if (freeSlotLst[i] >= 0) dst[freeSlotLst[i]] = varVec[i];
+  }
+
+  sz = std::min((int)fixedSlotLst.size(),fixedVec.size());
+
+  for (int i=0; i<sz; ++i) {
+    if (fixedSlotLst[i] >= 0) dst[fixedSlotLst[i]] = fixedVec[i];
+  }
+
+  updateJointVars(qty,3);
+}
+
+//-------------------------------------------------------------------------------
+// The joints with vars in mask recompute their trfs from the vars
+
+void Topology::updateJointVars(int qty, int mask)
+{
+  int sz = (int)varJntLst.size();
+
+  for (int i=0; i<sz; ++i) {
+    if (!(varJntMask[i] & mask)) continue;
+
+    AbstractJoint *jnt = varJntLst[i];
+
+    switch (qty) {
+      case StorePos:   jnt->setPos(); break;
+      case StoreSpeed: jnt->setSpeed(); break;
+      case StoreAccel: jnt->setAccel(); break;
+      case StoreJerk:  jnt->setJerk(); break;
+    }
+  }
+}
+
+//-------------------------------------------------------------------------------
+// All joints of a type in one go, without virtual calls per var
+
+void Topology::updateJointTrfCaches(int derivOrder)
+{
+  int sz = (int)jointGroupLst.size();
+
+  for (int i=0; i<sz; ++i) {
+    JointGroup& group = jointGroupLst[i];
+    group.updater(group.jntLst.data(),(int)group.jntLst.size(),derivOrder);
+  }
+}
+
+//-------------------------------------------------------------------------------
+
+void Topology::forEachLoop(const std::function<void(int)>& func,
+                                                  int derivOrder)
+{
+  int sz = size();
+
+  // Joints are shared by loops. Required before the concurrent loops:
+  // their lookups are const but fill caches (JntTrack: trkCursor)
+  updateJointTrfCaches(derivOrder);
+
+  if (solverOptions.threadCnt == 1 || sz < 2) {
+    for (int i=0; i<sz; ++i) func(i);
+    return;
+  }
+
+  if (!workerPool) {
+    int threadCnt = solverOptions.threadCnt;
+
+    if (threadCnt < 1) threadCnt = (int)std::thread::hardware_concurrency();
+    if (threadCnt > sz) threadCnt = sz;
+
+    workerPool = new WorkerPool(threadCnt);
+  }
+
+  workerPool->run(sz,func);
+}
+
+//-------------------------------------------------------------------------------
+// Composes the Jacobian and residual of one loop.
+// Touches nothing shared with the other loops, see forEachLoop()
+
+bool Topology::composePosMatrixRow(const GripList& grpLst,
+                                   LoopJacobian& loopJac,
+                                   double& maxRot, double& maxDist)
+{
+  for (int i=0; i<6; ++i) loopJac.res[i] = 0.0;
+
+  Trf3 loopTrf;
+  if (!grpLst.setPreTrfs(loopTrf)) return false;
+
+  updateDists(loopTrf,maxRot,maxDist);
+
+  addSol(loopTrf,loopJac.res);
+
+  Body *body = grpLst.firstBody();
+  if (!body) return false;
+
+  Trf3 curTrf;
+
+  int grpSz = grpLst.size();
+  int n = 0, colCnt = loopJac.size();
+
+  for (int i=grpSz-1; i>=0; --i) {
+    Grip& grp = *grpLst[i];
+
+    bool atBody1 = body == grp.getBody1();
+
+    if (atBody1) curTrf.preMultWith(grp.getPos1());
+    else curTrf.preMultWith(grp.getPos2());
+
+    const Trf3& preTrf = grpLst.getPreTrf(i);
+    AbstractJoint& jnt = *grp.getJoint();
+
+    int varCnt = jnt.getVarCnt();
+
+    for (int j=0; j<varCnt; ++j) {
+      if (jnt.getFixed(j)) continue;
+
+      // Fixed vars changed since prepare()?
+      if (n >= colCnt || loopJac.idxLst[loopJac.slotLst[n]] != jnt.getVarIdx(j))
+        throw IllegalStateException("Topology::composePosMatrixRow");
+
+      Trf3 trf(curTrf);
+
+      if (atBody1) trf.preMultWith(jnt.getDerivative(j));
+      else trf.preMultWith(jnt.getInvDerivative(j));
+
+      trf.preMultWith(preTrf);
+
+      loopJac.setColumn(n++,trf); // Six matrix rows
+    }
+
+    if (atBody1) {
+      curTrf.preMultWith(jnt.pos);
+      curTrf.preMultWith(grp.getInvPos2());
+    }
+    else {
+      curTrf.preMultWith(jnt.invPos);
+      curTrf.preMultWith(grp.getInvPos1());
+    }
+
+    body = grp.getOtherBody(*body);
+  }
+
+  if (n != colCnt) throw IllegalStateException("Topology::composePosMatrixRow");
+
+  loopJac.composeProduct();
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+// Adds JT-J and -JT-res of one loop to the matrix and rhs
+
+void Topology::addPosMatrixRow(const LoopJacobian& loopJac)
+{
+  loopJac.subtractProjection(loopJac.res,ctx.rhs);
+
+  int sz = loopJac.size();
+  int prodSz = (int)loopJac.prodLst.size();
+
+  const double *prod = loopJac.prodLst.data();
+
+  if (useSparse()) {
+    const int *pos = loopJac.posLst.data();
+
+    for (int p=0; p<prodSz; ++p) ctx.sparseMat.addAt(pos[p],prod[p]);
+  }
+  else {
+    for (int c=0; c<sz; ++c) {
+      int colIdx = loopJac.idxLst[c];
+
+      // Store element of AT-A, optimized storage, see Matrix::solveLDLT()
+      for (int r=c; r<sz; ++r)
+        ctx.solMat(colIdx,loopJac.idxLst[r]-colIdx) += *prod++;
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+// The loops are composed concurrently if so configured, their
+// contributions are then added in loop order: the result does not
+// depend on the nr of threads
+
+bool Topology::composePosEq(double& maxRot, double& maxDist, int& maxIdx,
+                                                             double& resNorm)
+{
+  maxRot  = 0.0;
+  maxDist = 0.0;
+  maxIdx = -1;
+  resNorm = 0.0;
+
+  if (useSparse()) ctx.sparseMat.clear();
+  else ctx.solMat.clear();
+
+  ctx.rhs.clear();
+
+  topoGripLst.clearJointTrfCaches();
+
+  // model.func_lst.updateAllPos();
+
+  int sz = size();
+
+  std::vector<double> rotLst(sz,0.0), distLst(sz,0.0);
+  std::vector<char> okLst(sz,0);
+
+  forEachLoop([&](int i) {
+    okLst[i] = composePosMatrixRow(*get(i),ctx.loopJacLst[i],rotLst[i],distLst[i]);
+  });
+
+  bool ok = true;
+
+  for (int i=0; i<sz; i++) {
+    if (!okLst[i]) ok = false;
+
+    maxRot = std::max(maxRot,rotLst[i]);
+
+    if (distLst[i] > maxDist) {
+      maxDist = distLst[i];
+      maxIdx = i;
+    }
+
+    const LoopJacobian& loopJac = ctx.loopJacLst[i];
+
+    for (int j=0; j<6; ++j) resNorm += sqr(loopJac.res[j]);
+
+    if (okLst[i]) addPosMatrixRow(loopJac);
+  }
+
+  resNorm = sqrt(resNorm);
+
+  return ok;
+}
+
+//---------------------------------------------------------------------------
+// Right hand side only, using the loop Jacobians of an earlier
+// composePosEq() (Chord Newton)
+
+bool Topology::composePosRhs(double& maxRot, double& maxDist, int& maxIdx,
+                                                              double& resNorm)
+{
+  maxRot  = 0.0;
+  maxDist = 0.0;
+  maxIdx = -1;
+  resNorm = 0.0;
+
+  ctx.rhs.clear();
+
+  int sz = size();
+
+  std::vector<double> rotLst(sz,0.0), distLst(sz,0.0);
+  std::vector<char> okLst(sz,0);
+
+  forEachLoop([&](int i) {
+    Trf3 loopTrf;
+    if (!get(i)->setPreTrfs(loopTrf)) return;
+
+    updateDists(loopTrf,rotLst[i],distLst[i]);
+
+    LoopJacobian& loopJac = ctx.loopJacLst[i];
+
+    for (int j=0; j<6; ++j) loopJac.res[j] = 0.0;
+    addSol(loopTrf,loopJac.res);
+
+    okLst[i] = true;
+  },0); // Residual only, no derivatives
+
+  bool ok = true;
+
+  for (int i=0; i<sz; i++) {
+    if (!okLst[i]) {
+      ok = false;
+      continue;
+    }
+
+    maxRot = std::max(maxRot,rotLst[i]);
+
+    if (distLst[i] > maxDist) {
+      maxDist = distLst[i];
+      maxIdx = i;
+    }
+
+    const LoopJacobian& loopJac = ctx.loopJacLst[i];
+
+    for (int j=0; j<6; ++j) resNorm += sqr(loopJac.res[j]);
+
+    loopJac.subtractProjection(loopJac.res,ctx.rhs);
+  }
+
+  resNorm = sqrt(resNorm);
+
+  return ok;
+}
+
+//---------------------------------------------------------------------------
+
+void Topology::limitSolution(Vector& sol)
+{
+  double maxAng = atan(1.0)/4.5;  // 10 degrees
+
+  double maxRot = 0.0;
+
+  for (int i=0; i<structure->varSz; ++i) {
+    if (structure->angularVar[i]) {
+      double val = fabs(sol[i]);
+
+      if (val > maxRot)
+        maxRot = val;
+    }
+  }
+
+  if (maxRot > maxAng) sol *= (maxAng/maxRot); 
+}
+
+//---------------------------------------------------------------------------
+// In place LDLT factorization of a symmetric band matrix,
+// storage as in Matrix::solveLDLT(): mat(col,row-col)
+// On return mat(i,0) holds D(i) and mat(col,row-col) holds L(row,col)
+
+static bool factorBandLDLT(Matrix& mat, int sz, int bw)
+{
+  for (int j=0; j<sz; ++j) {
+    int lwb = std::max(0,j-bw+1);
+
+    double d = mat(j,0);
+    for (int k=lwb; k<j; ++k) d -= sqr(mat(k,j-k)) * mat(k,0);
+
+    if (d == 0.0) return false;
+
+    mat(j,0) = d;
+
+    int upb = std::min(sz,j+bw);
+
+    for (int i=j+1; i<upb; ++i) {
+      double l = mat(j,i-j);
+
+      for (int k=i-bw+1; k<j; ++k) {
+        if (k < 0) continue;
+        l -= mat(k,i-k) * mat(k,j-k) * mat(k,0);
+      }
+
+      mat(j,i-j) = l/d;
+    }
+  }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+// Solves in place, mat as returned by factorBandLDLT()
+
+static void solveBandLDLT(const Matrix& mat, int sz, int bw, Vector& sol)
+{
+  for (int i=1; i<sz; ++i) {
+    int lwb = std::max(0,i-bw+1);
+
+    double v = sol[i];
+    for (int k=lwb; k<i; ++k) v -= mat(k,i-k) * sol[k];
+
+    sol[i] = v;
+  }
+
+  for (int i=0; i<sz; ++i) sol[i] /= mat(i,0);
+
+  for (int i=sz-2; i>=0; --i) {
+    int upb = std::min(sz,i+bw);
+
+    double v = sol[i];
+    for (int k=i+1; k<upb; ++k) v -= mat(i,k-i) * sol[k];
+
+    sol[i] = v;
+  }
+}
+
+//---------------------------------------------------------------------------
+// Factors solMat (or sparseMat) as composed by composePosEq() into
+// posFactor, with damping * diag added to the diagonal
+
+bool Topology::factorPosMatrix(double damping)
+{
+  bool ok;
+
+  if (useSparse()) ok = ctx.sparseMat.factor(damping);
+  else {
+    ctx.posFactor = ctx.solMat;
+
+    if (damping != 0.0) {
+      for (int i=0; i<structure->varSz; ++i)
+        ctx.posFactor(i,0) += damping * std::max(ctx.solMat(i,0),1.0e-12);
+    }
+
+    ok = factorBandLDLT(ctx.posFactor,structure->varSz,structure->colSz);
+  }
+
+  ctx.posFactorDamping = damping;
+  ctx.posFactorValid   = ok && damping == 0.0; // Else not the plain matrix
+  ctx.chordFactorValid = ok;
+  ctx.posFactorVersion = model->getPosVersion();
+
+  return ok;
+}
+
+//---------------------------------------------------------------------------
+
+void Topology::solvePosFactor(Vector& sol) const
+{
+  if (useSparse()) ctx.sparseMat.solve(sol);
+  else solveBandLDLT(ctx.posFactor,structure->varSz,structure->colSz,sol);
+}
+
+//---------------------------------------------------------------------------
+// Makes sure posFactor and loopJacLst belong to the current positions
+
+bool Topology::preparePosFactor()
+{
+  // Positions set by AbstractJoint::setVal() since the factorization:
+  if (ctx.posFactorVersion != model->getPosVersion()) {
+    ctx.posFactorValid   = false;
+    ctx.chordFactorValid = false;
+  }
+
+  if (ctx.posFactorValid) return true;
+  if (!posValid || structure->rowSz < 1 || structure->colSz < 1 || structure->varSz < 1) return false;
+
+  sizeMats();
+
+  double maxRot=0.0, maxDist=0.0, resNorm=0.0;
+  int maxIdx = -1;
+
+  if (!composePosEq(maxRot,maxDist,maxIdx,resNorm)) return false;
+
+  ctx.solMat2 = ctx.solMat;
+  ctx.solRhs2 = ctx.rhs;
+
+  return factorPosMatrix();
+}
+
+//---------------------------------------------------------------------------
+// Residual norm as predicted by the linearized loop equations
+
+double Topology::predictedResidual(const Vector& step) const
+{
+  double resSqr = 0.0;
+
+  int sz = size();
+
+  for (int i=0; i<sz; i++) {
+    const LoopJacobian& loopJac = ctx.loopJacLst[i];
+
+    double v[6];
+    for (int j=0; j<6; ++j) v[j] = loopJac.res[j];
+
+    loopJac.addProduct(step,v);
+
+    for (int j=0; j<6; ++j) resSqr += sqr(v[j]);
+  }
+
+  return sqrt(resSqr);
+}
+
+//---------------------------------------------------------------------------
+// Levenberg-Marquardt step (trust region):
+// Solves (AT-A + damping * diag(AT-A)) step = rhs and accepts the step
+// only if the actual residual reduction is a reasonable fraction of the
+// predicted reduction, else the damping is increased and retried.
+
+bool Topology::dampedStep(bool refactor, double resNorm, double& damping,
+                          double& dampFac, Vector& varPosVec)
+{
+  const double minGain = 1.0e-4;
+
+  getPosVector(varPosVec);
+
+  Vector basePos(structure->varSz);
+  basePos = varPosVec;
+
+  Vector step(structure->varSz);
+
+  for (int tries=0; tries<solverOptions.maxStepTries; ++tries) {
+    if (refactor || damping != ctx.posFactorDamping) {
+      if (!factorPosMatrix(damping)) return false;
+
+      refactor = false;
+    }
+
+    step = ctx.rhs;
+    solvePosFactor(step);
+
+    double prdNorm = predictedResidual(step);
+
+    varPosVec = basePos;
+    varPosVec += step;
+    setPosVector(varPosVec);
+    updatePositions();
+
+    double newNorm;
+    if (!calcPosResidual(newNorm)) return false;
+
+    double prdRed = sqr(resNorm) - sqr(prdNorm);
+    double actRed = sqr(resNorm) - sqr(newNorm);
+
+    double gain = prdRed > 0.0 ? actRed/prdRed : 0.0;
+
+    if (gain > minGain || newNorm <= resNorm) {
+      double t = 2.0*std::min(gain,1.0) - 1.0;
+
+      damping *= std::max(1.0/3.0, 1.0 - t*t*t);
+      dampFac = 2.0;
+
+      return true;
+    }
+
+    if (damping <= 0.0) damping = solverOptions.initDamping;
+    else damping *= dampFac;
+
+    dampFac *= 2.0;
+  }
+
+  varPosVec = basePos;
+  setPosVector(varPosVec);
+  updatePositions();
+
+  return false;
+}
+
+//---------------------------------------------------------------------------
+
+Sequence& Topology::newSequence(const wchar_t *name)
+{
+  Sequence *seq = new Sequence(*this,name);
+  seqLst.add(seq);
+
+  return *seq;
+}
+
+//---------------------------------------------------------------------------
+
+void Topology::setSolverOptions(const SolverOptions& options)
+{
+  if (options.matrixMode != solverOptions.matrixMode) {
+    ctx.posFactorValid   = false;
+    ctx.chordFactorValid = false;
+  }
+
+  if (options.threadCnt != solverOptions.threadCnt) {
+    delete workerPool; workerPool = NULL;
+  }
+
+  solverOptions = options;
+}
+
+//---------------------------------------------------------------------------
+
+bool Topology::calcPosResidual(double& resNorm) const
+{
+  resNorm = 0.0;
+
+  int sz = size();
+
+  for (int i=0; i<sz; i++) {
+    Trf3 loopTrf;
+    if (!get(i)->setPreTrfs(loopTrf)) return false;
+
+    double res[6] = { 0,0,0,0,0,0 };
+    addSol(loopTrf,res);
+
+    for (int j=0; j<6; ++j) resNorm += sqr(res[j]);
+  }
+
+  resNorm = sqrt(resNorm);
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+// Taylor predictor: extrapolates the free vars from the last converged
+// position, speed and accel to the current fixed var values.
+// The time step is the one that best matches the fixed var displacement.
+// Returns the residual of the unpredicted position in startResNorm
+
+bool Topology::predictPos(double& startResNorm)
+{
+  if (!ctx.prdPosValid || !ctx.prdSpeedValid) return false;
+
+  if (ctx.prdPos.size() != structure->varSz || ctx.prdFixedPos.size() != structure->fixedSz ||
+      ctx.prdSpeed.size() != structure->varSz || ctx.prdFixedSpeed.size() != structure->fixedSz)
+    return false;
+
+  Vector fixedPosVec(structure->fixedSz);
+  if (!getPosVector(fixedPosVec,true)) return false;
+
+  double num = 0.0, den = 0.0;
+
+  for (int i=0; i<structure->fixedSz; ++i) {
+    num += ctx.prdFixedSpeed[i] * (fixedPosVec[i] - ctx.prdFixedPos[i]);
+    den += sqr(ctx.prdFixedSpeed[i]);
+  }
+
+  if (den <= 0.0) return false;
+
+  double h = num/den;
+
+  if (!calcPosResidual(startResNorm)) return false;
+
+  Vector varPosVec(structure->varSz);
+  varPosVec = ctx.prdPos;
+
+  for (int i=0; i<structure->varSz; ++i) varPosVec[i] += ctx.prdSpeed[i] * h;
+
+  if (solverOptions.predictorOrder > 1 && ctx.prdAccelValid &&
+                                           ctx.prdAccel.size() == structure->varSz) {
+    double hh = sqr(h)/2.0;
+
+    for (int i=0; i<structure->varSz; ++i) varPosVec[i] += ctx.prdAccel[i] * hh;
+  }
+
+  setPosVector(varPosVec);
+  updatePositions();
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+// The saved iterations are estimated from the residual reduction
+// by the predictor and the mean contraction rate of this solve
+
+void Topology::updateSolverStats(int iter, bool predicted,
+                                 double startResNorm, double prdResNorm,
+                                 double endResNorm)
+{
+  solverStats.solveCnt++;
+  solverStats.iterCnt += iter;
+
+  if (!predicted) return;
+
+  solverStats.predictCnt++;
+
+  if (iter < 1 || startResNorm <= 0.0 || prdResNorm <= 0.0 ||
+                 endResNorm <= 0.0 || endResNorm >= prdResNorm) return;
+
+  double logRate = log(endResNorm/prdResNorm)/iter;
+
+  solverStats.itersSaved += log(prdResNorm/startResNorm)/logRate;
+}
+
+//---------------------------------------------------------------------------
+
+bool Topology::solvePos(int maxIter, double rotTol, double posTol,
+                                                Vector& varPosVec, int& iter)
+{
+  if (structure->rowSz < 1 || structure->colSz < 1 || structure->varSz < 1) {
+    posValid   = false;
+    speedValid = false;
+    accelValid = false;
+    jerkValid  = false;
+
+    return false;
+  }
+
+  posValid = true;
+  ctx.posFactorValid = false;
+  varPosVec.setSize(structure->varSz);
+
+  sizeMats();
+
+  bool chord = solverOptions.newtonMode == SolverOptions::ChordNewton;
+  bool trust = solverOptions.stepControl == SolverOptions::TrustRegion;
+
+  double damping = solverOptions.initDamping, dampFac = 2.0;
+
+  double startResNorm = 0.0, prdResNorm = 0.0;
+  bool predicted = false;
+
+  if (solverOptions.predictorOrder > 0) predicted = predictPos(startResNorm);
+
+  ctx.prdPosValid   = false;
+  ctx.prdSpeedValid = false;
+  ctx.prdAccelValid = false;
+
+  double maxRot=0.0, maxDist=0.0, resNorm=0.0, lastResNorm=0.0;
+  int maxIdx = -1;
+
+  for (iter=0; iter<maxIter; ++iter) {
+
+    // In chord mode the factor of an earlier iteration or
+    // an earlier call (previous drive step) is reused
+
+    bool composed = !chord || !ctx.chordFactorValid;
+
+    if (composed) {
+      if (!composePosEq(maxRot,maxDist,maxIdx,resNorm))
+        return false;
+    }
+    else if (!composePosRhs(maxRot,maxDist,maxIdx,resNorm))
+      return false;
+
+    if (iter > 0) {
+      if (maxRot <= rotTol && maxDist <= posTol) {
+        if (composed) {
+          ctx.solMat2 = ctx.solMat;
+          ctx.solRhs2 = ctx.rhs;
+
+          factorPosMatrix();
+        }
+        else { // Chord: no matrix of these positions (see preparePosFactor)
+          ctx.solMat2.resize(0,0);
+          ctx.solRhs2.setSize(0);
+        }
+
+        updateSolverStats(iter,predicted,startResNorm,prdResNorm,resNorm);
+
+        ctx.prdPos = varPosVec;
+        ctx.prdPosValid = getPosVector(ctx.prdFixedPos,true);
+
+        return true;
+      }
+    }
+    else prdResNorm = resNorm;
+
+    if (!composed && iter > 0 &&
+                     resNorm > solverOptions.maxContraction * lastResNorm) {
+      // Contraction degraded, refactor at the current positions
+      if (!composePosEq(maxRot,maxDist,maxIdx,resNorm))
+        return false;
+
+      composed = true;
+    }
+
+    lastResNorm = resNorm;
+
+    if (trust) {
+      if (!dampedStep(composed,resNorm,damping,dampFac,varPosVec)) break;
+
+      continue;
+    }
+
+    if (chord) {
+      if ((composed || ctx.posFactorDamping != 0.0) && !factorPosMatrix()) break;
+
+      solvePosFactor(ctx.rhs);
+    }
+    else if (useSparse()) {
+      if (!factorPosMatrix()) break;
+
+      solvePosFactor(ctx.rhs);
+    }
+    else ctx.solMat.solveLDLT(ctx.rhs);
+
+    limitSolution(ctx.rhs);
+
+    // double len = rhs.len();
+
+    getPosVector(varPosVec);
+    varPosVec += ctx.rhs;
+    setPosVector(varPosVec);
+    updatePositions();
+  }
+
+  posValid = false;
+  ctx.chordFactorValid = false;
+  varPosVec.setSize(0);
 
   return false;
 }
@@ -799,18 +1839,12 @@ bool Topology::getPosVector(Vector& posVec, bool fixed) const
     return false;
   }
 
-  if (fixed) posVec.setSize(fixedSz);
-  else posVec.setSize(varSz);
+  if (fixed) posVec.setSize(structure->fixedSz);
+  else posVec.setSize(structure->varSz);
 
   posVec.clear();
 
-  int grpSz = topoGripLst.size();
-
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
-
-    if (jnt) jnt->getVars(fixed, posVec);
-  }
+  gatherVars(StorePos,fixed,posVec);
 
   return true;
 }
@@ -819,24 +1853,21 @@ bool Topology::getPosVector(Vector& posVec, bool fixed) const
 
 void Topology::setPosVector(const Vector& posVec, bool fixed)
 {
+  ctx.posFactorValid = false;
+  ctx.prdPosValid    = false;
+
   speedValid = false;
   accelValid = false;
   jerkValid  = false;
 
-  if (posVec.size() != (fixed ? fixedSz : varSz)) {
+  if (posVec.size() != (fixed ? structure->fixedSz : structure->varSz)) {
     posValid = false;
     return;
   }
 
   posValid = true;
 
-  int grpSz = topoGripLst.size();
-
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
-
-    if (jnt) jnt->setVars(fixed,posVec);
-  }
+  scatterVars(StorePos,fixed,posVec);
 }
 
 //---------------------------------------------------------------------------
@@ -844,181 +1875,381 @@ void Topology::setPosVector(const Vector& posVec, bool fixed)
 void Topology::setPosVectors(const Vector& varPosVec,
                                                   const Vector& fixedPosVec)
 {
+  ctx.posFactorValid = false;
+  ctx.prdPosValid    = false;
+
   speedValid = false;
   accelValid = false;
   jerkValid  = false;
 
-  if (varPosVec.size() != varSz || fixedPosVec.size() != fixedSz) {
+  if (varPosVec.size() != structure->varSz || fixedPosVec.size() != structure->fixedSz) {
     posValid = false;
     return;
   }
 
-  posValid = true;
-
-  int grpSz = topoGripLst.size();
+  posValid = true;
+
+  scatterVars(StorePos,varPosVec,fixedPosVec);
+}
+
+//---------------------------------------------------------------------------
+
+static void updatePos(Grip& grip, bool down)
+{
+  Body *body1 = grip.getBody1();
+  Body *body2 = grip.getBody2();
+
+  if (down) {
+    Trf3 trf(body1->getPos());
+
+    trf.preMultWith(grip.getPos1());
+    trf.preMultWith(grip.getJoint()->getPos());
+    trf.preMultWith(grip.getInvPos2());
+
+    grip.getBody2()->setPos(trf);
+  }
+  else {
+    Trf3 trf(body2->getPos());
+
+    trf.preMultWith(grip.getPos2());
+    trf.preMultWith(grip.getJoint()->getInvPos());
+    trf.preMultWith(grip.getInvPos1());
+
+    grip.getBody1()->setPos(trf);
+  }
+}
+
+//---------------------------------------------------------------------------
+
+bool Topology::updatePositions() const
+{
+  if (!posValid) return false;
+
+  int sz = (int)treeStepLst.size();
+
+  for (int i=0; i<sz; ++i) {
+    const TreeStep& step = treeStepLst[i];
+    updatePos(*step.grip,step.down);
+  }
+
+  return true;
+}
+
+
+//-------------------------------------------------------------------------------
+// rhs -= JT-diff for each loop, six elements of diffLst per loop,
+// in loop order
+
+bool Topology::subtractLoopProjections(const std::vector<double>& diffLst,
+                                       const std::vector<char>& okLst)
+{
+  bool ok = true;
+  int sz = size();
+
+  for (int i=0; i<sz; i++) {
+    if (okLst[i]) ctx.loopJacLst[i].subtractProjection(&diffLst[6*i],ctx.rhs);
+    else ok = false;
+  }
+
+  return ok;
+}
+
+//-------------------------------------------------------------------------------
+
+bool Topology::composeSpeedRhsRow(const GripList& grpLst, double *spDiff)
+{
+  Trf3 curTrf;
+  if (!grpLst.setPreTrfs(curTrf)) return false;
+
+  Body *body = grpLst.firstBody();
+  if (!body) return false;
+
+  curTrf.init();
+
+  for (int i=0; i<6; ++i) spDiff[i] = 0.0;
+
+  int grpSz = grpLst.size();
+
+  for (int i=grpSz-1; i>=0; --i) {
+    Grip& grp = *grpLst[i];
+
+    bool atBody1 = body == grp.getBody1();
+
+    if (atBody1) curTrf.preMultWith(grp.getPos1());
+    else curTrf.preMultWith(grp.getPos2());
+
+    const Trf3& preTrf = grpLst.getPreTrf(i);
+    AbstractJoint& jnt = *grp.getJoint();
+
+    int varCnt = jnt.getVarCnt();
+
+    for (int j=0; j<varCnt; j++) {
+      if (!jnt.getFixed(j)) continue; // Only fixed vars
+
+      Trf3 trf(curTrf);
+
+      Trf3 jntTrf;
+
+      if (atBody1) jntTrf = jnt.getDerivative(j);
+      else jntTrf = jnt.getInvDerivative(j);
+
+      jntTrf *= jnt.getSpeed(j);
+
+      trf.preMultWith(jntTrf);
+      trf.preMultWith(preTrf);
+
+      addSol(trf, spDiff);
+    }
+
+    if (atBody1) {
+      curTrf.preMultWith(jnt.pos);
+      curTrf.preMultWith(grp.getInvPos2());
+    }
+    else {
+      curTrf.preMultWith(jnt.invPos);
+      curTrf.preMultWith(grp.getInvPos1());
+    }
+
+    body = grp.getOtherBody(*body);
+  }
+
+  return true;
+}
+
+//-------------------------------------------------------------------------------
+// Only the right hand side, the matrix is the factored position matrix
+
+bool Topology::composeSpeedRhs()
+{
+  ctx.rhs.setSize(structure->varSz);
+  ctx.rhs.clear();
+
+  // model.func_lst.updateAllDer();
+
+  int sz = size();
+
+  std::vector<double> diffLst(6*sz,0.0);
+  std::vector<char> okLst(sz,0);
+
+  forEachLoop([&](int i) {
+    okLst[i] = composeSpeedRhsRow(*get(i),&diffLst[6*i]);
+  });
+
+  return subtractLoopProjections(diffLst,okLst);
+}
+
+//-------------------------------------------------------------------------------
+
+bool Topology::solveSpeed(Vector& speedVec, bool write)
+{
+  speedValid = false;
+  accelValid = false;
+  jerkValid  = false;
+
+  if (!posValid) return false;
+
+  speedVec.setSize(structure->varSz);
+
+  if (!preparePosFactor()) return false;
+  if (!composeSpeedRhs()) return false;
+
+  ctx.speedRhs2 = ctx.rhs;
+
+  solvePosFactor(ctx.rhs);
+
+  speedVec = ctx.rhs;
+
+  updateSpeeds();
+
+  speedValid = true;
+
+  if (ctx.prdPosValid) {
+    ctx.prdSpeed = speedVec;
+
+    ctx.prdFixedSpeed.setSize(structure->fixedSz);
+    ctx.prdFixedSpeed.clear();
+
+    gatherVars(StoreSpeed,true,ctx.prdFixedSpeed);
+
+    ctx.prdSpeedValid = true;
+    ctx.prdAccelValid = false;
+  }
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+bool Topology::getSpeedVector(Vector& speedVec, bool fixed) const
+{
+  if (!speedValid) {
+    speedVec.setSize(0);
+    return false;
+  }
+
+  if (fixed) speedVec.setSize(structure->fixedSz);
+  else speedVec.setSize(structure->varSz);
+
+  speedVec.clear();
+
+  gatherVars(StoreSpeed,fixed,speedVec);
+
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+void Topology::setSpeedVector(const Vector& speedVec, bool fixed)
+{
+  accelValid = false;
+  jerkValid  = false;
+
+  if (speedVec.size() != (fixed ? structure->fixedSz : structure->varSz)) {
+    speedValid = false;
+    return;
+  }
+
+  speedValid = true;
+
+  scatterVars(StoreSpeed,fixed,speedVec);
+}
+
+//---------------------------------------------------------------------------
+
+void Topology::setSpeedVectors(const Vector& varSpeedVec,
+                                              const Vector& fixedSpeedVec)
+{
+  accelValid = false;
+  jerkValid  = false;
+
+  if (varSpeedVec.size() != structure->varSz || fixedSpeedVec.size() != structure->fixedSz) {
+    speedValid = false;
+    return;
+  }
+
+  speedValid = true;
 
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
-    if (!jnt) continue;
-    
-    jnt->setVars(varPosVec,fixedPosVec);
-  }
+  scatterVars(StoreSpeed,varSpeedVec,fixedSpeedVec);
 }
 
 //---------------------------------------------------------------------------
 
-static void updatePos(Grip& grip)
+static void updateSpeed(Grip& grip, bool down)
 {
   Body *body1 = grip.getBody1();
   Body *body2 = grip.getBody2();
 
-  if (body1->getTreeLevel() < body2->getTreeLevel()) {
-    Trf3 trf(body1->getPos());
+  if (down) {
+    Trf3 pos(body1->getPos());
+    Trf3 speed(body1->getSpeed());
 
-    trf.preMultWith(grip.getPos1());
-    trf.preMultWith(grip.getJoint()->getPos());
-    trf.preMultWith(grip.getInvPos2());
+    pos.preMultWith(grip.getPos1());
+    speed.preMultWith(grip.getPos1());
 
-    grip.getBody2()->setPos(trf);
+    speed.preMultWith(grip.getJoint()->getPos());
+    pos.preMultWith(grip.getJoint()->getDer());
+    speed += pos;
+
+    speed.preMultWith(grip.getInvPos2());
+
+    body2->setSpeed(speed);
   }
   else {
-    Trf3 trf(body2->getPos());
+    Trf3 pos(body2->getPos());
+    Trf3 speed(body2->getSpeed());
 
-    trf.preMultWith(grip.getPos2());
-    trf.preMultWith(grip.getJoint()->getInvPos());
-    trf.preMultWith(grip.getInvPos1());
+    pos.preMultWith(grip.getPos2());
+    speed.preMultWith(grip.getPos2());
 
-    grip.getBody1()->setPos(trf);
+    speed.preMultWith(grip.getJoint()->getInvPos());
+    pos.preMultWith(grip.getJoint()->getInvDer());
+    speed += pos;
+
+    speed.preMultWith(grip.getInvPos1());
+
+    body1->setSpeed(speed);
   }
 }
 
 //---------------------------------------------------------------------------
 
-bool Topology::updatePositions() const
+bool Topology::updateSpeeds()
 {
-  if (!posValid) return false;
+  if (!speedValid) return false;
 
-  int sz = topoGripLst.size();
+  int sz = (int)treeStepLst.size();
 
   for (int i=0; i<sz; ++i) {
-    Grip *grp = topoGripLst[i];
-    if (!grp->parentRel) continue;
-
-    updatePos(*grp);
+    const TreeStep& step = treeStepLst[i];
+    updateSpeed(*step.grip,step.down);
   }
 
   return true;
 }
 
-//-------------------------------------------------------------------------------
-
-static void addSol(const Trf3& trf, double *v)
-{
-  v[0] += trf(0,2);
-  v[1] += trf(1,0);
-  v[2] += trf(2,1);
-  v[3] += trf(0,3);
-  v[4] += trf(1,3);
-  v[5] += trf(2,3);
-}
-
-//-------------------------------------------------------------------------------
+//---------------------------------------------------------------------------
 
-bool Topology::composeSpeedMatrixRow(const GripList& grpLst)
+bool Topology::composeAccelRhsRow(const GripList& grpLst, double *accDiff)
 {
   Trf3 curTrf;
   if (!grpLst.setPreTrfs(curTrf)) return false;
 
+  int grpSz = grpLst.size();
+  if (grpSz < 1) return false;
+
   Body *body = grpLst.firstBody();
   if (!body) return false;
 
-  enum { MaxAllocaSz = 32000 }; // Max nr of items on stack
-
-  int idxLstSz = 0;
-  int *idxLst;
- 
-  if (varSz > MaxAllocaSz) idxLst = new int[varSz];
-  else idxLst = (int *)_malloca(varSz*sizeof(int));
-
-  if (!idxLst) throw NullPointerException("idxlst");
-
-  for (int i=0; i<varSz; ++i) idxLst[i] = -1;
-
   curTrf.init();
+ 
+  Trf3 secDer, der;
 
-  int grpSz = grpLst.size();
+  for (int i=0; i<6; ++i) accDiff[i] = 0.0;
 
-  for (int i=grpSz-1; i>=0; --i) {
+  for (int i=grpSz-1; i>=0; i--) {
     Grip& grp = *grpLst[i];
+    AbstractJoint& jnt = *grp.getJoint();
 
-    bool atBody1 = body == grp.getBody1();
+    Trf3 accSum;
+    accSum.zero();
 
-    if (atBody1) curTrf.preMultWith(grp.getPos1());
-    else curTrf.preMultWith(grp.getPos2());
+    bool atBody1 = body == grp.getBody1();
 
-    const Trf3& preTrf = grpLst.getPreTrf(i);
-    AbstractJoint& jnt = *grp.getJoint();
+    if (atBody1) {
+      curTrf.preMultWith(grp.getPos1());
+      jnt.getAccMixed(accSum);
+    }
+    else {
+      curTrf.preMultWith(grp.getPos2());
+      jnt.getInvAccMixed(accSum);
+    }
 
-    double spDiff[6] = { 0,0,0,0,0,0 };
-    
     int varCnt = jnt.getVarCnt();
 
-    for (int j=0; j<varCnt; j++) {
-      if (!jnt.getFixed(j)) continue; // Only fixed vars
-
-      Trf3 trf(curTrf);
+    for (int j=0; j<varCnt; ++j) {
+      if (atBody1) jnt.getSecDerivative(j,secDer);
+      else jnt.getInvSecDerivative(j,secDer);
 
-      Trf3 jntTrf;
+      secDer *= sqr(jnt.getSpeed(j));
+      accSum += secDer;
 
-      if (atBody1) jntTrf = jnt.getDerivative(j);
-      else jntTrf = jnt.getInvDerivative(j);
+      if (!jnt.getFixed(j)) continue;
 
-      jntTrf *= jnt.getSpeed(j);
+      // Only fixed vars:
 
-      trf.preMultWith(jntTrf);
-      trf.preMultWith(preTrf);
+      if (atBody1) der = jnt.getDerivative(j);
+      else der = jnt.getInvDerivative(j);
 
-      addSol(trf, spDiff);
+      der *= jnt.getAccel(j);
+      accSum += der;
     }
 
-    for (int j=0; j<varCnt; j++) {
-      if (jnt.getFixed(j)) continue; // Only free vars
-
-      Trf3 trf(curTrf);
-
-      if (atBody1) trf.preMultWith(jnt.getDerivative(j));
-      else trf.preMultWith(jnt.getInvDerivative(j));
+    accSum *= curTrf;
 
-      trf.preMultWith(preTrf);
+    const Trf3& preTrf = grpLst.getPreTrf(i);
+    accSum.preMultWith(preTrf);
 
-      int varIdx = jnt.getVarIdx(j);
-
-      // Six matrix rows
-      prepMat(0,varIdx) = trf(0,2);
-      prepMat(1,varIdx) = trf(1,0);
-      prepMat(2,varIdx) = trf(2,1);
-      prepMat(3,varIdx) = trf(0,3);
-      prepMat(4,varIdx) = trf(1,3);
-      prepMat(5,varIdx) = trf(2,3);
-
-      rhs[varIdx] -= spDiff[0];
-      rhs[varIdx] -= spDiff[1];
-      rhs[varIdx] -= spDiff[2];
-      rhs[varIdx] -= spDiff[3];
-      rhs[varIdx] -= spDiff[4];
-      rhs[varIdx] -= spDiff[5];
-
-      //rhs[varIdx] -= trf(0,2) * spDiff[0];
-      //rhs[varIdx] -= trf(1,0) * spDiff[1];
-      //rhs[varIdx] -= trf(2,1) * spDiff[2];
-      //rhs[varIdx] -= trf(0,3) * spDiff[3];
-      //rhs[varIdx] -= trf(1,3) * spDiff[4];
-      //rhs[varIdx] -= trf(2,3) * spDiff[5];
-
-      if (!idxLst) throw NullPointerException("idxlst");
-
-      idxLst[idxLstSz++] = varIdx;
-    }
+    addSol(accSum, accDiff);
 
     if (atBody1) {
       curTrf.preMultWith(jnt.pos);
@@ -1032,219 +2263,174 @@ bool Topology::composeSpeedMatrixRow(const GripList& grpLst)
     body = grp.getOtherBody(*body);
   }
 
-  for (int i=0; i<6; ++i) {
-    for (int j=0; j<idxLstSz; ++j) {
-      int colIdx = idxLst[j];
-
-      double m = prepMat(i,colIdx);
-
-      for (int k=0; k<idxLstSz; ++k) {
-        int rowIdx = idxLst[k];
-        if (rowIdx < colIdx) continue;
-
-        // Store element of AT-A, optimized storage, see Matrix::solveLDLT()
-        solMat(colIdx,rowIdx-colIdx) += m * prepMat(i,rowIdx);
-      }
-    }
-  }
-
-  if (varSz > MaxAllocaSz) delete[] idxLst;
-
   return true;
 }
 
-//-------------------------------------------------------------------------------
+//---------------------------------------------------------------------------
 
-bool Topology::composeSpeedEq()
+bool Topology::composeAccelRhs()
 {
-  solMat.clear();
-  rhs.clear();
-
-  topoGripLst.clearJointTrfCaches();
+  ctx.rhs.setSize(structure->varSz);
+  ctx.rhs.clear();
 
-  // model.func_lst.updateAllDer();
+  // model.func_lst.updateAllAcc();
 
-  bool ok = true;
   int sz = size();
 
-  for (int i=0; i<sz; i++) {
-    GripList& grpLst = *get(i);
-    if (!composeSpeedMatrixRow(grpLst)) ok = false;
-  }
+  std::vector<double> diffLst(6*sz,0.0);
+  std::vector<char> okLst(sz,0);
 
-  return ok;
+  forEachLoop([&](int i) {
+    okLst[i] = composeAccelRhsRow(*get(i),&diffLst[6*i]);
+  },2);
+
+  return subtractLoopProjections(diffLst,okLst);
 }
 
-//-------------------------------------------------------------------------------
+//---------------------------------------------------------------------------
 
-bool Topology::solveSpeed(Vector& speedVec, bool write)
+bool Topology::solveAccel(Vector& accelVec)
 {
-  speedValid = false;
   accelValid = false;
   jerkValid  = false;
 
-  if (!posValid) return false;
-
-  speedVec.setSize(varSz);
-
-  if (!composeSpeedEq()) return false;
-
-  speedMat2 = solMat;
-  speedRhs2 = rhs;
-
-  //FILE *fd = fopen("\\Temp\\speedrhs.csv","wt");
-
-  //for (int i=0; i<rhs.size(); ++i) fprintf(fd,"%.f\n",rhs[i]);
-
-  //fclose(fd);
-
-  solMat.solveLDLT(rhs);
-
-  speedVec = rhs;
-
-  //fd = fopen("\\Temp\\speedsol.csv","wt");
+  accelVec.setSize(structure->varSz);
 
-  //for (int i=0; i<rhs.size(); ++i) fprintf(fd,"%.f\n",rhs[i]);
+  if (!preparePosFactor()) return false;
+  if (!composeAccelRhs()) return false;
 
-  //fclose(fd);
+  solvePosFactor(ctx.rhs);
 
-  //fd = fopen("\\Temp\\speeddiag.csv","wt");
+  accelVec = ctx.rhs;
 
-  //for (int i=0; i<rhs.size(); ++i) fprintf(fd,"%.f\n",solMat(i,i));
-
-  //fclose(fd);
+  updateAccels();
 
-  updateSpeeds();
+  accelValid = true;
 
-  speedValid = true;
+  if (ctx.prdSpeedValid) {
+    ctx.prdAccel = accelVec;
+    ctx.prdAccelValid = true;
+  }
 
   return true;
 }
 
 //---------------------------------------------------------------------------
 
-bool Topology::getSpeedVector(Vector& speedVec, bool fixed) const
+bool Topology::getAccelVector(Ino::Vector& accelVec, bool fixed) const
 {
-  if (!speedValid) {
-    speedVec.setSize(0);
+  if (!accelValid) {
+    accelVec.setSize(0);
     return false;
   }
 
-  if (fixed) speedVec.setSize(fixedSz);
-  else speedVec.setSize(varSz);
+  if (fixed) accelVec.setSize(structure->fixedSz);
+  else accelVec.setSize(structure->varSz);
 
-  speedVec.clear();
-
-  int grpSz = topoGripLst.size();
-
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+  accelVec.clear();
 
-    if (jnt) jnt->getSpeeds(fixed, speedVec);
-  }
+  gatherVars(StoreAccel,fixed,accelVec);
 
   return true;
 }
 
 //---------------------------------------------------------------------------
 
-void Topology::setSpeedVector(const Vector& speedVec, bool fixed)
+void Topology::setAccelVector(const Ino::Vector& accelVec, bool fixed)
 {
-  accelValid = false;
   jerkValid  = false;
 
-  if (speedVec.size() != (fixed ? fixedSz : varSz)) {
-    speedValid = false;
+  if (accelVec.size() != (fixed ? structure->fixedSz : structure->varSz)) {
+    accelValid = false;
     return;
   }
 
-  speedValid = true;
-
-  int grpSz = topoGripLst.size();
-
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+  accelValid = true;
 
-    if (jnt) jnt->setSpeeds(fixed,speedVec);
-  }
+  scatterVars(StoreAccel,fixed,accelVec);
 }
 
 //---------------------------------------------------------------------------
 
-void Topology::setSpeedVectors(const Vector& varSpeedVec,
-                                              const Vector& fixedSpeedVec)
+void Topology::setAccelVectors(const Vector& varAccelVec,
+                                               const Vector& fixedAccelVec)
 {
-  accelValid = false;
   jerkValid  = false;
 
-  if (varSpeedVec.size() != varSz || fixedSpeedVec.size() != fixedSz) {
-    speedValid = false;
+  if (varAccelVec.size() != structure->varSz || fixedAccelVec.size() != structure->fixedSz) {
+    accelValid = false;
     return;
   }
 
-  speedValid = true;
-
-  int grpSz = topoGripLst.size();
-
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+  accelValid = true;
 
-    if (jnt) jnt->setSpeeds(varSpeedVec,fixedSpeedVec);
-  }
+  scatterVars(StoreAccel,varAccelVec,fixedAccelVec);
 }
 
 //---------------------------------------------------------------------------
 
-static void updateSpeed(Grip& grip)
+static void updateAccel(Grip& grip, bool down)
 {
   Body *body1 = grip.getBody1();
   Body *body2 = grip.getBody2();
 
-  if (body1->getTreeLevel() < body2->getTreeLevel()) {
+  if (down) {
     Trf3 pos(body1->getPos());
     Trf3 speed(body1->getSpeed());
+    Trf3 acc(body1->getAccel());
 
     pos.preMultWith(grip.getPos1());
     speed.preMultWith(grip.getPos1());
+    acc.preMultWith(grip.getPos1());
 
-    speed.preMultWith(grip.getJoint()->getPos());
-    pos.preMultWith(grip.getJoint()->getDer());
-    speed += pos;
+    acc.preMultWith(grip.getJoint()->getPos());
 
-    speed.preMultWith(grip.getInvPos2());
+    speed.preMultWith(grip.getJoint()->getDer());
+    speed *= 2.0;
+    acc += speed;
 
-    body2->setSpeed(speed);
+    pos.preMultWith(grip.getJoint()->getAcc());
+    acc += pos;
+
+    acc.preMultWith(grip.getInvPos2());
+
+    body2->setAccel(acc);
   }
   else {
     Trf3 pos(body2->getPos());
     Trf3 speed(body2->getSpeed());
+    Trf3 acc(body2->getAccel());
 
     pos.preMultWith(grip.getPos2());
     speed.preMultWith(grip.getPos2());
+    acc.preMultWith(grip.getPos2());
 
-    speed.preMultWith(grip.getJoint()->getInvPos());
-    pos.preMultWith(grip.getJoint()->getInvDer());
-    speed += pos;
+    acc.preMultWith(grip.getJoint()->getInvPos());
 
-    speed.preMultWith(grip.getInvPos1());
+    speed.preMultWith(grip.getJoint()->getInvDer());
+    speed *= 2.0;
+    acc += speed;
 
-    body1->setSpeed(speed);
+    pos.preMultWith(grip.getJoint()->getInvAcc());
+    acc += pos;
+
+    acc.preMultWith(grip.getInvPos1());
+
+    body1->setAccel(acc);
   }
 }
 
 //---------------------------------------------------------------------------
 
-bool Topology::updateSpeeds()
+bool Topology::updateAccels()
 {
-  if (!speedValid) return false;
+  if (!accelValid) return false;
 
-  int sz = topoGripLst.size();
+  int sz = (int)treeStepLst.size();
 
   for (int i=0; i<sz; ++i) {
-    Grip *grp = topoGripLst[i];
-    if (!grp->parentRel) continue;
-
-    updateSpeed(*grp);
+    const TreeStep& step = treeStepLst[i];
+    updateAccel(*step.grip,step.down);
   }
 
   return true;
@@ -1252,7 +2438,7 @@ bool Topology::updateSpeeds()
 
 //---------------------------------------------------------------------------
 
-bool Topology::composeAccelMatrixRow(const GripList& grpLst)
+bool Topology::composeJerkRhsRow(const GripList& grpLst, double *jerkDiff)
 {
   Trf3 curTrf;
   if (!grpLst.setPreTrfs(curTrf)) return false;
@@ -1263,50 +2449,47 @@ bool Topology::composeAccelMatrixRow(const GripList& grpLst)
   Body *body = grpLst.firstBody();
   if (!body) return false;
 
-  enum { MaxAllocaSz = 32000 }; // Max nr of items on stack
-
-  int idxLstSz = 0;
-  int *idxLst;
- 
-  if (varSz > MaxAllocaSz) idxLst = new int[varSz];
-  else idxLst = (int *)_malloca(varSz*sizeof(int));
-
-  if (!idxLst) throw NullPointerException("idxlst");
-
-  for (int i=0; i<varSz; ++i) idxLst[i] = -1;
-
-  if (!idxLst) throw NullPointerException("idxlst");
-
   curTrf.init();
  
-  Trf3 secDer, der;
+  Trf3 secDer, thrdDer, der;
+
+  for (int i=0; i<6; ++i) jerkDiff[i] = 0.0;
 
   for (int i=grpSz-1; i>=0; i--) {
     Grip& grp = *grpLst[i];
     AbstractJoint& jnt = *grp.getJoint();
 
-    Trf3 accSum;
-    accSum.zero();
-
+    Trf3 jerkSum;
+    jerkSum.zero();
+
     bool atBody1 = body == grp.getBody1();
 
     if (atBody1) {
       curTrf.preMultWith(grp.getPos1());
-      jnt.getAccMixed(accSum);
+      jnt.getJerkMixed(jerkSum);
     }
     else {
       curTrf.preMultWith(grp.getPos2());
-      jnt.getInvAccMixed(accSum);
+      jnt.getInvJerkMixed(jerkSum);
     }
 
     int varCnt = jnt.getVarCnt();
 
     for (int j=0; j<varCnt; ++j) {
-      if (atBody1) jnt.getSecDerivative(j,secDer);
-      else jnt.getInvSecDerivative(j,secDer);
+      if (atBody1) {
+        jnt.getSecDerivative(j,secDer);
+        jnt.getThirdDerivative(j,thrdDer);
+      }
+      else {
+        jnt.getInvSecDerivative(j,secDer);
+        jnt.getInvThirdDerivative(j,thrdDer);
+      }
 
-      secDer *= sqr(jnt.getSpeed(j));
-      accSum += secDer;
+      thrdDer *= sqr(jnt.getSpeed(j)) * jnt.getSpeed(j);
+      secDer *= 3.0 * jnt.getSpeed(j) * jnt.getAccel(j);
+
+      jerkSum += thrdDer;
+      jerkSum += secDer;
 
       if (!jnt.getFixed(j)) continue;
 
@@ -1315,45 +2498,16 @@ bool Topology::composeAccelMatrixRow(const GripList& grpLst)
       if (atBody1) der = jnt.getDerivative(j);
       else der = jnt.getInvDerivative(j);
 
-      der *= jnt.getAccel(j);
-      accSum += der;
+      der *= jnt.getJerk(j);
+      jerkSum += der;
     }
 
-    accSum *= curTrf;
-
-    const Trf3& preTrf = grpLst.getPreTrf(i);
-    accSum.preMultWith(preTrf);
-
-    for (int j=0; j<varCnt; j++) {
-      if (jnt.getFixed(j)) continue;
-
-      if (atBody1) jnt.getSecDerivative(j,secDer);
-      else jnt.getInvSecDerivative(j,secDer);
-
-      Trf3 trf(curTrf);
-      trf.preMultWith(secDer);
-      trf.preMultWith(preTrf);
+    jerkSum *= curTrf;
 
-      int varIdx = jnt.getVarIdx(j);
-
-      prepMat(0,varIdx) = trf(0,2);
-      prepMat(1,varIdx) = trf(1,0);
-      prepMat(2,varIdx) = trf(2,1);
-      prepMat(3,varIdx) = trf(0,3);
-      prepMat(4,varIdx) = trf(1,3);
-      prepMat(5,varIdx) = trf(2,3);
-
-      rhs[varIdx] -= trf(0,2) * accSum(0,2);
-      rhs[varIdx] -= trf(1,0) * accSum(1,0);
-      rhs[varIdx] -= trf(2,1) * accSum(2,1);
-      rhs[varIdx] -= trf(0,3) * accSum(0,3);
-      rhs[varIdx] -= trf(1,3) * accSum(1,3);
-      rhs[varIdx] -= trf(2,3) * accSum(2,3);
-    
-      if (!idxLst) throw NullPointerException("idxlst");
+    const Trf3& preTrf = grpLst.getPreTrf(i); 
+    jerkSum.preMultWith(preTrf);
 
-      idxLst[idxLstSz++] = varIdx;
-    }
+    addSol(jerkSum, jerkDiff);
 
     if (atBody1) {
       curTrf.preMultWith(jnt.pos);
@@ -1367,549 +2521,623 @@ bool Topology::composeAccelMatrixRow(const GripList& grpLst)
     body = grp.getOtherBody(*body);
   }
 
-  for (int i=0; i<6; ++i) {
-    for (int j=0; j<idxLstSz; ++j) {
-      int colIdx = idxLst[j];
-
-      double m = prepMat(i,colIdx);
-
-      for (int k=0; k<idxLstSz; ++k) {
-        int rowIdx = idxLst[k];
-        if (rowIdx < colIdx) continue;
-
-        // Store element of AT-A, optimized storage, see Matrix::solveLDLT()
-        solMat(colIdx,rowIdx-colIdx) += m * prepMat(i,rowIdx);
-      }
-    }
-  }
-
-  if (varSz > MaxAllocaSz) delete[] idxLst;
-
   return true;
 }
 
 //---------------------------------------------------------------------------
 
-bool Topology::composeAccelEq()
+bool Topology::composeJerkRhs()
 {
-  solMat.clear();
-  rhs.clear();
-
-  topoGripLst.clearJointTrfCaches();
+  ctx.rhs.setSize(structure->varSz);
+  ctx.rhs.clear();
 
-  // model.func_lst.updateAllAcc();
+  // model.func_lst.updateAllJerk();
 
-  bool ok = true;
   int sz = size();
 
-  for (int i=0; i<sz; i++) {
-    GripList& grpLst = *get(i);
+  std::vector<double> diffLst(6*sz,0.0);
+  std::vector<char> okLst(sz,0);
 
-    if (!composeAccelMatrixRow(grpLst)) ok = false;
-  }
+  forEachLoop([&](int i) {
+    okLst[i] = composeJerkRhsRow(*get(i),&diffLst[6*i]);
+  },3);
 
-  return ok;
+  return subtractLoopProjections(diffLst,okLst);
 }
 
 //---------------------------------------------------------------------------
 
-bool Topology::solveAccel(Vector& accelVec)
+bool Topology::solveJerk(Vector& jerkVec)
 {
-  accelValid = false;
   jerkValid  = false;
 
-  accelVec.setSize(varSz);
+  jerkVec.setSize(structure->varSz);
 
-  if (!composeAccelEq()) return false;
+  if (!preparePosFactor()) return false;
+  if (!composeJerkRhs()) return false;
 
-  solMat.solveLDLT(rhs);
+  solvePosFactor(ctx.rhs);
 
-  accelVec = rhs;
+  jerkVec = ctx.rhs;
 
-  updateAccels();
+  updateJerks();
 
-  accelValid = true;
+  jerkValid = true;
 
   return true;
 }
 
 //---------------------------------------------------------------------------
 
-bool Topology::getAccelVector(Ino::Vector& accelVec, bool fixed) const
+bool Topology::getJerkVector(Ino::Vector& jerkVec, bool fixed) const
 {
-  if (!accelValid) {
-    accelVec.setSize(0);
+  if (!jerkValid) {
+    jerkVec.setSize(0);
     return false;
   }
 
-  if (fixed) accelVec.setSize(fixedSz);
-  else accelVec.setSize(varSz);
+  if (fixed) jerkVec.setSize(structure->fixedSz);
+  else jerkVec.setSize(structure->varSz);
 
-  accelVec.clear();
-
-  int grpSz = topoGripLst.size();
-
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+  jerkVec.clear();
 
-    if (jnt) jnt->getAccels(fixed, accelVec);
-  }
+  gatherVars(StoreJerk,fixed,jerkVec);
 
   return true;
 }
 
 //---------------------------------------------------------------------------
 
-void Topology::setAccelVector(const Ino::Vector& accelVec, bool fixed)
+void Topology::setJerkVector(const Ino::Vector& jerkVec, bool fixed)
 {
-  jerkValid  = false;
-
-  if (accelVec.size() != (fixed ? fixedSz : varSz)) {
-    accelValid = false;
+  if (jerkVec.size() != (fixed ? structure->fixedSz : structure->varSz)) {
+    jerkValid = false;
     return;
   }
 
-  accelValid = true;
-
-  int grpSz = topoGripLst.size();
-
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+  jerkValid = true;
 
-    if (jnt) jnt->setAccels(fixed,accelVec);
-  }
+  scatterVars(StoreJerk,fixed,jerkVec);
 }
 
 //---------------------------------------------------------------------------
 
-void Topology::setAccelVectors(const Vector& varAccelVec,
-                                               const Vector& fixedAccelVec)
+void Topology::setJerkVectors(const Vector& varJerkVec,
+                                              const Vector& fixedJerkVec)
 {
-  jerkValid  = false;
-
-  if (varAccelVec.size() != varSz || fixedAccelVec.size() != fixedSz) {
-    accelValid = false;
+  if (varJerkVec.size() != structure->varSz || fixedJerkVec.size() != structure->fixedSz) {
+    jerkValid = false;
     return;
   }
 
-  accelValid = true;
-
-  int grpSz = topoGripLst.size();
-
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+  jerkValid = true;
 
-    if (jnt) jnt->setAccels(varAccelVec, fixedAccelVec);
-  }
+  scatterVars(StoreJerk,varJerkVec,fixedJerkVec);
 }
 
 //---------------------------------------------------------------------------
 
-static void updateAccel(Grip& grip)
+static void updateJerk(Grip& grip, bool down)
 {
   Body *body1 = grip.getBody1();
   Body *body2 = grip.getBody2();
 
-  if (body1->getTreeLevel() < body2->getTreeLevel()) {
+  if (down) {
     Trf3 pos(body1->getPos());
     Trf3 speed(body1->getSpeed());
     Trf3 acc(body1->getAccel());
+    Trf3 jerk(body1->getJerk());
 
     pos.preMultWith(grip.getPos1());
     speed.preMultWith(grip.getPos1());
     acc.preMultWith(grip.getPos1());
+    jerk.preMultWith(grip.getPos1());
 
-    acc.preMultWith(grip.getJoint()->getPos());
+    jerk.preMultWith(grip.getJoint()->getPos());
 
-    speed.preMultWith(grip.getJoint()->getDer());
-    speed *= 2.0;
-    acc += speed;
+    acc.preMultWith(grip.getJoint()->getDer());
+    acc *= 3.0;
+    jerk += acc;
 
-    pos.preMultWith(grip.getJoint()->getAcc());
-    acc += pos;
+    speed.preMultWith(grip.getJoint()->getAcc());
+    speed *= 3.0;
+    jerk += speed;
 
-    acc.preMultWith(grip.getInvPos2());
+    pos.preMultWith(grip.getJoint()->getJerk());
+    jerk += pos;
 
-    body2->setAccel(acc);
+    jerk.preMultWith(grip.getInvPos2());
+
+    body2->setJerk(jerk);
   }
   else {
     Trf3 pos(body2->getPos());
     Trf3 speed(body2->getSpeed());
     Trf3 acc(body2->getAccel());
+    Trf3 jerk(body2->getJerk());
 
     pos.preMultWith(grip.getPos2());
     speed.preMultWith(grip.getPos2());
     acc.preMultWith(grip.getPos2());
+    jerk.preMultWith(grip.getPos2());
 
-    acc.preMultWith(grip.getJoint()->getInvPos());
+    jerk.preMultWith(grip.getJoint()->getInvPos());
 
-    speed.preMultWith(grip.getJoint()->getInvDer());
-    speed *= 2.0;
-    acc += speed;
+    acc.preMultWith(grip.getJoint()->getInvDer());
+    acc *= 3.0;
+    jerk += acc;
 
-    pos.preMultWith(grip.getJoint()->getInvAcc());
-    acc += pos;
+    speed.preMultWith(grip.getJoint()->getInvAcc());
+    speed *= 3.0;
+    jerk += speed;
 
-    acc.preMultWith(grip.getInvPos1());
+    pos.preMultWith(grip.getJoint()->getInvJerk());
+    jerk += pos;
 
-    body1->setAccel(acc);
+    jerk.preMultWith(grip.getInvPos1());
+
+    body1->setJerk(jerk);
   }
 }
 
 //---------------------------------------------------------------------------
 
-bool Topology::updateAccels()
+bool Topology::updateJerks()
 {
-  if (!accelValid) return false;
+  if (!jerkValid) return false;
 
-  int sz = topoGripLst.size();
+  int sz = (int)treeStepLst.size();
 
   for (int i=0; i<sz; ++i) {
-    Grip *grp = topoGripLst[i];
-    if (!grp->parentRel) continue;
+    const TreeStep& step = treeStepLst[i];
+    updateJerk(*step.grip,step.down);
+  }
 
-    updateAccel(*grp);
+  return true;
+}
+
+//---------------------------------------------------------------------------
+// Only fixed vars can be coupled, the free ones are solved for
+
+void SweepOptions::addCoupling(AbstractJoint& jnt, int locIdx, double ratio)
+{
+  if (!jnt.getFixed(locIdx))
+    throw IllegalArgumentException("SweepOptions::addCoupling: var not fixed");
+
+  couplingLst.push_back(SweepCoupling(jnt,locIdx,ratio));
+}
+
+//---------------------------------------------------------------------------
+// The drive var and its couplings move at constant speed
+
+void Topology::setSweepDerivatives(AbstractJoint& driveJnt, int locIdx,
+                                   const SweepOptions& options)
+{
+  driveJnt.setSpeed(locIdx,options.driveSpeed);
+  driveJnt.setAccel(locIdx,0.0);
+  driveJnt.setJerk(locIdx,0.0);
+
+  int cplSz = (int)options.couplingLst.size();
+
+  for (int i=0; i<cplSz; ++i) {
+    const SweepCoupling& cpl = options.couplingLst[i];
+
+    cpl.jnt->setSpeed(cpl.locIdx,cpl.ratio * options.driveSpeed);
+    cpl.jnt->setAccel(cpl.locIdx,0.0);
+    cpl.jnt->setJerk(cpl.locIdx,0.0);
   }
+}
+
+//---------------------------------------------------------------------------
+
+bool Topology::solve(int maxIter, double rotTol, double posTol,
+                                             int derivOrder, int& iter)
+{
+  Vector varVec(structure->varSz);
+
+  if (!solvePos(maxIter,rotTol,posTol,varVec,iter)) return false;
+
+  if (derivOrder < 1) return true;
+
+  Vector derVec(structure->varSz);
+
+  if (!solveSpeed(derVec)) return false;
+
+  setSpeedVector(derVec);
+  updateSpeeds();
+
+  if (derivOrder < 2) return true;
+
+  if (!solveAccel(derVec)) return false;
+
+  setAccelVector(derVec);
+  updateAccels();
+
+  if (derivOrder < 3) return true;
+
+  if (!solveJerk(derVec)) return false;
+
+  setJerkVector(derVec);
+  updateJerks();
 
   return true;
 }
 
 //---------------------------------------------------------------------------
+// Sets the drive var to drivePos and advances the coupled vars
+// by ratio times the advance of the drive var
 
-bool Topology::composeJerkMatrixRow(const GripList& grpLst)
+static void setSweepDrive(AbstractJoint& driveJnt, int locIdx,
+                          const SweepOptions& options, double drivePos)
 {
-  Trf3 curTrf;
-  if (!grpLst.setPreTrfs(curTrf)) return false;
+  double delta = drivePos - driveJnt.getVal(locIdx);
 
-  int grpSz = grpLst.size();
-  if (grpSz < 1) return false;
+  driveJnt.setVal(locIdx,drivePos);
 
-  Body *body = grpLst.firstBody();
-  if (!body) return false;
+  int cplSz = (int)options.couplingLst.size();
 
-  enum { MaxAllocaSz = 32000 }; // Max nr of items on stack
+  for (int i=0; i<cplSz; ++i) {
+    const SweepCoupling& cpl = options.couplingLst[i];
 
-  int idxLstSz = 0;
-  int *idxLst;
- 
-  if (varSz > MaxAllocaSz) idxLst = new int[varSz];
-  else idxLst = (int *)_malloca(varSz*sizeof(int));
+    cpl.jnt->setVal(cpl.locIdx,cpl.jnt->getVal(cpl.locIdx) + cpl.ratio*delta);
+  }
+}
 
-  if (!idxLst) throw NullPointerException("idxlst");
+//---------------------------------------------------------------------------
+// Step size after a converged step of size stepSz.
+// The deviation from the secant prediction grows with the square
+// of the step, so the step that meets maxDeviation follows from it
 
-  for (int i=0; i<varSz; ++i) idxLst[i] = -1;
+static double nextSweepStep(const SweepOptions& options, double stepSz,
+                            double maxStepSz, int iter, double deviation)
+{
+  if (!options.adaptive) return std::min(stepSz * 2.0, maxStepSz);
 
-  curTrf.init();
- 
-  Trf3 secDer, thrdDer, der;
+  double fac = 1.0;
 
-  for (int i=grpSz-1; i>=0; i--) {
-    Grip& grp = *grpLst[i];
-    AbstractJoint& jnt = *grp.getJoint();
+  if (iter > options.targetIter) fac = 0.5;
+  else if (iter <= options.targetIter/2) fac = 2.0;
 
-    Trf3 jerkSum;
-    jerkSum.zero();
+  if (deviation > 0.0 && options.maxDeviation > 0.0) {
+    double curveFac = sqrt(options.maxDeviation/deviation);
 
-    bool atBody1 = body == grp.getBody1();
+    if (curveFac < fac) fac = std::max(curveFac,0.25);
+  }
 
-    if (atBody1) {
-      curTrf.preMultWith(grp.getPos1());
-      jnt.getJerkMixed(jerkSum);
-    }
-    else {
-      curTrf.preMultWith(grp.getPos2());
-      jnt.getInvJerkMixed(jerkSum);
-    }
+  return std::min(stepSz * fac, maxStepSz);
+}
 
-    int varCnt = jnt.getVarCnt();
+//---------------------------------------------------------------------------
+// Each step sets the drive var, advances the coupled vars by ratio times
+// the drive advance, solves the topology and records the state.
+// The coupled vars must be consistent with the drive var on entry.
+// A step that does not converge is retried from the last state with
+// half the step, at most maxHalvings times in a row.
+// Adaptive sweeps vary the step between step/2^maxHalvings and
+// maxStepFactor*step and start each solve from the secant prediction
+// (unless the solver has a predictor of its own).
+// Returns false if the sweep cannot be completed, the states recorded
+// before that are kept (stepCnt)
+
+bool Topology::sweep(AbstractJoint& driveJnt, int locIdx,
+                     double from, double to, double step,
+                     const SweepOptions& options, Sequence& seq, int& stepCnt)
+{
+  stepCnt = 0;
 
-    for (int j=0; j<varCnt; ++j) {
-      if (atBody1) {
-        jnt.getSecDerivative(j,secDer);
-        jnt.getThirdDerivative(j,thrdDer);
-      }
-      else {
-        jnt.getInvSecDerivative(j,secDer);
-        jnt.getInvThirdDerivative(j,thrdDer);
-      }
+  if (&seq.getTopology() != this)
+    throw IllegalArgumentException("Topology::sweep: foreign sequence");
 
-      thrdDer *= sqr(jnt.getSpeed(j)) * jnt.getSpeed(j);
-      secDer *= 3.0 * jnt.getSpeed(j) * jnt.getAccel(j);
+  if (!driveJnt.getFixed(locIdx) || driveJnt.getVarIdx(locIdx) < 0)
+    throw IllegalArgumentException("Topology::sweep: drive var not fixed");
 
-      jerkSum += thrdDer;
-      jerkSum += secDer;
+  if (step == 0.0)
+    throw IllegalArgumentException("Topology::sweep: zero step");
 
-      if (!jnt.getFixed(j)) continue;
+  int cplSz = (int)options.couplingLst.size();
 
-      // Only fixed vars:
+  for (int i=0; i<cplSz; ++i) {
+    const SweepCoupling& cpl = options.couplingLst[i];
 
-      if (atBody1) der = jnt.getDerivative(j);
-      else der = jnt.getInvDerivative(j);
+    if (!cpl.jnt)
+      throw NullPointerException("Topology::sweep: null coupling joint");
 
-      der *= jnt.getJerk(j);
-      jerkSum += der;
-    }
+    if (!cpl.jnt->getFixed(cpl.locIdx)) // Freed after addCoupling()
+      throw IllegalArgumentException("Topology::sweep: coupled var not fixed");
+  }
 
-    jerkSum *= curTrf;
+  double dir = to < from ? -1.0 : 1.0;
 
-    const Trf3& preTrf = grpLst.getPreTrf(i); 
-    jerkSum.preMultWith(preTrf);
+  double stepSz = fabs(step);
+  double minStepSz = ldexp(stepSz,-std::max(options.maxHalvings,0));
+  double maxStepSz = stepSz;
 
-    for (int j=0; j<varCnt; j++) {
-      if (jnt.getFixed(j)) continue;
+  if (options.adaptive && options.maxStepFactor > 1.0)
+    maxStepSz *= options.maxStepFactor;
+
+  bool secant = options.adaptive && solverOptions.predictorOrder < 1;
+
+  if (options.derivOrder > 0) setSweepDerivatives(driveJnt,locIdx,options);
+
+  Vector varVec(structure->varSz), lastVarVec(structure->varSz), lastFixedVec(structure->fixedSz);
+  Vector slope(structure->varSz);
+  bool slopeValid = false;
 
-      if (atBody1) jnt.getThirdDerivative(j,thrdDer);
-      else jnt.getInvThirdDerivative(j,thrdDer);
+  double drivePos = from, lastPos = from;
 
-      Trf3 trf(curTrf);
-      trf.preMultWith(thrdDer);
-      trf.preMultWith(preTrf);
+  for (;;) {
+    setSweepDrive(driveJnt,locIdx,options,drivePos);
 
-      int varIdx = jnt.getVarIdx(j);
-
-      prepMat(0,varIdx) = trf(0,2);
-      prepMat(1,varIdx) = trf(1,0);
-      prepMat(2,varIdx) = trf(2,1);
-      prepMat(3,varIdx) = trf(0,3);
-      prepMat(4,varIdx) = trf(1,3);
-      prepMat(5,varIdx) = trf(2,3);
-
-      rhs[varIdx] -= trf(0,2) * jerkSum(0,2);
-      rhs[varIdx] -= trf(1,0) * jerkSum(1,0);
-      rhs[varIdx] -= trf(2,1) * jerkSum(2,1);
-      rhs[varIdx] -= trf(0,3) * jerkSum(0,3);
-      rhs[varIdx] -= trf(1,3) * jerkSum(1,3);
-      rhs[varIdx] -= trf(2,3) * jerkSum(2,3);
-    
-      if (!idxLst) throw NullPointerException("idxlst");
+    if (secant && slopeValid) {
+      varVec = lastVarVec;
+      for (int i=0; i<structure->varSz; ++i) varVec[i] += slope[i] * (drivePos - lastPos);
 
-      idxLst[idxLstSz++] = varIdx;
+      setPosVector(varVec);
+      updatePositions();
     }
 
-    if (atBody1) {
-      curTrf.preMultWith(jnt.pos);
-      curTrf.preMultWith(grp.getInvPos2());
-    }
-    else {
-      curTrf.preMultWith(jnt.invPos);
-      curTrf.preMultWith(grp.getInvPos1());
-    }
+    int iter = 0;
 
-    body = grp.getOtherBody(*body);
-  }
+    if (!solve(options.maxIter,options.rotTol,options.posTol,
+                                          options.derivOrder,iter)) {
+      if (stepCnt < 1 || stepSz/2.0 < minStepSz) return false;
+
+      // Bisect back from the last converged state
+      setPosVectors(lastVarVec,lastFixedVec);
+      updatePositions();
+
+      stepSz /= 2.0;
+      drivePos = lastPos + dir * stepSz;
 
-  for (int i=0; i<6; ++i) {
-    for (int j=0; j<idxLstSz; ++j) {
-      int colIdx = idxLst[j];
+      continue;
+    }
 
-      double m = prepMat(i,colIdx);
+    getPosVector(varVec);
 
-      for (int k=0; k<idxLstSz; ++k) {
-        int rowIdx = idxLst[k];
-        if (rowIdx < colIdx) continue;
+    double deviation = 0.0;
 
-        // Store element of AT-A, optimized storage, see Matrix::solveLDLT()
-        solMat(colIdx,rowIdx-colIdx) += m * prepMat(i,rowIdx);
+    if (slopeValid) {
+      for (int i=0; i<structure->varSz; ++i) {
+        double dev = varVec[i] - lastVarVec[i] - slope[i] * (drivePos - lastPos);
+        deviation = std::max(deviation,fabs(dev));
       }
     }
-  }
 
-  if (varSz > MaxAllocaSz) delete[] idxLst;
-
-  return true;
-}
+    if (stepCnt > 0) {
+      for (int i=0; i<structure->varSz; ++i)
+        slope[i] = (varVec[i] - lastVarVec[i]) / (drivePos - lastPos);
 
-//---------------------------------------------------------------------------
+      slopeValid = true;
+    }
 
-bool Topology::composeJerkEq()
-{
-  solMat.clear();
-  rhs.clear();
+    seq.addCurrentTopoState();
+    stepCnt++;
 
-  topoGripLst.clearJointTrfCaches();
+    lastPos = drivePos;
+    lastVarVec = varVec;
+    getPosVector(lastFixedVec,true);
 
-  // model.func_lst.updateAllJerk();
+    if (drivePos == to) break;
 
-  bool ok = true;
-  int sz = size();
+    stepSz = nextSweepStep(options,stepSz,maxStepSz,iter,deviation);
+    if (stepSz < minStepSz) stepSz = minStepSz;
 
-  for (int i=0; i<sz; i++) {
-    GripList& grpLst = *get(i);
+    drivePos += dir * stepSz;
 
-    if (!composeJerkMatrixRow(grpLst)) ok = false;
+    // Do not overshoot, nor leave a sliver of a last step
+    if ((to - drivePos) * dir <= stepSz * 1.0e-9) drivePos = to;
   }
 
-  return ok;
+  return true;
 }
 
 //---------------------------------------------------------------------------
+// The joint of clone mdl that corresponds with jnt of model src
 
-bool Topology::solveJerk(Vector& jerkVec)
+static AbstractJoint& cloneJoint(const Model& mdl, const Model& src,
+                                                  const AbstractJoint& jnt)
 {
-  jerkValid  = false;
+  const GripList& srcLst = src.getGripList();
+  int idx = srcLst.find(&jnt.grip);
 
-  jerkVec.setSize(varSz);
+  Grip *grp = idx < srcLst.size() ? mdl.getGripList()[idx] : NULL;
 
-  if (!composeJerkEq()) return false;
+  if (!grp || !grp->getJoint())
+    throw NullPointerException("Topology::sweepParallel: joint not cloned");
 
-  solMat.solveLDLT(rhs);
+  return *grp->getJoint();
+}
 
-  jerkVec = rhs;
+//---------------------------------------------------------------------------
+// One segment of a parallel sweep, runs on its own model clone
 
-  updateJerks();
+class SweepSegment
+{
+public:
+  Model *mdl;
+  Topology *topo;
+  Sequence *seq;
+  AbstractJoint *driveJnt;
+  SweepOptions options;
 
-  jerkValid = true;
+  double from, to;
+  int stepCnt;
+  bool ok;
 
-  return true;
-}
+  SweepSegment() : mdl(NULL), topo(NULL), seq(NULL), driveJnt(NULL),
+                   options(), from(0.0), to(0.0), stepCnt(0), ok(false) {}
+
+  void run(int locIdx, double step);
+};
 
 //---------------------------------------------------------------------------
 
-bool Topology::getJerkVector(Ino::Vector& jerkVec, bool fixed) const
+void SweepSegment::run(int locIdx, double step)
 {
-  if (!jerkValid) {
-    jerkVec.setSize(0);
-    return false;
+  try {
+    ok = topo->sweep(*driveJnt,locIdx,from,to,step,options,*seq,stepCnt);
   }
+  catch (...) {
+    ok = false;
+  }
+}
 
-  if (fixed) jerkVec.setSize(fixedSz);
-  else jerkVec.setSize(varSz);
+//---------------------------------------------------------------------------
+// Splits the sweep in segCnt segments, each swept on a clone of the model.
+// The segments run on a WorkerPool of solverOptions.threadCnt threads,
+// or one per core if that is 0 or 1 (the clones solve serially).
+// A coarse pass on this topology yields the start positions of the
+// segments: adaptive steps that grow up to the segment length, halved
+// down to the given step and below it on non-convergence.
+// The states of the segments are appended to seq in order, the first
+// state of each segment after the first one is left out (it equals the
+// last state of the previous one).
+// Tracks are shared by the clones and only read. Functions are not
+// cloned (see Model::cloneFrom()), with functions the sweep is sequential.
+// Returns false if a segment cannot be completed, the states up to
+// the failing step are kept (stepCnt)
+
+bool Topology::sweepParallel(AbstractJoint& driveJnt, int locIdx,
+                             double from, double to, double step,
+                             const SweepOptions& options, int segCnt,
+                             int threadCnt, Sequence& seq, int& stepCnt,
+                             int& parSegCnt)
+{
+  stepCnt = 0;
+  parSegCnt = 1;
 
-  jerkVec.clear();
+  if (&seq.getTopology() != this)
+    throw IllegalArgumentException("Topology::sweepParallel: foreign sequence");
 
-  int grpSz = topoGripLst.size();
+  if (!model) throw NullPointerException("Topology::sweepParallel: no model");
 
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+  // Functions can not be cloned yet: sequential, parSegCnt stays 1
+  if (segCnt < 2 || from == to || model->getFunctionList().size() > 0)
+    return sweep(driveJnt,locIdx,from,to,step,options,seq,stepCnt);
 
-    if (jnt) jnt->getJerks(fixed, jerkVec);
-  }
+  if (step == 0.0)
+    throw IllegalArgumentException("Topology::sweepParallel: zero step");
 
-  return true;
-}
+  const TopologyList& topoLst = model->getTopologyList();
 
-//---------------------------------------------------------------------------
+  int topoIdx = -1;
 
-void Topology::setJerkVector(const Ino::Vector& jerkVec, bool fixed)
-{
-  if (jerkVec.size() != (fixed ? fixedSz : varSz)) {
-    jerkValid = false;
-    return;
+  for (int i=0; i<topoLst.size(); ++i) {
+    if (topoLst[i] == this) topoIdx = i;
   }
 
-  jerkValid = true;
+  if (topoIdx < 0)
+    throw IllegalArgumentException("Topology::sweepParallel: not in model");
 
-  int grpSz = topoGripLst.size();
+  double segLen = (to - from)/segCnt;
 
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+  std::vector<SweepSegment> segLst(segCnt);
 
-    if (jnt) jnt->setJerks(fixed,jerkVec);
+  for (int k=0; k<segCnt; ++k) {
+    segLst[k].from = from + k*segLen;
+    segLst[k].to   = k < segCnt-1 ? from + (k+1)*segLen : to;
   }
-}
 
-//---------------------------------------------------------------------------
+  // Coarse pass, also checks the arguments
 
-void Topology::setJerkVectors(const Vector& varJerkVec,
-                                              const Vector& fixedJerkVec)
-{
-  if (varJerkVec.size() != varSz || fixedJerkVec.size() != fixedSz) {
-    jerkValid = false;
-    return;
-  }
+  double coarseStep = std::min(fabs(step),fabs(segLen));
+  int coarseHalvings = std::max(options.maxHalvings,0) +
+                 (int)ceil(log2(fabs(segLen)/coarseStep)); // Below step
 
-  jerkValid = true;
+  SweepOptions coarseOptions(options);
+  coarseOptions.derivOrder    = 0;
+  coarseOptions.adaptive      = true;
+  coarseOptions.maxStepFactor = fabs(segLen)/coarseStep;
+  coarseOptions.maxHalvings   = coarseHalvings;
 
-  int grpSz = topoGripLst.size();
+  Sequence coarseSeq(*this,L"coarse");
+  std::vector<Vector> varLst(segCnt), fixedLst(segCnt);
 
-  for (int i=0; i<grpSz; i++) {
-    AbstractJoint *jnt = topoGripLst[i]->getJoint();
+  double coarsePos = driveJnt.getVal(locIdx);
 
-    if (jnt) jnt->setJerks(varJerkVec,fixedJerkVec);
-  }
-}
+  for (int k=0; k<segCnt; ++k) {
+    int coarseCnt = 0;
 
-//---------------------------------------------------------------------------
+    if (!sweep(driveJnt,locIdx,coarsePos,segLst[k].from,coarseStep,
+                                        coarseOptions,coarseSeq,coarseCnt))
+      return false;
 
-static void updateJerk(Grip& grip)
-{
-  Body *body1 = grip.getBody1();
-  Body *body2 = grip.getBody2();
+    coarseSeq.clear(); // Only the end positions are used
 
-  if (body1->getTreeLevel() < body2->getTreeLevel()) {
-    Trf3 pos(body1->getPos());
-    Trf3 speed(body1->getSpeed());
-    Trf3 acc(body1->getAccel());
-    Trf3 jerk(body1->getJerk());
+    coarsePos = segLst[k].from;
 
-    pos.preMultWith(grip.getPos1());
-    speed.preMultWith(grip.getPos1());
-    acc.preMultWith(grip.getPos1());
-    jerk.preMultWith(grip.getPos1());
+    getPosVector(varLst[k]);
+    getPosVector(fixedLst[k],true);
+  }
 
-    jerk.preMultWith(grip.getJoint()->getPos());
+  // The clones are made one after the other
 
-    acc.preMultWith(grip.getJoint()->getDer());
-    acc *= 3.0;
-    jerk += acc;
+  for (int k=0; k<segCnt; ++k) {
+    SweepSegment& seg = segLst[k];
 
-    speed.preMultWith(grip.getJoint()->getAcc());
-    speed *= 3.0;
-    jerk += speed;
+    seg.mdl  = new Model(*model);
+    seg.topo = seg.mdl->getTopologyList()[topoIdx];
+    seg.seq  = new Sequence(*seg.topo,seq.getName());
 
-    pos.preMultWith(grip.getJoint()->getJerk());
-    jerk += pos;
+    seg.driveJnt = &cloneJoint(*seg.mdl,*model,driveJnt);
 
-    jerk.preMultWith(grip.getInvPos2());
+    seg.options = options;
 
-    body2->setJerk(jerk);
+    int cplSz = (int)options.couplingLst.size();
+
+    for (int i=0; i<cplSz; ++i) {
+      SweepCoupling& cpl = seg.options.couplingLst[i];
+      cpl.jnt = &cloneJoint(*seg.mdl,*model,*cpl.jnt);
+    }
+
+    SolverOptions segOptions(solverOptions);
+    segOptions.threadCnt = 1; // The segments are the parallelism
+
+    seg.topo->setSolverOptions(segOptions);
+    seg.topo->setPosVectors(varLst[k],fixedLst[k]);
+    seg.topo->updatePositions();
   }
-  else {
-    Trf3 pos(body2->getPos());
-    Trf3 speed(body2->getSpeed());
-    Trf3 acc(body2->getAccel());
-    Trf3 jerk(body2->getJerk());
 
-    pos.preMultWith(grip.getPos2());
-    speed.preMultWith(grip.getPos2());
-    acc.preMultWith(grip.getPos2());
-    jerk.preMultWith(grip.getPos2());
+  if (threadCnt < 1) threadCnt = (int)std::thread::hardware_concurrency();
+  if (threadCnt < 1) threadCnt = 1;
+  if (threadCnt > segCnt) threadCnt = segCnt;
 
-    jerk.preMultWith(grip.getJoint()->getInvPos());
+  WorkerPool pool(threadCnt);
 
-    acc.preMultWith(grip.getJoint()->getInvDer());
-    acc *= 3.0;
-    jerk += acc;
+  pool.run(segCnt,[&](int k) { segLst[k].run(locIdx,step); });
 
-    speed.preMultWith(grip.getJoint()->getInvAcc());
-    speed *= 3.0;
-    jerk += speed;
+  parSegCnt = segCnt;
 
-    pos.preMultWith(grip.getJoint()->getInvJerk());
-    jerk += pos;
+  bool ok = true;
 
-    jerk.preMultWith(grip.getInvPos1());
+  for (int k=0; k<segCnt; ++k) {
+    SweepSegment& seg = segLst[k];
 
-    body1->setJerk(jerk);
-  }
-}
+    if (ok && seg.ok && k == segCnt-1) {
+      // Leave this topology at the end position
+      Vector varVec, fixedVec;
 
-//---------------------------------------------------------------------------
+      seg.topo->getPosVector(varVec);
+      seg.topo->getPosVector(fixedVec,true);
 
-bool Topology::updateJerks()
-{
-  if (!jerkValid) return false;
+      setPosVectors(varVec,fixedVec);
+      updatePositions();
+    }
 
-  int sz = topoGripLst.size();
+    if (ok) {
+      int fstIdx = k > 0 ? 1 : 0;
 
-  for (int i=0; i<sz; ++i) {
-    Grip *grp = topoGripLst[i];
-    if (!grp->parentRel) continue;
+      seq.appendStates(*seg.seq,fstIdx);
+      stepCnt += std::max(seg.seq->size() - fstIdx,0);
+
+      ok = seg.ok;
+    }
 
-    updateJerk(*grp);
+    delete seg.seq;
+    delete seg.mdl;
   }
 
-  return true;
+  return ok;
 }
 
 //---------------------------------------------------------------------------
@@ -1980,6 +3208,57 @@ bool TopologyList::prepareAll()
   return size() > 0;
 }
 
+//-------------------------------------------------------------------------------
+// The topologies have no bodies, grips or joints in common. Shared are
+// the model (modified flag only), the tracks and the table functions,
+// these are safe to evaluate concurrently.
+// Each topology is solved by one thread, so the solution is the same
+// as when solved one after the other
+
+TopologyList::~TopologyList()
+{
+  delete workerPool;
+}
+
+//-------------------------------------------------------------------------------
+
+bool TopologyList::solveAll(int maxIter, double rotTol, double posTol,
+                            int derivOrder, int threadCnt) const
+{
+  int sz = size();
+  if (sz < 1) return false;
+
+  if (threadCnt < 1) threadCnt = (int)std::thread::hardware_concurrency();
+  if (threadCnt < 1) threadCnt = 1;
+  if (threadCnt > sz) threadCnt = sz;
+
+  std::vector<char> okLst(sz,0);
+
+  auto solveOne = [&](int i) {
+    int iter = 0;
+    okLst[i] = get(i)->solve(maxIter,rotTol,posTol,derivOrder,iter);
+  };
+
+  if (threadCnt == 1) {
+    for (int i=0; i<sz; ++i) solveOne(i);
+  }
+  else {
+    if (workerPool && workerPool->getThreadCnt() != threadCnt) {
+      delete workerPool; workerPool = NULL;
+    }
+
+    if (!workerPool) workerPool = new WorkerPool(threadCnt);
+
+    workerPool->run(sz,solveOne);
+  }
+
+  for (int i=0; i<sz; ++i) {
+    if (!okLst[i]) return false;
+  }
+
+  return true;
+}
+
 //-------------------------------------------------------------------------------
 
 void TopologyList::transform(const Ino::Trf3& trf) const
@@ -2020,6 +3299,202 @@ static bool SolvePosTopology(void* cppTopology, int maxIter, double rotTol, doub
   return ok;
 }
 
+bool SolveSpeedTopology(void* cppTopology, double* varSpeedVec)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  int sz = topo->getVarSz();
+
+  Ino::Vector speedVec(sz);
+
+  if (!topo->solveSpeed(speedVec)) return false;
+
+  for (int i = 0; i < sz; ++i) varSpeedVec[i] = speedVec[i];
+
+  return true;
+}
+
+bool SolveAccelTopology(void* cppTopology, double* varAccelVec)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  int sz = topo->getVarSz();
+
+  Ino::Vector accelVec(sz);
+
+  if (!topo->solveAccel(accelVec)) return false;
+
+  for (int i = 0; i < sz; ++i) varAccelVec[i] = accelVec[i];
+
+  return true;
+}
+
+void SetNewtonModeTopology(void* cppTopology, int mode, double maxContraction)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  InoKin::SolverOptions options(topo->getSolverOptions());
+
+  options.newtonMode = (InoKin::SolverOptions::NewtonMode)mode;
+  options.maxContraction = maxContraction;
+
+  topo->setSolverOptions(options);
+}
+
+void SetPredictorOrderTopology(void* cppTopology, int order)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  InoKin::SolverOptions options(topo->getSolverOptions());
+
+  options.predictorOrder = order;
+
+  topo->setSolverOptions(options);
+}
+
+void SetStepControlTopology(void* cppTopology, int control, double initDamping)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  InoKin::SolverOptions options(topo->getSolverOptions());
+
+  options.stepControl = (InoKin::SolverOptions::StepControl)control;
+  options.initDamping = initDamping;
+
+  topo->setSolverOptions(options);
+}
+
+void SetMatrixModeTopology(void* cppTopology, int mode)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  InoKin::SolverOptions options(topo->getSolverOptions());
+
+  options.matrixMode = (InoKin::SolverOptions::MatrixMode)mode;
+
+  topo->setSolverOptions(options);
+}
+
+void SetThreadCntTopology(void* cppTopology, int threadCnt)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  InoKin::SolverOptions options(topo->getSolverOptions());
+
+  options.threadCnt = threadCnt;
+
+  topo->setSolverOptions(options);
+}
+
+bool IsSparseTopology(void* cppTopology)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  return topo->isSparse();
+}
+
+void GetSolverStatsTopology(void* cppTopology, int& solveCnt, int& iterCnt,
+                            int& predictCnt, double& itersSaved)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  const InoKin::SolverStats& stats = topo->getSolverStats();
+
+  solveCnt   = stats.solveCnt;
+  iterCnt    = stats.iterCnt;
+  predictCnt = stats.predictCnt;
+  itersSaved = stats.itersSaved;
+}
+
+void GetMatrixStatsTopology(void* cppTopology, int& rowSz, int& colSz,
+                            int& varSz, int& ordering,
+                            double& nonZeros, double& fill, double& flops)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+
+  InoKin::MatrixStats stats = topo->getMatrixStats();
+
+  rowSz    = stats.rowSz;
+  colSz    = stats.colSz;
+  varSz    = stats.varSz;
+  ordering = stats.ordering;
+  nonZeros = stats.nonZeros;
+  fill     = stats.fill;
+  flops    = stats.flops;
+}
+
+static bool sweepTopology(void* cppTopology, void* cppDriveJoint, int locIdx,
+                          double from, double to, double step,
+                          int maxIter, double rotTol, double posTol,
+                          int derivOrder, double driveSpeed,
+                          bool adaptive, double maxStepFactor, int targetIter,
+                          double maxDeviation, int maxHalvings,
+                          int couplingCnt, void** cppCplJoints, int* cplLocIdx, double* cplRatio,
+                          int segCnt, int threadCnt, void* cppSequence,
+                          int& stepCnt, int& parSegCnt)
+{
+  InoKin::Topology* topo = (InoKin::Topology*)cppTopology;
+  InoKin::AbstractJoint* jnt = (InoKin::AbstractJoint*)cppDriveJoint;
+  InoKin::Sequence* seq = (InoKin::Sequence*)cppSequence;
+
+  InoKin::SweepOptions options;
+
+  options.maxIter    = maxIter;
+  options.rotTol     = rotTol;
+  options.posTol     = posTol;
+  options.derivOrder = derivOrder;
+  options.driveSpeed = driveSpeed;
+
+  options.adaptive      = adaptive;
+  options.maxStepFactor = maxStepFactor;
+  options.targetIter    = targetIter;
+  options.maxDeviation  = maxDeviation;
+  options.maxHalvings   = maxHalvings;
+
+  for (int i = 0; i < couplingCnt; ++i) {
+    InoKin::AbstractJoint* cplJnt = (InoKin::AbstractJoint*)cppCplJoints[i];
+
+    options.addCoupling(*cplJnt, cplLocIdx[i], cplRatio[i]);
+  }
+
+  return topo->sweepParallel(*jnt, locIdx, from, to, step, options,
+                             segCnt, threadCnt, *seq, stepCnt, parSegCnt);
+}
+
+bool SweepTopology(void* cppTopology, void* cppDriveJoint, int locIdx,
+                   double from, double to, double step,
+                   int maxIter, double rotTol, double posTol,
+                   int derivOrder, double driveSpeed,
+                   bool adaptive, double maxStepFactor, int targetIter,
+                   double maxDeviation, int maxHalvings,
+                   int couplingCnt, void** cppCplJoints, int* cplLocIdx, double* cplRatio,
+                   void* cppSequence, int& stepCnt)
+{
+  int parSegCnt = 1;
+
+  return sweepTopology(cppTopology, cppDriveJoint, locIdx, from, to, step,
+                       maxIter, rotTol, posTol, derivOrder, driveSpeed,
+                       adaptive, maxStepFactor, targetIter, maxDeviation, maxHalvings,
+                       couplingCnt, cppCplJoints, cplLocIdx, cplRatio,
+                       1, 1, cppSequence, stepCnt, parSegCnt);
+}
+
+bool SweepParallelTopology(void* cppTopology, void* cppDriveJoint, int locIdx,
+                           double from, double to, double step,
+                           int maxIter, double rotTol, double posTol,
+                           int derivOrder, double driveSpeed,
+                           bool adaptive, double maxStepFactor, int targetIter,
+                           double maxDeviation, int maxHalvings,
+                           int couplingCnt, void** cppCplJoints, int* cplLocIdx, double* cplRatio,
+                           int segCnt, int threadCnt, void* cppSequence,
+                           int& stepCnt, int& parSegCnt)
+{
+  return sweepTopology(cppTopology, cppDriveJoint, locIdx, from, to, step,
+                       maxIter, rotTol, posTol, derivOrder, driveSpeed,
+                       adaptive, maxStepFactor, targetIter, maxDeviation, maxHalvings,
+                       couplingCnt, cppCplJoints, cplLocIdx, cplRatio,
+                       segCnt, threadCnt, cppSequence, stepCnt, parSegCnt);
+}
 
 // End Interface Section
 
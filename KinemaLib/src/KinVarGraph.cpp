@@ -0,0 +1,261 @@
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Kinema: Kinematic Simulation Program ---------------------------
+//---------------------------------------------------------------------------
+//-------------------- Copyright Inofor Hoek Aut BV Dec 1999-2013 -----------
+//-------------------------------------------------- C.Wolters --------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Variable graph and fill reducing orderings ---------------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#include "KinVarGraph.h"
+
+#include "Exceptions.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace Ino;
+
+namespace InoKin {
+
+//---------------------------------------------------------------------------
+
+VarGraph::VarGraph(int sz, const std::vector<std::vector<int> >& cliqueLst)
+: adjLst(sz)
+{
+  int cliqueSz = (int)cliqueLst.size();
+
+  for (int i=0; i<cliqueSz; ++i) {
+    const std::vector<int>& clique = cliqueLst[i];
+    int cSz = (int)clique.size();
+
+    for (int j=0; j<cSz; ++j) {
+      int idx = clique[j];
+      if (idx < 0 || idx >= sz)
+        throw IndexOutOfBoundsException("VarGraph::VarGraph");
+
+      for (int k=0; k<cSz; ++k) {
+        if (clique[k] != idx) adjLst[idx].push_back(clique[k]);
+      }
+    }
+  }
+
+  for (int i=0; i<sz; ++i) {
+    std::vector<int>& adj = adjLst[i];
+
+    std::sort(adj.begin(),adj.end());
+    adj.erase(std::unique(adj.begin(),adj.end()),adj.end());
+  }
+}
+
+//---------------------------------------------------------------------------
+
+double VarGraph::getNonZeros() const
+{
+  double nonZeros = size();
+
+  for (int i=0; i<size(); ++i) nonZeros += degree(i) / 2.0;
+
+  return nonZeros;
+}
+
+//---------------------------------------------------------------------------
+
+void VarGraph::invert(const std::vector<int>& perm, std::vector<int>& inv)
+{
+  int sz = (int)perm.size();
+
+  inv.assign(sz,-1);
+  for (int i=0; i<sz; ++i) inv[perm[i]] = i;
+}
+
+//---------------------------------------------------------------------------
+
+int VarGraph::bandWidth(const std::vector<int>& perm) const
+{
+  std::vector<int> inv;
+  invert(perm,inv);
+
+  int bw = 0;
+
+  for (int i=0; i<size(); ++i) {
+    const std::vector<int>& adj = adjLst[i];
+    int aSz = (int)adj.size();
+
+    for (int j=0; j<aSz; ++j) bw = std::max(bw,inv[i] - inv[adj[j]]);
+  }
+
+  if (bw) bw++;
+
+  return bw;
+}
+
+//---------------------------------------------------------------------------
+
+int VarGraph::minDegreeNode(const std::vector<char>& seen) const
+{
+  int node = -1;
+
+  for (int i=0; i<size(); ++i) {
+    if (!seen[i] && (node < 0 || degree(i) < degree(node))) node = i;
+  }
+
+  return node;
+}
+
+//---------------------------------------------------------------------------
+// Breadth first from root over the unseen nodes, returns the node of
+// least degree in the last level
+
+int VarGraph::lastLevelNode(int root, const std::vector<char>& seen,
+                                                   int& levelCnt) const
+{
+  std::vector<char> mark(seen);
+  std::vector<int> level(1,root);
+
+  mark[root] = 1;
+  levelCnt = 0;
+
+  for (;;) {
+    levelCnt++;
+
+    std::vector<int> next;
+    int lSz = (int)level.size();
+
+    for (int i=0; i<lSz; ++i) {
+      const std::vector<int>& adj = adjLst[level[i]];
+      int aSz = (int)adj.size();
+
+      for (int j=0; j<aSz; ++j) {
+        if (!mark[adj[j]]) {
+          mark[adj[j]] = 1;
+          next.push_back(adj[j]);
+        }
+      }
+    }
+
+    if (next.empty()) break;
+
+    level.swap(next);
+  }
+
+  int node = level[0];
+
+  for (int i=1; i<(int)level.size(); ++i) {
+    if (degree(level[i]) < degree(node)) node = level[i];
+  }
+
+  return node;
+}
+
+//---------------------------------------------------------------------------
+// Per connected component: a pseudo peripheral start node, then breadth
+// first with the neighbours in order of increasing degree. Reversed.
+
+void VarGraph::orderRCM(std::vector<int>& perm) const
+{
+  int sz = size();
+
+  perm.clear();
+  perm.reserve(sz);
+
+  std::vector<char> seen(sz,0);
+
+  for (;;) {
+    int root = minDegreeNode(seen);
+    if (root < 0) break;
+
+    int levelCnt = 0;
+    int node = lastLevelNode(root,seen,levelCnt);
+
+    for (int i=0; i<5; ++i) {
+      int nodeLevelCnt = 0;
+      int next = lastLevelNode(node,seen,nodeLevelCnt);
+
+      if (nodeLevelCnt <= levelCnt) break;
+
+      root = node;
+      node = next;
+      levelCnt = nodeLevelCnt;
+    }
+
+    int fst = (int)perm.size();
+
+    perm.push_back(root);
+    seen[root] = 1;
+
+    for (int i=fst; i<(int)perm.size(); ++i) {
+      const std::vector<int>& adj = adjLst[perm[i]];
+      int aSz = (int)adj.size();
+
+      int nextFst = (int)perm.size();
+
+      for (int j=0; j<aSz; ++j) {
+        if (!seen[adj[j]]) {
+          seen[adj[j]] = 1;
+          perm.push_back(adj[j]);
+        }
+      }
+
+      std::stable_sort(perm.begin()+nextFst,perm.end(),
+                       [this](int a, int b) { return degree(a) < degree(b); });
+    }
+  }
+
+  std::reverse(perm.begin(),perm.end());
+}
+
+//---------------------------------------------------------------------------
+// Eliminates the node of least degree and connects its neighbours,
+// ties are broken by the lowest index (the result is deterministic).
+// Exact degrees, no approximation as in AMD.
+
+void VarGraph::orderMinDegree(std::vector<int>& perm) const
+{
+  int sz = size();
+
+  perm.clear();
+  perm.reserve(sz);
+
+  std::vector<std::set<int> > elimLst(sz);
+  std::set<std::pair<int,int> > queue;
+
+  for (int i=0; i<sz; ++i) {
+    elimLst[i].insert(adjLst[i].begin(),adjLst[i].end());
+    queue.insert(std::make_pair(degree(i),i));
+  }
+
+  std::vector<int> nbrLst;
+
+  while (!queue.empty()) {
+    int node = queue.begin()->second;
+    queue.erase(queue.begin());
+
+    perm.push_back(node);
+
+    nbrLst.assign(elimLst[node].begin(),elimLst[node].end());
+    elimLst[node].clear();
+
+    int nSz = (int)nbrLst.size();
+
+    for (int i=0; i<nSz; ++i) {
+      std::set<int>& adj = elimLst[nbrLst[i]];
+
+      queue.erase(std::make_pair((int)adj.size(),nbrLst[i]));
+
+      adj.erase(node);
+      for (int j=0; j<nSz; ++j) {
+        if (j != i) adj.insert(nbrLst[j]);
+      }
+
+      queue.insert(std::make_pair((int)adj.size(),nbrLst[i]));
+    }
+  }
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------
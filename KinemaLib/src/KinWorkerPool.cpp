@@ -0,0 +1,130 @@
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Kinema: Kinematic Simulation Program ---------------------------
+//---------------------------------------------------------------------------
+//-------------------- Copyright Inofor Hoek Aut BV Dec 1999-2013 -----------
+//-------------------------------------------------- C.Wolters --------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+//---------- Persistent worker threads for short parallel loops -------------
+//---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+
+#include "KinWorkerPool.h"
+
+namespace InoKin {
+
+//---------------------------------------------------------------------------
+
+WorkerPool::WorkerPool(int threadCnt)
+: threadLst(),
+  task(NULL), taskCnt(0), nextTask(0),
+  busyCnt(0), runNr(0), stopping(false),
+  error()
+{
+  if (threadCnt < 1) threadCnt = 1;
+
+  threadLst.reserve(threadCnt-1);
+
+  for (int i=1; i<threadCnt; ++i)
+    threadLst.push_back(std::thread(&WorkerPool::workerLoop,this));
+}
+
+//---------------------------------------------------------------------------
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+
+  startCond.notify_all();
+
+  for (size_t i=0; i<threadLst.size(); ++i) threadLst[i].join();
+}
+
+//---------------------------------------------------------------------------
+
+void WorkerPool::runTasks()
+{
+  for (;;) {
+    int i = nextTask++;
+    if (i >= taskCnt) break;
+
+    try {
+      (*task)(i);
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) error = std::current_exception();
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void WorkerPool::workerLoop()
+{
+  unsigned lastRunNr = 0;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      startCond.wait(lock,[&]() { return stopping || runNr != lastRunNr; });
+
+      if (stopping) return;
+
+      lastRunNr = runNr;
+    }
+
+    runTasks();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--busyCnt == 0) doneCond.notify_all();
+    }
+  }
+}
+
+//---------------------------------------------------------------------------
+
+void WorkerPool::run(int cnt, const std::function<void(int)>& func)
+{
+  if (threadLst.empty() || cnt < 2) {
+    for (int i=0; i<cnt; ++i) func(i);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    task     = &func;
+    taskCnt  = cnt;
+    nextTask = 0;
+    busyCnt  = (int)threadLst.size();
+    error    = std::exception_ptr();
+
+    runNr++;
+  }
+
+  startCond.notify_all();
+
+  runTasks();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  doneCond.wait(lock,[&]() { return busyCnt == 0; });
+
+  task = NULL;
+
+  if (error) {
+    std::exception_ptr err = error;
+    error = std::exception_ptr();
+
+    std::rethrow_exception(err);
+  }
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------